@@ -0,0 +1,648 @@
+// Scene, intersection and traversal code shared by the megakernel in ray_tracing.comp and the wavefront kernels
+
+#define PI 3.14159265
+#define FLOAT_MAX 3.402823466e+38
+
+// R2 sequence constants 0.7548776662 and 0.5698402911 in 0.32 fixed point
+#define ANTIALIASING_QUASIRANDOM_SEED_A 3242174889u
+#define ANTIALIASING_QUASIRANDOM_SEED_B 2447445414u
+
+#define BVH_STACK_SIZE 32
+
+// Set in RayHit.object for the planes, the spheres use their index as is
+#define PLANE_OBJECT_BIT 0x80000000u
+
+// Set in RayHit.object for the mesh triangles, followed by the mesh index and the triangle index in the mesh.
+// Must match MESH_TRIANGLE_BITS in vrt_mesh.cpp.
+#define MESH_OBJECT_BIT 0x40000000u
+#define MESH_TRIANGLE_BITS 22
+#define MESH_TRIANGLE_MASK 0x3fffffu
+
+// Set by RayTracer::createRayTracingPipeline
+layout (constant_id = 0) const int ANTIALIASING_SAMPLES = 2;
+layout (constant_id = 1) const int MAX_BOUNCES = 5;
+
+layout (binding = 0) uniform samplerCube samplerSkybox;
+layout (binding = 1, rgba8) uniform writeonly image2D resultImage;
+layout (binding = 7, rgba32f) uniform image2D accumulationImage;
+
+// Part of the images traced, in their top left corner, set by RayTracer::recordComputeCommandBuffer. The wavefront
+// kernels also receive the sample and the bounce they work on. The camera covers the frame extent, the region starts
+// at the offset in it: the whole frame but for the tiles of RayTracer::renderTiled.
+layout (push_constant) uniform Region {
+	uvec2 extent;
+	uint sampleIndex;
+	uint bounceIndex;
+	ivec2 offset;
+	uvec2 frameExtent;
+} region;
+
+layout (binding = 2) uniform Settings {
+	mat4 projection;   
+	mat4 transform;
+	
+	vec4 directionalLight;
+	
+	float angle;
+	uint useBvh;
+	uint frameIndex;
+} settings; 
+
+// The objects only keep an index in the material table, which the intersection loops never read
+struct Sphere {
+	vec3 position;
+	float radius;
+	uint material;
+};
+
+// Plane equation, dot(normal, point) == distance for the points of the plane
+struct Plane {
+	vec3 normal;
+	float distance;
+	uint material;
+};
+
+struct Material {
+	vec3 albedo;
+	vec3 specular;
+};
+
+layout (std430, binding = 3) readonly buffer Spheres {
+	Sphere spheres[];
+};
+
+layout (std430, binding = 4) readonly buffer Planes {
+	Plane planes[];
+};
+
+layout (std430, binding = 15) readonly buffer Materials {
+	Material materials[];
+};
+
+struct BvhNode {
+	vec3 min;
+	uint leftOrFirst;
+	vec3 max;
+	uint count;
+};
+
+layout (std430, binding = 5) readonly buffer BvhNodes {
+	BvhNode nodes[];
+};
+
+layout (std430, binding = 6) readonly buffer BvhIndices {
+	uint sphereIndices[];
+};
+
+// The vertex quantized to q is at origin + q * scale. A scene without meshes binds a single mesh without triangles.
+struct Mesh {
+	vec3 origin;
+	uint firstNode;
+	vec3 scale;
+	uint firstTriangle;
+	uint firstVertex;
+	uint triangleCount;
+	uint material;
+	uint nodeCount;
+};
+
+layout (std430, binding = 16) readonly buffer Meshes {
+	Mesh meshes[];
+};
+
+// 16 bits per axis, x and y in the first word and z in the low half of the second
+layout (std430, binding = 17) readonly buffer MeshVertices {
+	uvec2 meshVertices[];
+};
+
+// Three per triangle, relative to the first vertex of the mesh, the triangles sorted along the leaves of its BVH
+layout (std430, binding = 18) readonly buffer MeshIndices {
+	uint meshIndices[];
+};
+
+// One hierarchy per mesh, the child and triangle indices are relative to the first node and triangle of the mesh
+layout (std430, binding = 19) readonly buffer MeshNodes {
+	BvhNode meshNodes[];
+};
+
+// Center and radius of the spheres at the time of the frame, written by animate.comp
+layout (std430, binding = 8) readonly buffer SpherePositions {
+	vec4 spherePositions[];
+};
+
+// The cone around the ray selects the sky box mip level: its width at the origin and its spread angle in radians
+struct Ray {
+	vec3 origin;
+	vec3 direction;
+	vec3 energy;
+	float coneWidth;
+	float coneSpread;
+};
+
+Ray createRay(vec3 origin, vec3 direction) {
+	return Ray(origin, direction, vec3(1.0f, 1.0f, 1.0f), 0.0f, 0.0f);
+}
+
+Ray createCameraRay(uvec2 pixel, uint rayIndex) {
+	// Integer arithmetic keeps the offsets exact however far the sequence advances while accumulating
+	uvec2 quasiRandomOffset = rayIndex * uvec2(ANTIALIASING_QUASIRANDOM_SEED_A, ANTIALIASING_QUASIRANDOM_SEED_B) + 0x80000000u;
+	vec2 viewCoordinates = vec2(pixel) + vec2(region.offset) + vec2(quasiRandomOffset >> 8) / 16777216.0f;
+
+	vec4 origin = settings.transform * vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	vec4 direction = settings.transform * vec4((settings.projection * vec4(viewCoordinates / region.frameExtent * 2.0f - 1.0f, 0.0f, 1.0f)).xyz, 0.0f);
+	vec4 neighbourDirection = settings.transform * vec4((settings.projection * vec4((viewCoordinates + vec2(1.0f, 0.0f)) / region.frameExtent * 2.0f - 1.0f, 0.0f, 1.0f)).xyz, 0.0f);
+
+	Ray ray = createRay(origin.xyz, normalize(direction.xyz));
+
+	// Angle covered by one pixel, the chord is close enough to the arc at that scale
+	ray.coneSpread = length(normalize(neighbourDirection.xyz) - ray.direction);
+
+	return ray;
+}
+
+// Only what the traversal needs to compare and order the hits, the material is fetched once from the object when
+// shading the closest one
+struct RayHit {
+    float distance;
+    vec3 normal;
+    uint object;
+};
+
+RayHit createRayHit() {
+	return RayHit(FLOAT_MAX, vec3(0.0f, 0.0f, 0.0f), 0u);
+}
+
+Material getMaterial(uint object) {
+	if ((object & PLANE_OBJECT_BIT) != 0) {
+		return materials[planes[object & ~PLANE_OBJECT_BIT].material];
+	}
+
+	if ((object & MESH_OBJECT_BIT) != 0) {
+		return materials[meshes[(object & ~MESH_OBJECT_BIT) >> MESH_TRIANGLE_BITS].material];
+	}
+
+	return materials[spheres[object].material];
+}
+
+// Inverse radius of the surface, zero for the planes and the triangles
+float getCurvature(uint object) {
+	return (object & (PLANE_OBJECT_BIT | MESH_OBJECT_BIT)) != 0 ? 0.0f : 1.0f / spherePositions[object].w;
+}
+
+vec3 getMeshVertex(Mesh mesh, uint index) {
+	uvec2 quantized = meshVertices[mesh.firstVertex + index];
+
+	return mesh.origin + vec3(quantized.x & 0xffffu, quantized.x >> 16, quantized.y & 0xffffu) * mesh.scale;
+}
+
+void getMeshTriangle(Mesh mesh, uint triangle, out vec3 v0, out vec3 v1, out vec3 v2) {
+	uint first = 3 * (mesh.firstTriangle + triangle);
+
+	v0 = getMeshVertex(mesh, meshIndices[first]);
+	v1 = getMeshVertex(mesh, meshIndices[first + 1]);
+	v2 = getMeshVertex(mesh, meshIndices[first + 2]);
+}
+
+// The meshes are neither assumed closed nor consistently wound, both faces are lit
+vec3 getTriangleNormal(vec3 v0, vec3 v1, vec3 v2, vec3 direction) {
+	vec3 normal = normalize(cross(v1 - v0, v2 - v0));
+
+	return faceforward(normal, direction, normal);
+}
+
+// Shear of the watertight triangle test: the ray is turned into the +z axis, and the edge functions of two triangles
+// sharing an edge are computed from the same values with opposite signs, so no ray goes between them
+struct TriangleRay {
+	ivec3 axes;
+	vec3 shear;
+};
+
+TriangleRay createTriangleRay(Ray ray) {
+	vec3 direction = abs(ray.direction);
+	int kz = direction.x > direction.y ? (direction.x > direction.z ? 0 : 2) : (direction.y > direction.z ? 1 : 2);
+	int kx = kz == 2 ? 0 : kz + 1;
+	int ky = kx == 2 ? 0 : kx + 1;
+
+	// Keeps the winding of the triangles once projected
+	if (ray.direction[kz] < 0.0f) {
+		int k = kx;
+		kx = ky;
+		ky = k;
+	}
+
+	return TriangleRay(ivec3(kx, ky, kz), vec3(ray.direction[kx], ray.direction[ky], 1.0f) / ray.direction[kz]);
+}
+
+// Distance along the ray, FLOAT_MAX when the triangle is missed
+float intersectTriangle(Ray ray, TriangleRay triangleRay, vec3 v0, vec3 v1, vec3 v2) {
+	ivec3 k = triangleRay.axes;
+	vec3 s = triangleRay.shear;
+
+	vec3 a = v0 - ray.origin;
+	vec3 b = v1 - ray.origin;
+	vec3 c = v2 - ray.origin;
+
+	float ax = a[k.x] - s.x * a[k.z];
+	float ay = a[k.y] - s.y * a[k.z];
+	float bx = b[k.x] - s.x * b[k.z];
+	float by = b[k.y] - s.y * b[k.z];
+	float cx = c[k.x] - s.x * c[k.z];
+	float cy = c[k.y] - s.y * c[k.z];
+
+	float u = cx * by - cy * bx;
+	float v = ax * cy - ay * cx;
+	float w = bx * ay - by * ax;
+
+	if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) {
+		return FLOAT_MAX;
+	}
+
+	float determinant = u + v + w;
+
+	if (determinant == 0.0f) {
+		return FLOAT_MAX;
+	}
+
+	float t = (u * a[k.z] + v * b[k.z] + w * c[k.z]) * s.z / determinant;
+
+	return t > 0.0f ? t : FLOAT_MAX;
+}
+
+void intersectPlane(Ray ray, inout RayHit bestHit, uint index) {
+	Plane plane = planes[index];
+
+	float a = dot(ray.direction, plane.normal);
+	
+	if (a < 0) {
+		float t = (plane.distance - dot(ray.origin, plane.normal)) / a;
+		
+		if (t > 0 && t < bestHit.distance) {
+			bestHit.distance = t;
+			bestHit.normal = plane.normal;
+			bestHit.object = index | PLANE_OBJECT_BIT;
+		}
+	}
+}
+
+void intersectSphere(Ray ray, inout RayHit bestHit, uint index) {
+    vec4 sphere = spherePositions[index];
+    vec3 d = ray.origin - sphere.xyz;
+    float p1 = -dot(ray.direction, d);
+    float p2sqr = p1 * p1 - dot(d, d) + sphere.w * sphere.w;
+    
+	if (p2sqr < 0) {
+        return;
+	}
+    
+	float p2 = sqrt(p2sqr);
+    float t = p1 - p2 > 0 ? p1 - p2 : p1 + p2;
+    
+	if (t > 0 && t < bestHit.distance) {
+        bestHit.distance = t;
+        bestHit.normal = normalize(ray.origin + t * ray.direction - sphere.xyz);
+        bestHit.object = index;
+    }
+}
+
+bool occludesPlane(Ray ray, Plane plane) {
+	float a = dot(ray.direction, plane.normal);
+
+	return a < 0 && (plane.distance - dot(ray.origin, plane.normal)) / a > 0;
+}
+
+bool occludesSphere(Ray ray, uint index) {
+	vec4 sphere = spherePositions[index];
+	vec3 d = ray.origin - sphere.xyz;
+	float p1 = -dot(ray.direction, d);
+	float p2sqr = p1 * p1 - dot(d, d) + sphere.w * sphere.w;
+
+	// The far root is positive whenever the near one is, so it alone tells if the ray is blocked
+	return p2sqr >= 0 && p1 + sqrt(p2sqr) > 0;
+}
+
+float intersectBox(Ray ray, vec3 inverseDirection, vec3 boxMin, vec3 boxMax, float maxDistance) {
+	vec3 t0 = (boxMin - ray.origin) * inverseDirection;
+	vec3 t1 = (boxMax - ray.origin) * inverseDirection;
+	vec3 tMin = min(t0, t1);
+	vec3 tMax = max(t0, t1);
+
+	float near = max(max(tMin.x, tMin.y), tMin.z);
+	float far = min(min(tMax.x, tMax.y), tMax.z);
+
+	return far >= max(near, 0.0f) && near < maxDistance ? near : FLOAT_MAX;
+}
+
+void traverseSpheres(Ray ray, inout RayHit bestHit) {
+	vec3 inverseDirection = 1.0f / ray.direction;
+
+	if (intersectBox(ray, inverseDirection, nodes[0].min, nodes[0].max, bestHit.distance) == FLOAT_MAX) {
+		return;
+	}
+
+	uint stack[BVH_STACK_SIZE];
+	uint stackSize = 0;
+	uint nodeIndex = 0;
+
+	while (true) {
+		BvhNode node = nodes[nodeIndex];
+
+		if (node.count > 0) {
+			for (uint i = 0; i < node.count; i++) {
+				intersectSphere(ray, bestHit, sphereIndices[node.leftOrFirst + i]);
+			}
+
+			if (stackSize == 0) {
+				break;
+			}
+
+			nodeIndex = stack[--stackSize];
+		} else {
+			uint nearIndex = node.leftOrFirst;
+			uint farIndex = node.leftOrFirst + 1;
+
+			float nearDistance = intersectBox(ray, inverseDirection, nodes[nearIndex].min, nodes[nearIndex].max, bestHit.distance);
+			float farDistance = intersectBox(ray, inverseDirection, nodes[farIndex].min, nodes[farIndex].max, bestHit.distance);
+
+			if (farDistance < nearDistance) {
+				uint index = nearIndex;
+				nearIndex = farIndex;
+				farIndex = index;
+
+				float distance = nearDistance;
+				nearDistance = farDistance;
+				farDistance = distance;
+			}
+
+			if (nearDistance == FLOAT_MAX) {
+				if (stackSize == 0) {
+					break;
+				}
+
+				nodeIndex = stack[--stackSize];
+			} else {
+				nodeIndex = nearIndex;
+
+				if (farDistance != FLOAT_MAX) {
+					stack[stackSize++] = farIndex;
+				}
+			}
+		}
+	}
+}
+
+void traverseMesh(Ray ray, inout RayHit bestHit, uint meshIndex) {
+	Mesh mesh = meshes[meshIndex];
+
+	if (mesh.triangleCount == 0) {
+		return;
+	}
+
+	vec3 inverseDirection = 1.0f / ray.direction;
+
+	if (intersectBox(ray, inverseDirection, meshNodes[mesh.firstNode].min, meshNodes[mesh.firstNode].max, bestHit.distance) == FLOAT_MAX) {
+		return;
+	}
+
+	TriangleRay triangleRay = createTriangleRay(ray);
+
+	uint stack[BVH_STACK_SIZE];
+	uint stackSize = 0;
+	uint nodeIndex = 0;
+
+	while (true) {
+		BvhNode node = meshNodes[mesh.firstNode + nodeIndex];
+
+		if (node.count > 0) {
+			for (uint i = 0; i < node.count; i++) {
+				uint triangle = node.leftOrFirst + i;
+
+				vec3 v0, v1, v2;
+				getMeshTriangle(mesh, triangle, v0, v1, v2);
+
+				float t = intersectTriangle(ray, triangleRay, v0, v1, v2);
+
+				if (t < bestHit.distance) {
+					bestHit.distance = t;
+					bestHit.normal = getTriangleNormal(v0, v1, v2, ray.direction);
+					bestHit.object = MESH_OBJECT_BIT | (meshIndex << MESH_TRIANGLE_BITS) | triangle;
+				}
+			}
+
+			if (stackSize == 0) {
+				break;
+			}
+
+			nodeIndex = stack[--stackSize];
+		} else {
+			uint nearIndex = node.leftOrFirst;
+			uint farIndex = node.leftOrFirst + 1;
+
+			float nearDistance = intersectBox(ray, inverseDirection, meshNodes[mesh.firstNode + nearIndex].min, meshNodes[mesh.firstNode + nearIndex].max, bestHit.distance);
+			float farDistance = intersectBox(ray, inverseDirection, meshNodes[mesh.firstNode + farIndex].min, meshNodes[mesh.firstNode + farIndex].max, bestHit.distance);
+
+			if (farDistance < nearDistance) {
+				uint index = nearIndex;
+				nearIndex = farIndex;
+				farIndex = index;
+
+				float distance = nearDistance;
+				nearDistance = farDistance;
+				farDistance = distance;
+			}
+
+			if (nearDistance == FLOAT_MAX) {
+				if (stackSize == 0) {
+					break;
+				}
+
+				nodeIndex = stack[--stackSize];
+			} else {
+				nodeIndex = nearIndex;
+
+				if (farDistance != FLOAT_MAX) {
+					stack[stackSize++] = farIndex;
+				}
+			}
+		}
+	}
+}
+
+// Any-hit traversal: children are not sorted by distance and the first sphere found ends the walk
+bool traverseSpheresAnyHit(Ray ray) {
+	vec3 inverseDirection = 1.0f / ray.direction;
+
+	if (intersectBox(ray, inverseDirection, nodes[0].min, nodes[0].max, FLOAT_MAX) == FLOAT_MAX) {
+		return false;
+	}
+
+	uint stack[BVH_STACK_SIZE];
+	uint stackSize = 0;
+	uint nodeIndex = 0;
+
+	while (true) {
+		BvhNode node = nodes[nodeIndex];
+
+		if (node.count > 0) {
+			for (uint i = 0; i < node.count; i++) {
+				if (occludesSphere(ray, sphereIndices[node.leftOrFirst + i])) {
+					return true;
+				}
+			}
+		} else {
+			uint leftIndex = node.leftOrFirst;
+			uint rightIndex = node.leftOrFirst + 1;
+
+			bool leftHit = intersectBox(ray, inverseDirection, nodes[leftIndex].min, nodes[leftIndex].max, FLOAT_MAX) != FLOAT_MAX;
+			bool rightHit = intersectBox(ray, inverseDirection, nodes[rightIndex].min, nodes[rightIndex].max, FLOAT_MAX) != FLOAT_MAX;
+
+			if (leftHit) {
+				if (rightHit) {
+					stack[stackSize++] = rightIndex;
+				}
+
+				nodeIndex = leftIndex;
+				continue;
+			}
+
+			if (rightHit) {
+				nodeIndex = rightIndex;
+				continue;
+			}
+		}
+
+		if (stackSize == 0) {
+			return false;
+		}
+
+		nodeIndex = stack[--stackSize];
+	}
+}
+
+bool traverseMeshAnyHit(Ray ray, uint meshIndex) {
+	Mesh mesh = meshes[meshIndex];
+
+	if (mesh.triangleCount == 0) {
+		return false;
+	}
+
+	vec3 inverseDirection = 1.0f / ray.direction;
+
+	if (intersectBox(ray, inverseDirection, meshNodes[mesh.firstNode].min, meshNodes[mesh.firstNode].max, FLOAT_MAX) == FLOAT_MAX) {
+		return false;
+	}
+
+	TriangleRay triangleRay = createTriangleRay(ray);
+
+	uint stack[BVH_STACK_SIZE];
+	uint stackSize = 0;
+	uint nodeIndex = 0;
+
+	while (true) {
+		BvhNode node = meshNodes[mesh.firstNode + nodeIndex];
+
+		if (node.count > 0) {
+			for (uint i = 0; i < node.count; i++) {
+				vec3 v0, v1, v2;
+				getMeshTriangle(mesh, node.leftOrFirst + i, v0, v1, v2);
+
+				if (intersectTriangle(ray, triangleRay, v0, v1, v2) != FLOAT_MAX) {
+					return true;
+				}
+			}
+		} else {
+			uint leftIndex = node.leftOrFirst;
+			uint rightIndex = node.leftOrFirst + 1;
+
+			bool leftHit = intersectBox(ray, inverseDirection, meshNodes[mesh.firstNode + leftIndex].min, meshNodes[mesh.firstNode + leftIndex].max, FLOAT_MAX) != FLOAT_MAX;
+			bool rightHit = intersectBox(ray, inverseDirection, meshNodes[mesh.firstNode + rightIndex].min, meshNodes[mesh.firstNode + rightIndex].max, FLOAT_MAX) != FLOAT_MAX;
+
+			if (leftHit) {
+				if (rightHit) {
+					stack[stackSize++] = rightIndex;
+				}
+
+				nodeIndex = leftIndex;
+				continue;
+			}
+
+			if (rightHit) {
+				nodeIndex = rightIndex;
+				continue;
+			}
+		}
+
+		if (stackSize == 0) {
+			return false;
+		}
+
+		nodeIndex = stack[--stackSize];
+	}
+}
+
+// Only tells whether anything is hit, for shadow rays which need neither the distance nor the material
+bool occluded(Ray ray) {
+	for (int i = 0; i < planes.length(); i++) {
+		if (occludesPlane(ray, planes[i])) {
+			return true;
+		}
+	}
+
+	for (int i = 0; i < meshes.length(); i++) {
+		if (traverseMeshAnyHit(ray, uint(i))) {
+			return true;
+		}
+	}
+
+	if (settings.useBvh != 0) {
+		return traverseSpheresAnyHit(ray);
+	}
+
+	for (int i = 0; i < spheres.length(); i++) {
+		if (occludesSphere(ray, uint(i))) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+RayHit trace(Ray ray) {
+    RayHit bestHit = createRayHit();
+
+	for (int i = 0; i < planes.length(); i++) {
+		intersectPlane(ray, bestHit, uint(i));
+	}
+
+	for (int i = 0; i < meshes.length(); i++) {
+		traverseMesh(ray, bestHit, uint(i));
+	}
+
+	if (settings.useBvh != 0) {
+		traverseSpheres(ray, bestHit);
+	} else {
+		for (int i = 0; i < spheres.length(); i++) {
+			intersectSphere(ray, bestHit, uint(i));
+		}
+	}
+
+    return bestHit;
+}
+
+vec3 sampleSkyBox(Ray ray) {
+	// A face spans PI / 2 radians, the level is the one whose texels are as wide as the cone
+	float texelsPerRadian = textureSize(samplerSkybox, 0).x * 2.0f / PI;
+	float lod = log2(max(ray.coneSpread * texelsPerRadian, 1.0f));
+
+	return textureLod(samplerSkybox, ray.direction, lod).xyz;
+}
+
+void storeResult(ivec2 pixel, vec3 result) {
+	// Running mean over the frames rendered since the last reset, frame 0 overwrites the history
+	if (settings.frameIndex > 0) {
+		vec3 accumulated = imageLoad(accumulationImage, pixel).xyz;
+		result = accumulated + (result - accumulated) / float(settings.frameIndex + 1);
+	}
+
+	imageStore(accumulationImage, pixel, vec4(result, 1.0f));
+	imageStore(resultImage, pixel, vec4(result, 1.0f));
+}
\ No newline at end of file
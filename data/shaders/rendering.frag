@@ -1,15 +1,103 @@
 #version 450
 
+#define PI 3.1415926535897932384626433832795
+
+// How strongly a tap is rejected when its luminance differs from the bilinear estimate
+#define EDGE_SHARPNESS 64.0
+
+// Set by RayTracer::createGraphicsPipeline, 0 for bilinear, 1 for edge aware
+layout (constant_id = 0) const int UPSCALING_FILTER = 1;
+
 layout (binding = 0) uniform sampler2D samplerColor;
 
+// Part of the texture traced by the frame, in its top left corner, set by RayTracer::recordDrawCommandBuffer
+layout (push_constant) uniform Region {
+	uvec2 extent;
+} region;
+
 layout (location = 0) in vec2 texturePosition;
 
 layout (location = 0) out vec4 outFragColor;
 
+float getLuminance(vec3 color) {
+	return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+float lanczos2(float x) {
+	x = abs(x);
+
+	if (x < 1e-5) {
+		return 1.0;
+	}
+
+	if (x >= 2.0) {
+		return 0.0;
+	}
+
+	float px = PI * x;
+
+	return 2.0 * sin(px) * sin(px * 0.5) / (px * px);
+}
+
+// Keeps the filter within the traced region, the texels past it hold older frames
+vec3 sampleBilinear(vec2 position) {
+	vec2 size = vec2(region.extent);
+	vec2 coordinates = clamp(position * size, vec2(0.5), size - 0.5);
+
+	return texture(samplerColor, coordinates / vec2(textureSize(samplerColor, 0))).rgb;
+}
+
+// Lanczos 2 over the 4x4 texels around the position. A tap whose luminance is far from the bilinear estimate most
+// likely lies on the other side of an edge, its weight is lowered so the edge stays sharp instead of being averaged.
+// The negative lobes ring next to strong edges, the result is clamped to the range of the four nearest texels.
+vec3 upscaleEdgeAware(vec2 position) {
+	ivec2 size = ivec2(region.extent);
+	vec2 texel = position * vec2(size) - 0.5;
+	ivec2 origin = ivec2(floor(texel));
+	vec2 fraction = texel - vec2(origin);
+
+	vec3 estimate = sampleBilinear(position);
+	float estimateLuminance = getLuminance(estimate);
+
+	vec3 sum = vec3(0.0);
+	float weightSum = 0.0;
+
+	vec3 minimum = vec3(1.0);
+	vec3 maximum = vec3(0.0);
+
+	for (int y = -1; y <= 2; y++) {
+		for (int x = -1; x <= 2; x++) {
+			ivec2 coordinates = clamp(origin + ivec2(x, y), ivec2(0), size - 1);
+			vec3 color = texelFetch(samplerColor, coordinates, 0).rgb;
+
+			float difference = getLuminance(color) - estimateLuminance;
+			float weight = lanczos2(float(x) - fraction.x) * lanczos2(float(y) - fraction.y);
+			weight *= exp(-difference * difference * EDGE_SHARPNESS);
+
+			sum += color * weight;
+			weightSum += weight;
+
+			if (x >= 0 && x <= 1 && y >= 0 && y <= 1) {
+				minimum = min(minimum, color);
+				maximum = max(maximum, color);
+			}
+		}
+	}
+
+	// Only the negative lobes are left when every close tap was rejected
+	if (weightSum < 1e-3) {
+		return estimate;
+	}
+
+	return clamp(sum / weightSum, minimum, maximum);
+}
+
 void main() {
-    outFragColor = texture(samplerColor, vec2(texturePosition.s, 1.0 - texturePosition.t));
-	
-	if(texturePosition.s > 1) { 
-		outFragColor.y = 1.0;
+	vec2 position = vec2(texturePosition.s, 1.0 - texturePosition.t);
+
+	if (UPSCALING_FILTER == 1) {
+		outFragColor = vec4(upscaleEdgeAware(position), 1.0);
+	} else {
+		outFragColor = vec4(sampleBilinear(position), 1.0);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,127 @@
+// Path state and queues shared by the wavefront kernels. The paths of one sample are traced at a time, a path per
+// pixel of the region, indexed like its pixel.
+
+// Matches RayTracer::WAVEFRONT_WORKGROUP_SIZE
+#define WAVEFRONT_WORKGROUP_SIZE 256
+
+// The light is the direct lighting of the last hit, added to the radiance once its shadow ray gets through
+struct Path {
+	vec3 origin;
+	float coneWidth;
+	vec3 direction;
+	float coneSpread;
+	vec3 energy;
+	vec3 light;
+};
+
+// The closest hit only, the shade kernel reads the rest from the object
+struct HitRecord {
+	float distance;
+	uint object;
+};
+
+// The first three members are the indirect dispatch of the kernel reading the queue
+struct QueueCounter {
+	uint groupCountX;
+	uint groupCountY;
+	uint groupCountZ;
+	uint count;
+};
+
+layout (std430, binding = 10) buffer Paths {
+	Path paths[];
+};
+
+layout (std430, binding = 11) buffer Hits {
+	HitRecord hits[];
+};
+
+// The two ray queues, used in turn by the bounces, then the shadow queue
+layout (std430, binding = 12) buffer Queues {
+	uint queues[];
+};
+
+// Reset every frame by RayTracer::recordWavefrontDispatches
+layout (std430, binding = 13) buffer Counters {
+	QueueCounter counters[];
+};
+
+// Sum of the samples traced so far in the frame
+layout (std430, binding = 14) buffer Radiance {
+	vec4 radiance[];
+};
+
+uint getPathCount() {
+	return region.extent.x * region.extent.y;
+}
+
+uint getRayQueueOffset(uint bounce) {
+	return (bounce & 1u) * getPathCount();
+}
+
+uint getShadowQueueOffset() {
+	return 2u * getPathCount();
+}
+
+// A ray and a shadow counter per sample and bounce, in the order of RayTracer::getWavefrontCounterOffset
+uint getRayCounter(uint bounce) {
+	return region.sampleIndex * uint(MAX_BOUNCES) + bounce;
+}
+
+uint getShadowCounter(uint bounce) {
+	return (uint(ANTIALIASING_SAMPLES) + region.sampleIndex) * uint(MAX_BOUNCES) + bounce;
+}
+
+// Appends the active invocations of the subgroup with a single atomic, then adds the workgroups their slots start
+// to the indirect dispatch of the queue.
+uint reserveQueueSlot(uint counter) {
+	uvec4 ballot = subgroupBallot(true);
+	uint count = subgroupBallotBitCount(ballot);
+	uint first = 0;
+
+	if (subgroupElect()) {
+		first = atomicAdd(counters[counter].count, count);
+
+		uint groupCount = (first + count + WAVEFRONT_WORKGROUP_SIZE - 1) / WAVEFRONT_WORKGROUP_SIZE - (first + WAVEFRONT_WORKGROUP_SIZE - 1) / WAVEFRONT_WORKGROUP_SIZE;
+
+		if (groupCount > 0) {
+			atomicAdd(counters[counter].groupCountX, groupCount);
+		}
+	}
+
+	return subgroupBroadcastFirst(first) + subgroupBallotExclusiveBitCount(ballot);
+}
+
+Ray loadRay(uint path) {
+	Path state = paths[path];
+
+	return Ray(state.origin, state.direction, state.energy, state.coneWidth, state.coneSpread);
+}
+
+void storeRay(uint path, Ray ray) {
+	paths[path].origin = ray.origin;
+	paths[path].coneWidth = ray.coneWidth;
+	paths[path].direction = ray.direction;
+	paths[path].coneSpread = ray.coneSpread;
+	paths[path].energy = ray.energy;
+}
+
+// Rebuilds the hit as trace() found it
+RayHit getRayHit(Ray ray, HitRecord record) {
+	RayHit hit = createRayHit();
+	hit.distance = record.distance;
+	hit.object = record.object;
+
+	if ((record.object & PLANE_OBJECT_BIT) != 0) {
+		hit.normal = planes[record.object & ~PLANE_OBJECT_BIT].normal;
+	} else if ((record.object & MESH_OBJECT_BIT) != 0) {
+		vec3 v0, v1, v2;
+		getMeshTriangle(meshes[(record.object & ~MESH_OBJECT_BIT) >> MESH_TRIANGLE_BITS], record.object & MESH_TRIANGLE_MASK, v0, v1, v2);
+
+		hit.normal = getTriangleNormal(v0, v1, v2, ray.direction);
+	} else {
+		hit.normal = normalize(ray.origin + record.distance * ray.direction - spherePositions[record.object].xyz);
+	}
+
+	return hit;
+}
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "vrt_ray_tracer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+	struct Resolution {
+		uint32_t width;
+		uint32_t height;
+	};
+
+	struct BenchConfiguration {
+		std::vector<uint32_t> sphereCounts{ 25, 10000, 1000000 };
+		std::vector<Resolution> resolutions{ { 1280, 720 }, { 1920, 1080 } };
+		std::vector<uint32_t> samples{ 1, 2, 4 };
+
+		uint32_t warmupFrames = 10;
+		uint32_t frames = 120;
+		uint32_t seed = 1;
+
+		// Times the workgroup shapes on the first frame of every run, the fastest is cached for the device
+		bool tune = false;
+
+		// Traces with the wavefront kernels instead of the megakernel
+		bool wavefront = false;
+	};
+
+	std::vector<std::string> split(const std::string& value, char separator) {
+		std::vector<std::string> parts;
+		std::stringstream stream{ value };
+		std::string part;
+
+		while (std::getline(stream, part, separator)) {
+			if (!part.empty()) {
+				parts.push_back(part);
+			}
+		}
+
+		return parts;
+	}
+
+	std::vector<uint32_t> parseCounts(const std::string& value) {
+		std::vector<uint32_t> counts;
+
+		for (const auto& part : split(value, ',')) {
+			counts.push_back(static_cast<uint32_t>(std::stoul(part)));
+		}
+
+		return counts;
+	}
+
+	std::vector<Resolution> parseResolutions(const std::string& value) {
+		std::vector<Resolution> resolutions;
+
+		for (const auto& part : split(value, ',')) {
+			std::vector<std::string> size = split(part, 'x');
+
+			if (size.size() != 2) {
+				throw std::runtime_error("Resolutions are expected as WIDTHxHEIGHT");
+			}
+
+			resolutions.push_back({ static_cast<uint32_t>(std::stoul(size[0])), static_cast<uint32_t>(std::stoul(size[1])) });
+		}
+
+		return resolutions;
+	}
+
+	// Orbits around the center of the sphere grid, looking at it from above, one revolution per run.
+	glm::mat4 getCameraTransform(uint32_t sphereCount, uint32_t frame, uint32_t frameCount) {
+		float side = std::ceil(std::sqrt(static_cast<float>(sphereCount)));
+		float extent = (side - 1.0f) * 7.0f;
+
+		glm::vec3 center{ extent / 2.0f, 1.0f, extent / 2.0f };
+		float radius = std::max(extent * 0.75f, 20.0f);
+		float height = std::max(extent * 0.3f, 8.0f);
+
+		float angle = glm::two_pi<float>() * frame / frameCount;
+		glm::vec3 position = center + glm::vec3{ radius * std::sin(angle), height, radius * std::cos(angle) };
+		glm::vec3 forward = glm::normalize(center - position);
+
+		glm::vec3 rotation{ -std::asin(forward.y), std::atan2(forward.x, forward.z), 0.0f };
+
+		return vrt::createCameraTransform(position, rotation);
+	}
+
+	void writeSummary(std::ostream& output, const char* name, const vrt::StatisticsSummary& summary) {
+		output << "\"" << name << "\": { \"min\": " << summary.min << ", \"mean\": " << summary.mean
+			<< ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99 << " }";
+	}
+}
+
+// Renders a fixed camera path over generated scenes headlessly and reports the throughput as JSON.
+// Usage: vrt_bench [output.json] [--scenes 25,10000] [--resolutions 1280x720,1920x1080] [--samples 1,2,4]
+//                  [--frames 120] [--warmup 10] [--seed 1] [--tune] [--wavefront]
+int main(int argc, char** argv) {
+	BenchConfiguration configuration{};
+	const char* outputPath = nullptr;
+
+	for (int index = 1; index < argc; index++) {
+		std::string argument = argv[index];
+		bool hasValue = index + 1 < argc;
+
+		if (argument == "--scenes" && hasValue) {
+			configuration.sphereCounts = parseCounts(argv[++index]);
+		} else if (argument == "--resolutions" && hasValue) {
+			configuration.resolutions = parseResolutions(argv[++index]);
+		} else if (argument == "--samples" && hasValue) {
+			configuration.samples = parseCounts(argv[++index]);
+		} else if (argument == "--frames" && hasValue) {
+			configuration.frames = static_cast<uint32_t>(std::stoul(argv[++index]));
+		} else if (argument == "--warmup" && hasValue) {
+			configuration.warmupFrames = static_cast<uint32_t>(std::stoul(argv[++index]));
+		} else if (argument == "--seed" && hasValue) {
+			configuration.seed = static_cast<uint32_t>(std::stoul(argv[++index]));
+		} else if (argument == "--tune") {
+			configuration.tune = true;
+		} else if (argument == "--wavefront") {
+			configuration.wavefront = true;
+		} else if (argument.rfind("--", 0) != 0) {
+			outputPath = argv[index];
+		} else {
+			std::cerr << "Unknown argument " << argument << std::endl;
+
+			return 1;
+		}
+	}
+
+	if (configuration.frames == 0) {
+		std::cerr << "At least one frame has to be rendered" << std::endl;
+
+		return 1;
+	}
+
+	if (configuration.tune && configuration.wavefront) {
+		std::cerr << "Only the workgroup size of the megakernel can be tuned" << std::endl;
+
+		return 1;
+	}
+
+	glm::vec3 lightDirection{ 1.0f, -2.0f, 0.5f };
+	lightDirection = glm::normalize(lightDirection);
+
+	std::stringstream results;
+	std::string deviceName;
+	bool firstResult = true;
+
+	for (uint32_t sphereCount : configuration.sphereCounts) {
+		vrt::Scene scene = vrt::createGridScene(sphereCount, configuration.seed);
+
+		for (const Resolution& resolution : configuration.resolutions) {
+			for (uint32_t samples : configuration.samples) {
+				std::cerr << sphereCount << " spheres, " << resolution.width << "x" << resolution.height << ", " << samples << " spp" << std::endl;
+
+				vrt::Options options{};
+				options.samplesPerPixel = samples;
+				options.wavefront = configuration.wavefront;
+
+				vrt::RayTracer rayTracer{ resolution.width, resolution.height, scene, options };
+				deviceName = rayTracer.getDeviceName();
+
+				vrt::Settings settings{};
+				settings.projection = vrt::createInverseProjectionMatrix(40.0f, static_cast<float>(resolution.width) / static_cast<float>(resolution.height));
+				settings.directionalLight = { lightDirection, 1.0f };
+				settings.useBvh = 1;
+
+				if (configuration.tune) {
+					settings.transform = getCameraTransform(sphereCount, 0, configuration.warmupFrames + configuration.frames);
+					rayTracer.updateSettings(settings);
+
+					for (const vrt::WorkgroupTiming& timing : rayTracer.tuneWorkgroupSize()) {
+						std::cerr << "  " << timing.size.width << "x" << timing.size.height << ": " << timing.time << " ms" << std::endl;
+					}
+				}
+
+				VkExtent2D workgroupSize = rayTracer.getWorkgroupSize();
+				vrt::RollingStatistics frameTimes{ configuration.frames };
+				std::vector<uint8_t> pixels;
+
+				auto startTime = std::chrono::steady_clock::now();
+				auto lastFrameTime = startTime;
+
+				for (uint32_t frame = 0; frame < configuration.warmupFrames + configuration.frames; frame++) {
+					// The animation advances as if the viewer was running at 60 frames per second
+					settings.transform = getCameraTransform(sphereCount, frame, configuration.warmupFrames + configuration.frames);
+					settings.angle = frame * 0.8f / 60.0f;
+
+					rayTracer.updateSettings(settings);
+					rayTracer.drawFrame();
+
+					auto now = std::chrono::steady_clock::now();
+
+					if (frame == configuration.warmupFrames) {
+						startTime = lastFrameTime;
+					}
+
+					if (frame >= configuration.warmupFrames) {
+						frameTimes.add(std::chrono::duration<double, std::milli>(now - lastFrameTime).count());
+					}
+
+					lastFrameTime = now;
+				}
+
+				// Waits for the last frame, so the measured time covers all the GPU work
+				rayTracer.readFrame(pixels);
+
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+				double primaryRays = static_cast<double>(resolution.width) * resolution.height * samples * configuration.frames;
+
+				vrt::FrameStatistics statistics = rayTracer.getFrameStatistics();
+				vrt::MemoryStatistics memory = rayTracer.getMemoryStatistics();
+
+				results << (firstResult ? "" : ",\n") << "    { "
+					<< "\"spheres\": " << sphereCount << ", "
+					<< "\"width\": " << resolution.width << ", "
+					<< "\"height\": " << resolution.height << ", "
+					<< "\"samples\": " << samples << ", "
+					<< "\"workgroupSize\": \"" << workgroupSize.width << "x" << workgroupSize.height << "\", "
+					<< "\"wavefront\": " << (configuration.wavefront ? "true" : "false") << ", "
+					<< "\"frames\": " << configuration.frames << ", "
+					<< "\"seconds\": " << seconds << ", "
+					<< "\"framesPerSecond\": " << configuration.frames / seconds << ", "
+					<< "\"primaryMraysPerSecond\": " << primaryRays / seconds / 1e6 << ", "
+					<< "\"memoryBlocks\": " << memory.blockCount << ", "
+					<< "\"memoryUsedBytes\": " << memory.usedBytes << ", ";
+
+				writeSummary(results, "frameTimeMs", frameTimes.getSummary());
+				results << ", ";
+				writeSummary(results, "gpuComputeMs", statistics.computeTime);
+				results << " }";
+
+				firstResult = false;
+			}
+		}
+	}
+
+	std::stringstream json;
+	json << "{\n  \"device\": \"" << deviceName << "\",\n  \"seed\": " << configuration.seed << ",\n  \"results\": [\n" << results.str() << "\n  ]\n}\n";
+
+	if (outputPath == nullptr) {
+		std::cout << json.str();
+	} else {
+		std::ofstream file(outputPath);
+
+		if (!file.is_open()) {
+			std::cerr << "Failed to open " << outputPath << std::endl;
+
+			return 1;
+		}
+
+		file << json.str();
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "vrt_farm.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Renders the frames of the scene animation on worker processes, started locally or connecting from other nodes, and
+// writes a PPM image per frame. ADDRESS is tcp:HOST:PORT or unix:PATH.
+// Usage: vrt_farm coordinator ADDRESS [--scene scene.vrts] [--first 0] [--frames 120] [--resolution 1920x1080]
+//                 [--tile 256] [--passes 1] [--local-workers 4] [--output frame_%04d.ppm] [--timeout 60]
+//        vrt_farm worker ADDRESS [--timeout 60]
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "Usage: vrt_farm coordinator|worker ADDRESS [options]" << std::endl;
+
+		return 1;
+	}
+
+	std::string role = argv[1];
+
+	vrt::FarmOptions options{};
+	options.address = argv[2];
+
+	for (int index = 3; index < argc; index++) {
+		std::string argument = argv[index];
+		bool hasValue = index + 1 < argc;
+
+		if (argument == "--scene" && hasValue) {
+			options.scenePath = argv[++index];
+		} else if (argument == "--first" && hasValue) {
+			options.firstFrame = static_cast<uint32_t>(std::stoul(argv[++index]));
+		} else if (argument == "--frames" && hasValue) {
+			options.frameCount = static_cast<uint32_t>(std::stoul(argv[++index]));
+		} else if (argument == "--resolution" && hasValue) {
+			std::stringstream resolution{ argv[++index] };
+			char separator = 0;
+
+			if (!(resolution >> options.frameWidth >> separator >> options.frameHeight) || separator != 'x') {
+				std::cerr << "Resolutions are expected as WIDTHxHEIGHT" << std::endl;
+
+				return 1;
+			}
+		} else if (argument == "--tile" && hasValue) {
+			options.tileSize = static_cast<uint32_t>(std::stoul(argv[++index]));
+		} else if (argument == "--passes" && hasValue) {
+			options.passCount = static_cast<uint32_t>(std::stoul(argv[++index]));
+		} else if (argument == "--local-workers" && hasValue) {
+			options.localWorkerCount = static_cast<uint32_t>(std::stoul(argv[++index]));
+		} else if (argument == "--output" && hasValue) {
+			options.outputPattern = argv[++index];
+		} else if (argument == "--timeout" && hasValue) {
+			options.timeout = std::stof(argv[++index]);
+		} else {
+			std::cerr << "Unknown argument " << argument << std::endl;
+
+			return 1;
+		}
+	}
+
+	if (role == "coordinator") {
+		vrt::runFarmCoordinator(options, argv[0], [](const vrt::FarmEvent& event) {
+			if (event.type == vrt::FarmEventType::FrameWritten) {
+				std::cout << "Frame " << event.frame << " written to " << event.path << std::endl;
+			} else {
+				std::cerr << "A worker " << event.reason << ", " << event.requeuedJobCount << " jobs handed out again" << std::endl;
+			}
+		});
+	} else if (role == "worker") {
+		vrt::runFarmWorker(options.address, options.timeout);
+	} else {
+		std::cerr << "Unknown role " << role << std::endl;
+
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
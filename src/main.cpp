@@ -1,14 +1,29 @@
+#include "vrt_window.hpp"
 #include "vrt_ray_tracer.hpp"
 #include "vrt_camera.hpp"
+#include "vrt_frame_writer.hpp"
 
 #include <iostream>
 #include <chrono>
 
-int main() {
+// Usage: vulkan_ray_tracer [scene.vrts]
+int main(int argc, char** argv) {
     vrt::Window window{};
-    vrt::RayTracer rayTracer{ window };
 
-    vrt::Camera camera{ 40.0f, 1024.0f / 768.0f };
+    auto loadStart = std::chrono::high_resolution_clock::now();
+
+    // The traced resolution drops when a frame would not fit in 60 Hz
+    vrt::Options options;
+    options.frameTimeBudget = 16.0f;
+
+    vrt::RayTracer rayTracer = argc > 1
+        ? vrt::RayTracer{ window, vrt::SceneFile{ argv[1] }, options }
+        : vrt::RayTracer{ window, vrt::createDefaultScene(), options };
+
+    float loadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - loadStart).count();
+
+    VkExtent2D outputExtent = rayTracer.getOutputExtent();
+    vrt::Camera camera{ 40.0f, static_cast<float>(outputExtent.width) / outputExtent.height };
 
     glm::vec3 lightDirection{ 1.0f, -2.0f, 0.5f };
     lightDirection = glm::normalize(lightDirection);
@@ -16,12 +31,40 @@ int main() {
     vrt::Settings settings{};
     settings.projection = camera.getProjectionMatrix();
     settings.directionalLight = { lightDirection, 1.0f };
+    settings.useBvh = 1;
 
     float lightAngle = 10.0f;
 
-    std::cout << "Init done!" << std::endl;
+    std::cout << "Init done in " << loadTime << " ms" << std::endl;
+
+    const vrt::StartupStatistics& startup = rayTracer.getStartupStatistics();
+
+    for (const auto& stage : startup.stages) {
+        std::cout << "  " << stage.name << ": " << stage.time << " ms" << std::endl;
+    }
+
+    std::cout << "  assets loaded after " << startup.assetLoading << " ms on worker threads" << std::endl;
+
+    vrt::MemoryStatistics memory = rayTracer.getMemoryStatistics();
+    std::cout << "Device memory: " << memory.allocationCount << " resources in " << memory.blockCount << " blocks, "
+        << memory.usedBytes / (1024 * 1024) << " of " << memory.blockBytes / (1024 * 1024) << " MiB used" << std::endl;
 
     auto currentTime = std::chrono::high_resolution_clock::now();
+    bool bvhKeyPressed = false;
+    bool accumulationKeyPressed = false;
+    bool captureKeyPressed = false;
+    bool isCapturing = false;
+
+    // PPM encodes quickly enough to follow the frame rate, the files are numbered across the captures
+    vrt::FrameWriterOptions writerOptions;
+    writerOptions.output = "capture_%05llu.ppm";
+    writerOptions.format = vrt::ImageFileFormat::Ppm;
+
+    vrt::FrameWriter frameWriter{ writerOptions };
+    uint64_t capturedFrameCount = 0;
+
+    float statisticsElapsed = 0.0f;
+    bool hasDrawn = false;
 
     while (!window.shouldClose()) {
         glfwPollEvents();
@@ -29,17 +72,94 @@ int main() {
         auto newTime = std::chrono::high_resolution_clock::now();
         float elapsed = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
 
+        bool bvhKeyDown = glfwGetKey(window.getWindowHandle(), GLFW_KEY_B) == GLFW_PRESS;
+
+        if (bvhKeyDown && !bvhKeyPressed) {
+            settings.useBvh = settings.useBvh ? 0 : 1;
+
+            std::cout << "Sphere traversal: " << (settings.useBvh ? "BVH" : "linear") << std::endl;
+        }
+
+        bvhKeyPressed = bvhKeyDown;
+
+        bool accumulationKeyDown = glfwGetKey(window.getWindowHandle(), GLFW_KEY_C) == GLFW_PRESS;
+
+        if (accumulationKeyDown && !accumulationKeyPressed) {
+            rayTracer.setAccumulationEnabled(!rayTracer.isAccumulationEnabled());
+
+            std::cout << "Accumulation: " << (rayTracer.isAccumulationEnabled() ? "on" : "off") << std::endl;
+        }
+
+        accumulationKeyPressed = accumulationKeyDown;
+
+        bool captureKeyDown = glfwGetKey(window.getWindowHandle(), GLFW_KEY_R) == GLFW_PRESS;
+
+        if (captureKeyDown && !captureKeyPressed) {
+            isCapturing = !isCapturing;
+
+            if (isCapturing) {
+                rayTracer.setFrameCapture([&](const vrt::CapturedFrame& frame) {
+                    frameWriter.write(capturedFrameCount++, frame.width, frame.height, frame.pixels);
+                });
+            } else {
+                rayTracer.setFrameCapture({});
+            }
+
+            std::cout << "Capture: " << (isCapturing ? "on" : "off") << std::endl;
+        }
+
+        captureKeyPressed = captureKeyDown;
+
         camera.move(window.getWindowHandle(), elapsed);
         settings.transform = camera.getWorldTransform();
-        settings.angle += elapsed * 0.8f;
+
+        // The animation would reset the accumulation every frame, so it is paused while accumulating
+        if (!rayTracer.isAccumulationEnabled()) {
+            settings.angle += elapsed * 0.8f;
+        }
 
         if (!window.isMinimized()) {
             rayTracer.updateSettings(settings);
             rayTracer.drawFrame();
+
+            // The swap chain follows the window, the projection follows the swap chain
+            VkExtent2D extent = rayTracer.getOutputExtent();
+
+            if (extent.width != outputExtent.width || extent.height != outputExtent.height) {
+                outputExtent = extent;
+                camera.setPerspective(40.0f, static_cast<float>(outputExtent.width) / outputExtent.height);
+                settings.projection = camera.getProjectionMatrix();
+            }
+
+            if (!hasDrawn) {
+                std::cout << "First frame submitted after " << rayTracer.getStartupStatistics().firstFrame << " ms" << std::endl;
+                hasDrawn = true;
+            }
+        }
+
+        statisticsElapsed += elapsed;
+
+        if (statisticsElapsed > 5.0f) {
+            vrt::FrameStatistics statistics = rayTracer.getFrameStatistics();
+
+            std::cout << "compute " << statistics.computeTime.mean << " ms (p99 " << statistics.computeTime.p99 << ")"
+                << ", render " << statistics.renderTime.mean << " ms (p99 " << statistics.renderTime.p99 << ")"
+                << ", submit " << statistics.submitTime.mean << " ms"
+                << ", frame " << statistics.presentInterval.mean << " ms (p99 " << statistics.presentInterval.p99 << ")"
+                << ", scale " << rayTracer.getRenderScale() << std::endl;
+
+            statisticsElapsed = 0.0f;
         }
 
         currentTime = newTime;
     }
 
+    rayTracer.setFrameCapture({});
+    frameWriter.flush();
+
+    if (capturedFrameCount > 0) {
+        std::cout << frameWriter.getWrittenFrameCount() << " frames captured" << std::endl;
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "vrt_scene_file.hpp"
+#include "vrt_mesh.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+// Writes a generated grid scene and its BVH in the binary scene format, with an optional OBJ mesh in its own coordinates.
+// Usage: vrt_make_scene [output.vrts] [sphereCount] [seed] [mesh.obj]
+int main(int argc, char** argv) {
+	const char* outputPath = argc > 1 ? argv[1] : "scene.vrts";
+	uint32_t sphereCount = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 25;
+	uint32_t seed = argc > 3 ? static_cast<uint32_t>(atoi(argv[3])) : 0;
+	const char* meshPath = argc > 4 ? argv[4] : nullptr;
+
+	try {
+		auto start = std::chrono::steady_clock::now();
+		vrt::Scene scene = vrt::createGridScene(sphereCount, seed);
+
+		if (meshPath != nullptr) {
+			scene.materials.push_back({ { 0.8f, 0.8f, 0.8f }, { 0.05f, 0.05f, 0.05f } });
+			vrt::addMesh(scene, vrt::loadObjMesh(meshPath), glm::mat4(1.0f), static_cast<uint32_t>(scene.materials.size() - 1));
+		}
+
+		vrt::writeSceneFile(outputPath, scene);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "Wrote " << sphereCount << " spheres to " << outputPath << " in " << seconds << " s" << std::endl;
+
+		auto loadStart = std::chrono::steady_clock::now();
+		vrt::SceneFile sceneFile{ outputPath };
+		double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+
+		std::cout << "Mapped " << sceneFile.getSize() << " bytes in " << loadSeconds * 1000.0 << " ms" << std::endl;
+	} catch (const std::exception& exception) {
+		std::cerr << exception.what() << std::endl;
+
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
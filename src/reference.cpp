@@ -0,0 +1,50 @@
+#include "vrt_cpu_ray_tracer.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+// Renders the default scene on the CPU and writes it as a binary PPM image.
+// Usage: vrt_reference [output.ppm] [width] [height] [threads]
+int main(int argc, char** argv) {
+	const char* outputPath = argc > 1 ? argv[1] : "reference.ppm";
+	uint32_t width = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 1024;
+	uint32_t height = argc > 3 ? static_cast<uint32_t>(atoi(argv[3])) : 768;
+	uint32_t threadCount = argc > 4 ? static_cast<uint32_t>(atoi(argv[4])) : 0;
+
+	vrt::Scene scene = vrt::createDefaultScene();
+	vrt::CpuRayTracer rayTracer{ scene, threadCount };
+
+	glm::vec3 lightDirection{ 1.0f, -2.0f, 0.5f };
+	lightDirection = glm::normalize(lightDirection);
+
+	vrt::Settings settings{};
+	settings.projection = vrt::createInverseProjectionMatrix(40.0f, static_cast<float>(width) / static_cast<float>(height));
+	settings.transform = glm::mat4{ 1.0f };
+	settings.directionalLight = { lightDirection, 1.0f };
+	settings.useBvh = 1;
+
+	std::vector<uint8_t> pixels;
+	rayTracer.render(settings, width, height, pixels);
+
+	std::ofstream file(outputPath, std::ios::binary);
+
+	if (!file.is_open()) {
+		std::cerr << "Failed to open " << outputPath << std::endl;
+
+		return 1;
+	}
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	for (size_t index = 0; index < pixels.size(); index += 4) {
+		file.write(reinterpret_cast<const char*>(&pixels[index]), 3);
+	}
+
+	const vrt::CpuRenderStatistics& statistics = rayTracer.getStatistics();
+
+	std::cout << "Traced " << statistics.rayCount << " rays in " << statistics.seconds << " s on " << statistics.threadCount << " threads" << std::endl;
+	std::cout << statistics.getRaysPerSecond() / 1e6 << " Mrays/s, " << statistics.getRaysPerSecondPerCore() / 1e6 << " Mrays/s per core" << std::endl;
+
+	return 0;
+}
\ No newline at end of file
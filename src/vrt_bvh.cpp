@@ -0,0 +1,226 @@
+#include "vrt_bvh.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace vrt {
+	namespace {
+		const uint32_t BIN_COUNT = 16;
+		const uint32_t MAX_LEAF_SIZE = 4;
+
+		// Matches BVH_STACK_SIZE in ray_tracing.comp, deeper nodes are turned into leaves
+		const uint32_t MAX_DEPTH = 32;
+
+		const float FLOAT_MAX = std::numeric_limits<float>::max();
+
+		struct Bounds {
+			glm::vec3 min{ FLOAT_MAX, FLOAT_MAX, FLOAT_MAX };
+			glm::vec3 max{ -FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX };
+
+			void grow(const glm::vec3& point) {
+				min = glm::min(min, point);
+				max = glm::max(max, point);
+			}
+
+			void grow(const Bounds& bounds) {
+				min = glm::min(min, bounds.min);
+				max = glm::max(max, bounds.max);
+			}
+
+			float getArea() const {
+				if (min.x > max.x) {
+					return 0.0f;
+				}
+
+				glm::vec3 extent = max - min;
+
+				return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+			}
+		};
+
+		struct Bin {
+			Bounds bounds;
+			uint32_t count = 0;
+		};
+
+		struct BuildTask {
+			uint32_t nodeIndex;
+			uint32_t first;
+			uint32_t count;
+			uint32_t depth;
+		};
+
+		Bvh buildBoundsBvh(const std::vector<Bounds>& primitiveBounds) {
+			uint32_t primitiveCount = static_cast<uint32_t>(primitiveBounds.size());
+
+			std::vector<glm::vec3> centroids{ primitiveCount };
+
+			for (uint32_t i = 0; i < primitiveCount; i++) {
+				centroids[i] = (primitiveBounds[i].min + primitiveBounds[i].max) * 0.5f;
+			}
+
+			Bvh bvh{};
+			bvh.indices.resize(primitiveCount);
+			std::iota(bvh.indices.begin(), bvh.indices.end(), 0);
+
+			bvh.nodes.reserve(2 * static_cast<size_t>(primitiveCount) - 1);
+			bvh.nodes.push_back({});
+
+			std::vector<BuildTask> tasks{ { 0, 0, primitiveCount, 0 } };
+
+			while (!tasks.empty()) {
+				BuildTask task = tasks.back();
+				tasks.pop_back();
+
+				Bounds bounds{};
+				Bounds centroidBounds{};
+
+				for (uint32_t i = task.first; i < task.first + task.count; i++) {
+					bounds.grow(primitiveBounds[bvh.indices[i]]);
+					centroidBounds.grow(centroids[bvh.indices[i]]);
+				}
+
+				bvh.nodes[task.nodeIndex].min = bounds.min;
+				bvh.nodes[task.nodeIndex].max = bounds.max;
+
+				if (task.count <= MAX_LEAF_SIZE || task.depth >= MAX_DEPTH) {
+					bvh.nodes[task.nodeIndex].leftOrFirst = task.first;
+					bvh.nodes[task.nodeIndex].count = task.count;
+
+					continue;
+				}
+
+				float bestCost = FLOAT_MAX;
+				int bestAxis = -1;
+				uint32_t bestSplit = 0;
+
+				for (int axis = 0; axis < 3; axis++) {
+					float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+
+					if (extent <= 0.0f) {
+						continue;
+					}
+
+					Bin bins[BIN_COUNT];
+					float scale = BIN_COUNT / extent;
+
+					for (uint32_t i = task.first; i < task.first + task.count; i++) {
+						uint32_t binIndex = std::min(BIN_COUNT - 1, static_cast<uint32_t>((centroids[bvh.indices[i]][axis] - centroidBounds.min[axis]) * scale));
+
+						bins[binIndex].bounds.grow(primitiveBounds[bvh.indices[i]]);
+						bins[binIndex].count++;
+					}
+
+					float leftAreas[BIN_COUNT - 1];
+					uint32_t leftCounts[BIN_COUNT - 1];
+
+					Bounds leftBounds{};
+					uint32_t leftCount = 0;
+
+					for (uint32_t i = 0; i < BIN_COUNT - 1; i++) {
+						leftBounds.grow(bins[i].bounds);
+						leftCount += bins[i].count;
+
+						leftAreas[i] = leftBounds.getArea();
+						leftCounts[i] = leftCount;
+					}
+
+					Bounds rightBounds{};
+					uint32_t rightCount = 0;
+
+					for (uint32_t i = BIN_COUNT - 1; i > 0; i--) {
+						rightBounds.grow(bins[i].bounds);
+						rightCount += bins[i].count;
+
+						if (leftCounts[i - 1] == 0 || rightCount == 0) {
+							continue;
+						}
+
+						float cost = leftCounts[i - 1] * leftAreas[i - 1] + rightCount * rightBounds.getArea();
+
+						if (cost < bestCost) {
+							bestCost = cost;
+							bestAxis = axis;
+							bestSplit = i;
+						}
+					}
+				}
+
+				uint32_t leftCount;
+
+				if (bestAxis >= 0) {
+					float scale = BIN_COUNT / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+
+					auto middle = std::partition(bvh.indices.begin() + task.first, bvh.indices.begin() + task.first + task.count, [&](uint32_t index) {
+						uint32_t binIndex = std::min(BIN_COUNT - 1, static_cast<uint32_t>((centroids[index][bestAxis] - centroidBounds.min[bestAxis]) * scale));
+
+						return binIndex < bestSplit;
+					});
+
+					leftCount = static_cast<uint32_t>(middle - (bvh.indices.begin() + task.first));
+				} else {
+					// Every centroid is at the same position, any split is as good as another
+					leftCount = task.count / 2;
+				}
+
+				uint32_t leftIndex = static_cast<uint32_t>(bvh.nodes.size());
+
+				bvh.nodes[task.nodeIndex].leftOrFirst = leftIndex;
+				bvh.nodes[task.nodeIndex].count = 0;
+
+				bvh.nodes.push_back({});
+				bvh.nodes.push_back({});
+
+				tasks.push_back({ leftIndex + 1, task.first + leftCount, task.count - leftCount, task.depth + 1 });
+				tasks.push_back({ leftIndex, task.first, leftCount, task.depth + 1 });
+			}
+
+			return bvh;
+		}
+	}
+
+	Bvh buildBvh(const std::vector<Sphere>& spheres, const std::vector<SphereAnimation>& animations) {
+		if (spheres.empty()) {
+			throw std::runtime_error("Cannot build a BVH without any sphere");
+		}
+
+		if (!animations.empty() && animations.size() != spheres.size()) {
+			throw std::runtime_error("Every sphere needs an animation");
+		}
+
+		std::vector<Bounds> primitiveBounds{ spheres.size() };
+
+		for (size_t i = 0; i < spheres.size(); i++) {
+			getSphereBounds(spheres[i], animations.empty() ? SphereAnimation{} : animations[i], primitiveBounds[i].min, primitiveBounds[i].max);
+		}
+
+		return buildBoundsBvh(primitiveBounds);
+	}
+
+	Bvh buildTriangleBvh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices) {
+		if (indices.empty() || indices.size() % 3 != 0) {
+			throw std::runtime_error("Cannot build a BVH without whole triangles");
+		}
+
+		std::vector<Bounds> primitiveBounds{ indices.size() / 3 };
+
+		for (size_t i = 0; i < primitiveBounds.size(); i++) {
+			for (size_t vertex = 0; vertex < 3; vertex++) {
+				primitiveBounds[i].grow(positions[indices[3 * i + vertex]]);
+			}
+		}
+
+		return buildBoundsBvh(primitiveBounds);
+	}
+
+	void getSphereBounds(const Sphere& sphere, const SphereAnimation& animation, glm::vec3& min, glm::vec3& max) {
+		// The sine stays within [-1, 1], so the center moves by at most the amplitude around the offset position
+		glm::vec3 center = sphere.position + animation.offset;
+		glm::vec3 extent = glm::abs(animation.amplitude) + glm::vec3(sphere.radius);
+
+		min = center - extent;
+		max = center + extent;
+	}
+}
\ No newline at end of file
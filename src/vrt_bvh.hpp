@@ -0,0 +1,26 @@
+#ifndef __VULKAN_RAY_TRACING_BVH_HPP__
+#define __VULKAN_RAY_TRACING_BVH_HPP__
+
+#include "vrt_scene.hpp"
+
+#include <vector>
+
+namespace vrt {
+	struct Bvh {
+		std::vector<BvhNode> nodes;
+		std::vector<uint32_t> indices;
+	};
+
+	// Binned SAH build over the spheres, the node at index 0 is the root. Spheres are referenced through
+	// the index buffer rather than reordered, so they keep matching their animation and update indices.
+	// The animations are either one per sphere or empty for static spheres.
+	Bvh buildBvh(const std::vector<Sphere>& spheres, const std::vector<SphereAnimation>& animations);
+
+	// Same build over the triangles of an indexed mesh, the index buffer holds triangle indices.
+	Bvh buildTriangleBvh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+
+	// Bounds of a sphere over its whole animation, so the hierarchy stays valid at every time.
+	void getSphereBounds(const Sphere& sphere, const SphereAnimation& animation, glm::vec3& min, glm::vec3& max);
+}
+
+#endif
\ No newline at end of file
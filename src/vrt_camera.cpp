@@ -1,22 +1,11 @@
 #include "vrt_camera.hpp"
+#include "vrt_scene.hpp"
 
 #include <glm/gtx/transform.hpp>
 
 namespace vrt {
     Camera::Camera(float fov, float aspect) : _position{ 0.0f }, _rotation{ 0.0f, 0.0f, 0.0f } {
-		const float tanHalfFOV = tan(glm::radians(fov) / 2.0f);
-		float far = 10.0f;
-		float near = 0.1f;
-
-		_projection = glm::mat4{ 0.0f };
-		_projection[0][0] = 1.0f / (aspect * tanHalfFOV);
-		_projection[1][1] = 1.0f / tanHalfFOV;
-		_projection[2][2] = far / (far - near);
-		_projection[2][3] = 1.0f;
-		_projection[3][2] = -(far * near) / (far - near);
-		_projection = glm::inverse(_projection);
-
-		_position = { 0.0f, 0.0f, 0.0f };
+		_projection = createInverseProjectionMatrix(fov, aspect);
 	}
 
     Camera::~Camera() { }
@@ -87,19 +76,7 @@ namespace vrt {
     }
 
 	const glm::mat4 Camera::getWorldTransform() const {
-        const float c3 = glm::cos(_rotation.z);
-        const float s3 = glm::sin(_rotation.z);
-        const float c2 = glm::cos(_rotation.x);
-        const float s2 = glm::sin(_rotation.x);
-        const float c1 = glm::cos(_rotation.y);
-        const float s1 = glm::sin(_rotation.y);
-
-        return glm::mat4{
-            { (c1 * c3 + s1 * s2 * s3), (c2 * s3), (c1 * s2 * s3 - c3 * s1), 0.0f },
-            { (c3 * s1 * s2 - c1 * s3), (c2 * c3), (c1 * c3 * s2 + s1 * s3), 0.0f },
-            { (c2 * s1), (-s2), (c1 * c2), 0.0f },
-            { _position.x, _position.y, _position.z, 1.0f }
-        };
+        return createCameraTransform(_position, _rotation);
 	}
 
 	const glm::mat4& Camera::getProjectionMatrix() const {
@@ -0,0 +1,656 @@
+#include "vrt_cpu_ray_tracer.hpp"
+#include "vrt_sky_box.hpp"
+
+#include "stb_image.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace vrt {
+	namespace {
+		const float FLOAT_MAX = std::numeric_limits<float>::max();
+
+		// R2 sequence constants in 0.32 fixed point, as in the shader
+		const uint32_t ANTIALIASING_QUASIRANDOM_SEED_A = 3242174889u;
+		const uint32_t ANTIALIASING_QUASIRANDOM_SEED_B = 2447445414u;
+	}
+
+	CpuRayTracer::CpuRayTracer(const Scene& scene, uint32_t threadCount) : _scene{ scene }, _threadPool{ threadCount }, _statistics{} {
+		if (!_scene.spheres.empty()) {
+			_bvh = buildBvh(_scene.spheres, _scene.animations);
+		}
+
+		// Same mip chain as the GPU, kept uncompressed
+		for (size_t index = 0; index < 6; index++) {
+			int texWidth, texHeight, texChannels;
+			stbi_uc* layer = stbi_load(SKY_BOX_TEXTURE_PATHS[index], &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+			if (!layer) {
+				throw std::runtime_error("Failed to load the skybox texture image!");
+			}
+
+			if (texWidth != texHeight || (index > 0 && static_cast<uint32_t>(texWidth) != _skyBox.size)) {
+				stbi_image_free(layer);
+
+				throw std::runtime_error("The sky box faces do not have the same size");
+			}
+
+			_skyBox.size = static_cast<uint32_t>(texWidth);
+			_skyBox.layers[index] = convertSkyBoxFace(layer, _skyBox.size, SkyBoxFormat::Rgba8);
+
+			stbi_image_free(layer);
+		}
+	}
+
+	void CpuRayTracer::render(const Settings& settings, uint32_t width, uint32_t height, std::vector<uint8_t>& pixels) {
+		pixels.resize(static_cast<size_t>(width) * height * 4);
+
+		_spherePositions.resize(_scene.spheres.size());
+
+		for (size_t index = 0; index < _scene.spheres.size(); index++) {
+			const Sphere& sphere = _scene.spheres[index];
+			glm::vec3 position = _scene.animations.empty() ? sphere.position : getAnimatedPosition(sphere, _scene.animations[index], settings.angle);
+
+			_spherePositions[index] = glm::vec4(position, sphere.radius);
+		}
+
+		std::atomic<uint64_t> rayCount{ 0 };
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		for (uint32_t tileY = 0; tileY < height; tileY += TILE_SIZE) {
+			for (uint32_t tileX = 0; tileX < width; tileX += TILE_SIZE) {
+				_threadPool.submit([this, &settings, &pixels, &rayCount, tileX, tileY, width, height] {
+					rayCount += renderTile(settings, tileX, tileY, width, height, pixels.data());
+				});
+			}
+		}
+
+		_threadPool.wait();
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		_statistics.rayCount = rayCount;
+		_statistics.seconds = std::chrono::duration<double, std::chrono::seconds::period>(endTime - startTime).count();
+		_statistics.threadCount = _threadPool.getThreadCount();
+	}
+
+	uint64_t CpuRayTracer::renderTile(const Settings& settings, uint32_t tileX, uint32_t tileY, uint32_t width, uint32_t height, uint8_t* pixels) const {
+		uint64_t rayCount = 0;
+
+		uint32_t endX = std::min(tileX + TILE_SIZE, width);
+		uint32_t endY = std::min(tileY + TILE_SIZE, height);
+
+		for (uint32_t y = tileY; y < endY; y++) {
+			for (uint32_t x = tileX; x < endX; x++) {
+				glm::vec3 result{ 0.0f, 0.0f, 0.0f };
+
+				for (uint32_t i = 0; i < ANTIALIASING_SAMPLES; i++) {
+					Ray ray = createCameraRay(settings, x, y, width, height, settings.frameIndex * ANTIALIASING_SAMPLES + i);
+
+					for (int bounce = 0; bounce < MAX_BOUNCES; bounce++) {
+						RayHit hit = trace(settings, ray);
+						rayCount++;
+
+						// shade updates the energy for the next bounce, the operands of glm operators are references
+						glm::vec3 energy = ray.energy;
+						result += energy * shade(settings, ray, hit, rayCount);
+
+						if (ray.energy.x == 0.0f && ray.energy.y == 0.0f && ray.energy.z == 0.0f) {
+							break;
+						}
+					}
+				}
+
+				result = glm::clamp(result / static_cast<float>(ANTIALIASING_SAMPLES), 0.0f, 1.0f);
+
+				uint8_t* pixel = pixels + (static_cast<size_t>(y) * width + x) * 4;
+				pixel[0] = static_cast<uint8_t>(result.x * 255.0f + 0.5f);
+				pixel[1] = static_cast<uint8_t>(result.y * 255.0f + 0.5f);
+				pixel[2] = static_cast<uint8_t>(result.z * 255.0f + 0.5f);
+				pixel[3] = 255;
+			}
+		}
+
+		return rayCount;
+	}
+
+	CpuRayTracer::Ray CpuRayTracer::createCameraRay(const Settings& settings, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t rayIndex) const {
+		uint32_t quasiRandomOffsetX = rayIndex * ANTIALIASING_QUASIRANDOM_SEED_A + 0x80000000u;
+		uint32_t quasiRandomOffsetY = rayIndex * ANTIALIASING_QUASIRANDOM_SEED_B + 0x80000000u;
+
+		glm::vec2 quasiRandomOffset = glm::vec2(static_cast<float>(quasiRandomOffsetX >> 8), static_cast<float>(quasiRandomOffsetY >> 8)) / 16777216.0f;
+		glm::vec2 viewCoordinates = glm::vec2(static_cast<float>(x), static_cast<float>(y)) + quasiRandomOffset;
+		glm::vec2 clipCoordinates = viewCoordinates / glm::vec2(static_cast<float>(width), static_cast<float>(height)) * 2.0f - 1.0f;
+
+		glm::vec4 origin = settings.transform * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		glm::vec4 direction = settings.transform * glm::vec4(glm::vec3(settings.projection * glm::vec4(clipCoordinates, 0.0f, 1.0f)), 0.0f);
+
+		glm::vec2 neighbourCoordinates = (viewCoordinates + glm::vec2(1.0f, 0.0f)) / glm::vec2(static_cast<float>(width), static_cast<float>(height)) * 2.0f - 1.0f;
+		glm::vec4 neighbourDirection = settings.transform * glm::vec4(glm::vec3(settings.projection * glm::vec4(neighbourCoordinates, 0.0f, 1.0f)), 0.0f);
+
+		Ray ray{ glm::vec3(origin), glm::normalize(glm::vec3(direction)), glm::vec3(1.0f, 1.0f, 1.0f), 0.0f, 0.0f };
+		ray.coneSpread = glm::length(glm::normalize(glm::vec3(neighbourDirection)) - ray.direction);
+
+		return ray;
+	}
+
+	CpuRayTracer::RayHit CpuRayTracer::trace(const Settings& settings, const Ray& ray) const {
+		RayHit bestHit{ FLOAT_MAX, glm::vec3(0.0f), 0 };
+
+		for (uint32_t i = 0; i < static_cast<uint32_t>(_scene.planes.size()); i++) {
+			intersectPlane(ray, bestHit, _scene.planes[i], i);
+		}
+
+		for (uint32_t i = 0; i < static_cast<uint32_t>(_scene.meshes.size()); i++) {
+			traverseMesh(ray, bestHit, i);
+		}
+
+		if (settings.useBvh != 0 && !_bvh.nodes.empty()) {
+			traverseSpheres(ray, bestHit);
+		} else {
+			for (uint32_t i = 0; i < static_cast<uint32_t>(_scene.spheres.size()); i++) {
+				intersectSphere(ray, bestHit, i);
+			}
+		}
+
+		return bestHit;
+	}
+
+	void CpuRayTracer::traverseSpheres(const Ray& ray, RayHit& bestHit) const {
+		glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+		if (intersectBox(ray, inverseDirection, _bvh.nodes[0].min, _bvh.nodes[0].max, bestHit.distance) == FLOAT_MAX) {
+			return;
+		}
+
+		uint32_t stack[BVH_STACK_SIZE];
+		uint32_t stackSize = 0;
+		uint32_t nodeIndex = 0;
+
+		while (true) {
+			const BvhNode& node = _bvh.nodes[nodeIndex];
+
+			if (node.count > 0) {
+				for (uint32_t i = 0; i < node.count; i++) {
+					intersectSphere(ray, bestHit, _bvh.indices[node.leftOrFirst + i]);
+				}
+
+				if (stackSize == 0) {
+					break;
+				}
+
+				nodeIndex = stack[--stackSize];
+			} else {
+				uint32_t nearIndex = node.leftOrFirst;
+				uint32_t farIndex = node.leftOrFirst + 1;
+
+				float nearDistance = intersectBox(ray, inverseDirection, _bvh.nodes[nearIndex].min, _bvh.nodes[nearIndex].max, bestHit.distance);
+				float farDistance = intersectBox(ray, inverseDirection, _bvh.nodes[farIndex].min, _bvh.nodes[farIndex].max, bestHit.distance);
+
+				if (farDistance < nearDistance) {
+					std::swap(nearIndex, farIndex);
+					std::swap(nearDistance, farDistance);
+				}
+
+				if (nearDistance == FLOAT_MAX) {
+					if (stackSize == 0) {
+						break;
+					}
+
+					nodeIndex = stack[--stackSize];
+				} else {
+					nodeIndex = nearIndex;
+
+					if (farDistance != FLOAT_MAX) {
+						stack[stackSize++] = farIndex;
+					}
+				}
+			}
+		}
+	}
+
+	bool CpuRayTracer::occluded(const Settings& settings, const Ray& ray) const {
+		for (const auto& plane : _scene.planes) {
+			if (occludesPlane(ray, plane)) {
+				return true;
+			}
+		}
+
+		for (uint32_t i = 0; i < static_cast<uint32_t>(_scene.meshes.size()); i++) {
+			if (traverseMeshAnyHit(ray, i)) {
+				return true;
+			}
+		}
+
+		if (settings.useBvh != 0 && !_bvh.nodes.empty()) {
+			return traverseSpheresAnyHit(ray);
+		}
+
+		for (uint32_t i = 0; i < static_cast<uint32_t>(_scene.spheres.size()); i++) {
+			if (occludesSphere(ray, i)) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool CpuRayTracer::traverseSpheresAnyHit(const Ray& ray) const {
+		glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+		if (intersectBox(ray, inverseDirection, _bvh.nodes[0].min, _bvh.nodes[0].max, FLOAT_MAX) == FLOAT_MAX) {
+			return false;
+		}
+
+		uint32_t stack[BVH_STACK_SIZE];
+		uint32_t stackSize = 0;
+		uint32_t nodeIndex = 0;
+
+		while (true) {
+			const BvhNode& node = _bvh.nodes[nodeIndex];
+
+			if (node.count > 0) {
+				for (uint32_t i = 0; i < node.count; i++) {
+					if (occludesSphere(ray, _bvh.indices[node.leftOrFirst + i])) {
+						return true;
+					}
+				}
+			} else {
+				uint32_t leftIndex = node.leftOrFirst;
+				uint32_t rightIndex = node.leftOrFirst + 1;
+
+				bool leftHit = intersectBox(ray, inverseDirection, _bvh.nodes[leftIndex].min, _bvh.nodes[leftIndex].max, FLOAT_MAX) != FLOAT_MAX;
+				bool rightHit = intersectBox(ray, inverseDirection, _bvh.nodes[rightIndex].min, _bvh.nodes[rightIndex].max, FLOAT_MAX) != FLOAT_MAX;
+
+				if (leftHit) {
+					if (rightHit) {
+						stack[stackSize++] = rightIndex;
+					}
+
+					nodeIndex = leftIndex;
+					continue;
+				}
+
+				if (rightHit) {
+					nodeIndex = rightIndex;
+					continue;
+				}
+			}
+
+			if (stackSize == 0) {
+				return false;
+			}
+
+			nodeIndex = stack[--stackSize];
+		}
+	}
+
+	void CpuRayTracer::traverseMesh(const Ray& ray, RayHit& bestHit, uint32_t meshIndex) const {
+		const Mesh& mesh = _scene.meshes[meshIndex];
+		const BvhNode* nodes = _scene.meshNodes.data() + mesh.firstNode;
+		glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+		if (intersectBox(ray, inverseDirection, nodes[0].min, nodes[0].max, bestHit.distance) == FLOAT_MAX) {
+			return;
+		}
+
+		TriangleRay triangleRay = createTriangleRay(ray);
+
+		uint32_t stack[BVH_STACK_SIZE];
+		uint32_t stackSize = 0;
+		uint32_t nodeIndex = 0;
+
+		while (true) {
+			const BvhNode& node = nodes[nodeIndex];
+
+			if (node.count > 0) {
+				for (uint32_t i = 0; i < node.count; i++) {
+					uint32_t triangle = node.leftOrFirst + i;
+
+					glm::vec3 v0, v1, v2;
+					getMeshTriangle(mesh, triangle, v0, v1, v2);
+
+					float t = intersectTriangle(ray, triangleRay, v0, v1, v2);
+
+					if (t < bestHit.distance) {
+						bestHit.distance = t;
+						bestHit.normal = getTriangleNormal(v0, v1, v2, ray.direction);
+						bestHit.object = MESH_OBJECT_BIT | (meshIndex << MESH_TRIANGLE_BITS) | triangle;
+					}
+				}
+
+				if (stackSize == 0) {
+					break;
+				}
+
+				nodeIndex = stack[--stackSize];
+			} else {
+				uint32_t nearIndex = node.leftOrFirst;
+				uint32_t farIndex = node.leftOrFirst + 1;
+
+				float nearDistance = intersectBox(ray, inverseDirection, nodes[nearIndex].min, nodes[nearIndex].max, bestHit.distance);
+				float farDistance = intersectBox(ray, inverseDirection, nodes[farIndex].min, nodes[farIndex].max, bestHit.distance);
+
+				if (farDistance < nearDistance) {
+					std::swap(nearIndex, farIndex);
+					std::swap(nearDistance, farDistance);
+				}
+
+				if (nearDistance == FLOAT_MAX) {
+					if (stackSize == 0) {
+						break;
+					}
+
+					nodeIndex = stack[--stackSize];
+				} else {
+					nodeIndex = nearIndex;
+
+					if (farDistance != FLOAT_MAX) {
+						stack[stackSize++] = farIndex;
+					}
+				}
+			}
+		}
+	}
+
+	bool CpuRayTracer::traverseMeshAnyHit(const Ray& ray, uint32_t meshIndex) const {
+		const Mesh& mesh = _scene.meshes[meshIndex];
+		const BvhNode* nodes = _scene.meshNodes.data() + mesh.firstNode;
+		glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+		if (intersectBox(ray, inverseDirection, nodes[0].min, nodes[0].max, FLOAT_MAX) == FLOAT_MAX) {
+			return false;
+		}
+
+		TriangleRay triangleRay = createTriangleRay(ray);
+
+		uint32_t stack[BVH_STACK_SIZE];
+		uint32_t stackSize = 0;
+		uint32_t nodeIndex = 0;
+
+		while (true) {
+			const BvhNode& node = nodes[nodeIndex];
+
+			if (node.count > 0) {
+				for (uint32_t i = 0; i < node.count; i++) {
+					glm::vec3 v0, v1, v2;
+					getMeshTriangle(mesh, node.leftOrFirst + i, v0, v1, v2);
+
+					if (intersectTriangle(ray, triangleRay, v0, v1, v2) != FLOAT_MAX) {
+						return true;
+					}
+				}
+			} else {
+				uint32_t leftIndex = node.leftOrFirst;
+				uint32_t rightIndex = node.leftOrFirst + 1;
+
+				bool leftHit = intersectBox(ray, inverseDirection, nodes[leftIndex].min, nodes[leftIndex].max, FLOAT_MAX) != FLOAT_MAX;
+				bool rightHit = intersectBox(ray, inverseDirection, nodes[rightIndex].min, nodes[rightIndex].max, FLOAT_MAX) != FLOAT_MAX;
+
+				if (leftHit) {
+					if (rightHit) {
+						stack[stackSize++] = rightIndex;
+					}
+
+					nodeIndex = leftIndex;
+					continue;
+				}
+
+				if (rightHit) {
+					nodeIndex = rightIndex;
+					continue;
+				}
+			}
+
+			if (stackSize == 0) {
+				return false;
+			}
+
+			nodeIndex = stack[--stackSize];
+		}
+	}
+
+	void CpuRayTracer::getMeshTriangle(const Mesh& mesh, uint32_t triangle, glm::vec3& v0, glm::vec3& v1, glm::vec3& v2) const {
+		const uint32_t* indices = _scene.meshIndices.data() + 3 * static_cast<size_t>(mesh.firstTriangle + triangle);
+		const MeshVertex* vertices = _scene.meshVertices.data() + mesh.firstVertex;
+
+		v0 = getMeshVertexPosition(mesh, vertices[indices[0]]);
+		v1 = getMeshVertexPosition(mesh, vertices[indices[1]]);
+		v2 = getMeshVertexPosition(mesh, vertices[indices[2]]);
+	}
+
+	glm::vec3 CpuRayTracer::shade(const Settings& settings, Ray& ray, const RayHit& hit, uint64_t& rayCount) const {
+		glm::vec3 lightDirection{ settings.directionalLight };
+
+		if (hit.distance < FLOAT_MAX) {
+			glm::vec3 position = ray.origin + hit.distance * ray.direction;
+			const Material& material = getMaterial(hit.object);
+
+			ray.coneWidth += ray.coneSpread * hit.distance;
+			ray.coneSpread += 2.0f * ray.coneWidth * getCurvature(hit.object);
+
+			ray.origin = position + hit.normal * 0.001f;
+			ray.direction = glm::reflect(ray.direction, hit.normal);
+			ray.energy *= material.specular;
+
+			Ray shadowRay{ position + hit.normal * 0.001f, -1.0f * lightDirection, glm::vec3(1.0f, 1.0f, 1.0f), 0.0f, 0.0f };
+			rayCount++;
+
+			if (occluded(settings, shadowRay)) {
+				return glm::vec3(0.0f, 0.0f, 0.0f);
+			}
+
+			return glm::clamp(glm::dot(hit.normal, lightDirection) * -1.0f, 0.0f, 1.0f) * settings.directionalLight.w * material.albedo;
+		} else {
+			ray.energy *= 0.0f;
+
+			float texelsPerRadian = _skyBox.size * 2.0f / glm::pi<float>();
+
+			return sampleSkyBox(ray.direction, std::log2(std::max(ray.coneSpread * texelsPerRadian, 1.0f)));
+		}
+	}
+
+	// Mirrors the cube map face selection and the trilinear filtering of the sampler used by the GPU.
+	glm::vec3 CpuRayTracer::sampleSkyBox(const glm::vec3& direction, float lod) const {
+		glm::vec3 absolute = glm::abs(direction);
+
+		uint32_t layer;
+		float sc, tc, ma;
+
+		if (absolute.x >= absolute.y && absolute.x >= absolute.z) {
+			layer = direction.x >= 0.0f ? 0 : 1;
+			sc = direction.x >= 0.0f ? -direction.z : direction.z;
+			tc = -direction.y;
+			ma = absolute.x;
+		} else if (absolute.y >= absolute.z) {
+			layer = direction.y >= 0.0f ? 2 : 3;
+			sc = direction.x;
+			tc = direction.y >= 0.0f ? direction.z : -direction.z;
+			ma = absolute.y;
+		} else {
+			layer = direction.z >= 0.0f ? 4 : 5;
+			sc = direction.z >= 0.0f ? direction.x : -direction.x;
+			tc = -direction.y;
+			ma = absolute.z;
+		}
+
+		float u = 0.5f * (sc / ma + 1.0f);
+		float v = 0.5f * (tc / ma + 1.0f);
+
+		lod = glm::clamp(lod, 0.0f, static_cast<float>(_skyBox.layers[layer].size() - 1));
+
+		uint32_t level = static_cast<uint32_t>(lod);
+		float fraction = lod - static_cast<float>(level);
+		glm::vec3 color = sampleSkyBoxLevel(layer, level, u, v);
+
+		if (fraction > 0.0f) {
+			color = glm::mix(color, sampleSkyBoxLevel(layer, level + 1, u, v), fraction);
+		}
+
+		return color;
+	}
+
+	glm::vec3 CpuRayTracer::sampleSkyBoxLevel(uint32_t layer, uint32_t level, float u, float v) const {
+		uint32_t size = std::max(1u, _skyBox.size >> level);
+		const std::vector<uint8_t>& texels = _skyBox.layers[layer][level];
+
+		u = u * size - 0.5f;
+		v = v * size - 0.5f;
+
+		float x0 = std::floor(u);
+		float y0 = std::floor(v);
+		float fx = u - x0;
+		float fy = v - y0;
+
+		auto fetch = [size, &texels](float x, float y) {
+			uint32_t texelX = static_cast<uint32_t>(glm::clamp(x, 0.0f, static_cast<float>(size - 1)));
+			uint32_t texelY = static_cast<uint32_t>(glm::clamp(y, 0.0f, static_cast<float>(size - 1)));
+
+			const uint8_t* texel = texels.data() + (static_cast<size_t>(texelY) * size + texelX) * 4;
+
+			return glm::vec3(texel[0], texel[1], texel[2]) / 255.0f;
+		};
+
+		glm::vec3 top = glm::mix(fetch(x0, y0), fetch(x0 + 1.0f, y0), fx);
+		glm::vec3 bottom = glm::mix(fetch(x0, y0 + 1.0f), fetch(x0 + 1.0f, y0 + 1.0f), fx);
+
+		return glm::mix(top, bottom, fy);
+	}
+
+	const Material& CpuRayTracer::getMaterial(uint32_t object) const {
+		if ((object & PLANE_OBJECT_BIT) != 0) {
+			return _scene.materials[_scene.planes[object & ~PLANE_OBJECT_BIT].material];
+		}
+
+		if ((object & MESH_OBJECT_BIT) != 0) {
+			return _scene.materials[_scene.meshes[(object & ~MESH_OBJECT_BIT) >> MESH_TRIANGLE_BITS].material];
+		}
+
+		return _scene.materials[_scene.spheres[object].material];
+	}
+
+	float CpuRayTracer::getCurvature(uint32_t object) const {
+		return (object & (PLANE_OBJECT_BIT | MESH_OBJECT_BIT)) != 0 ? 0.0f : 1.0f / _spherePositions[object].w;
+	}
+
+	void CpuRayTracer::intersectPlane(const Ray& ray, RayHit& bestHit, const Plane& plane, uint32_t index) {
+		float a = glm::dot(ray.direction, plane.normal);
+
+		if (a < 0) {
+			float t = (plane.distance - glm::dot(ray.origin, plane.normal)) / a;
+
+			if (t > 0 && t < bestHit.distance) {
+				bestHit.distance = t;
+				bestHit.normal = plane.normal;
+				bestHit.object = index | PLANE_OBJECT_BIT;
+			}
+		}
+	}
+
+	bool CpuRayTracer::occludesPlane(const Ray& ray, const Plane& plane) {
+		float a = glm::dot(ray.direction, plane.normal);
+
+		return a < 0 && (plane.distance - glm::dot(ray.origin, plane.normal)) / a > 0;
+	}
+
+	CpuRayTracer::TriangleRay CpuRayTracer::createTriangleRay(const Ray& ray) {
+		glm::vec3 direction = glm::abs(ray.direction);
+		int kz = direction.x > direction.y ? (direction.x > direction.z ? 0 : 2) : (direction.y > direction.z ? 1 : 2);
+		int kx = kz == 2 ? 0 : kz + 1;
+		int ky = kx == 2 ? 0 : kx + 1;
+
+		if (ray.direction[kz] < 0.0f) {
+			std::swap(kx, ky);
+		}
+
+		return { { kx, ky, kz }, glm::vec3(ray.direction[kx], ray.direction[ky], 1.0f) / ray.direction[kz] };
+	}
+
+	float CpuRayTracer::intersectTriangle(const Ray& ray, const TriangleRay& triangleRay, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2) {
+		const int* k = triangleRay.axes;
+		const glm::vec3& s = triangleRay.shear;
+
+		glm::vec3 a = v0 - ray.origin;
+		glm::vec3 b = v1 - ray.origin;
+		glm::vec3 c = v2 - ray.origin;
+
+		float ax = a[k[0]] - s.x * a[k[2]];
+		float ay = a[k[1]] - s.y * a[k[2]];
+		float bx = b[k[0]] - s.x * b[k[2]];
+		float by = b[k[1]] - s.y * b[k[2]];
+		float cx = c[k[0]] - s.x * c[k[2]];
+		float cy = c[k[1]] - s.y * c[k[2]];
+
+		float u = cx * by - cy * bx;
+		float v = ax * cy - ay * cx;
+		float w = bx * ay - by * ax;
+
+		if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) {
+			return FLOAT_MAX;
+		}
+
+		float determinant = u + v + w;
+
+		if (determinant == 0.0f) {
+			return FLOAT_MAX;
+		}
+
+		float t = (u * a[k[2]] + v * b[k[2]] + w * c[k[2]]) * s.z / determinant;
+
+		return t > 0.0f ? t : FLOAT_MAX;
+	}
+
+	glm::vec3 CpuRayTracer::getTriangleNormal(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& direction) {
+		glm::vec3 normal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+
+		return glm::faceforward(normal, direction, normal);
+	}
+
+	bool CpuRayTracer::occludesSphere(const Ray& ray, uint32_t index) const {
+		const glm::vec4& sphere = _spherePositions[index];
+		glm::vec3 d = ray.origin - glm::vec3(sphere);
+		float p1 = -glm::dot(ray.direction, d);
+		float p2sqr = p1 * p1 - glm::dot(d, d) + sphere.w * sphere.w;
+
+		return p2sqr >= 0 && p1 + std::sqrt(p2sqr) > 0;
+	}
+
+	float CpuRayTracer::intersectBox(const Ray& ray, const glm::vec3& inverseDirection, const glm::vec3& boxMin, const glm::vec3& boxMax, float maxDistance) {
+		glm::vec3 t0 = (boxMin - ray.origin) * inverseDirection;
+		glm::vec3 t1 = (boxMax - ray.origin) * inverseDirection;
+		glm::vec3 tMin = glm::min(t0, t1);
+		glm::vec3 tMax = glm::max(t0, t1);
+
+		float near = std::max(std::max(tMin.x, tMin.y), tMin.z);
+		float far = std::min(std::min(tMax.x, tMax.y), tMax.z);
+
+		return far >= std::max(near, 0.0f) && near < maxDistance ? near : FLOAT_MAX;
+	}
+
+	void CpuRayTracer::intersectSphere(const Ray& ray, RayHit& bestHit, uint32_t index) const {
+		const glm::vec4& sphere = _spherePositions[index];
+		glm::vec3 d = ray.origin - glm::vec3(sphere);
+		float p1 = -glm::dot(ray.direction, d);
+		float p2sqr = p1 * p1 - glm::dot(d, d) + sphere.w * sphere.w;
+
+		if (p2sqr < 0) {
+			return;
+		}
+
+		float p2 = std::sqrt(p2sqr);
+		float t = p1 - p2 > 0 ? p1 - p2 : p1 + p2;
+
+		if (t > 0 && t < bestHit.distance) {
+			bestHit.distance = t;
+			bestHit.normal = glm::normalize(ray.origin + t * ray.direction - glm::vec3(sphere));
+			bestHit.object = index;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+#ifndef __VULKAN_RAY_TRACING_CPU_RAY_TRACER_HPP__
+#define __VULKAN_RAY_TRACING_CPU_RAY_TRACER_HPP__
+
+#include "vrt_scene.hpp"
+#include "vrt_bvh.hpp"
+#include "vrt_mesh.hpp"
+#include "vrt_thread_pool.hpp"
+
+#include <vector>
+
+namespace vrt {
+	struct CpuRenderStatistics {
+		uint64_t rayCount;
+		double seconds;
+		uint32_t threadCount;
+
+		double getRaysPerSecond() const { return seconds > 0.0 ? rayCount / seconds : 0.0; }
+		double getRaysPerSecondPerCore() const { return threadCount > 0 ? getRaysPerSecond() / threadCount : 0.0; }
+	};
+
+	// CPU port of ray_tracing.comp, used as a golden reference for the shader and to render without a GPU.
+	// The frame is split in tiles which are scheduled on a work stealing thread pool.
+	class CpuRayTracer {
+	public:
+		CpuRayTracer(const Scene& scene, uint32_t threadCount = 0);
+
+		CpuRayTracer(CpuRayTracer&) = delete;
+		CpuRayTracer& operator=(CpuRayTracer&) = delete;
+
+		// Renders the frame as tightly packed RGBA8 rows, the same layout as RayTracer::readFrame.
+		void render(const Settings& settings, uint32_t width, uint32_t height, std::vector<uint8_t>& pixels);
+
+		const CpuRenderStatistics& getStatistics() const { return _statistics; }
+
+	private:
+		struct Ray {
+			glm::vec3 origin;
+			glm::vec3 direction;
+			glm::vec3 energy;
+			float coneWidth;
+			float coneSpread;
+		};
+
+		// Same slim hit as the shader, the planes set PLANE_OBJECT_BIT in the object index and the triangles
+		// MESH_OBJECT_BIT followed by the mesh and triangle indices
+		struct RayHit {
+			float distance;
+			glm::vec3 normal;
+			uint32_t object;
+		};
+
+		// Shear of the watertight triangle test, see TriangleRay in ray_tracing.glsl
+		struct TriangleRay {
+			int axes[3];
+			glm::vec3 shear;
+		};
+
+		uint64_t renderTile(const Settings& settings, uint32_t tileX, uint32_t tileY, uint32_t width, uint32_t height, uint8_t* pixels) const;
+
+		Ray createCameraRay(const Settings& settings, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t rayIndex) const;
+		RayHit trace(const Settings& settings, const Ray& ray) const;
+		void traverseSpheres(const Ray& ray, RayHit& bestHit) const;
+
+		bool occluded(const Settings& settings, const Ray& ray) const;
+		bool traverseSpheresAnyHit(const Ray& ray) const;
+
+		void traverseMesh(const Ray& ray, RayHit& bestHit, uint32_t meshIndex) const;
+		bool traverseMeshAnyHit(const Ray& ray, uint32_t meshIndex) const;
+		void getMeshTriangle(const Mesh& mesh, uint32_t triangle, glm::vec3& v0, glm::vec3& v1, glm::vec3& v2) const;
+
+		glm::vec3 shade(const Settings& settings, Ray& ray, const RayHit& hit, uint64_t& rayCount) const;
+		const Material& getMaterial(uint32_t object) const;
+		float getCurvature(uint32_t object) const;
+
+		glm::vec3 sampleSkyBox(const glm::vec3& direction, float lod) const;
+		glm::vec3 sampleSkyBoxLevel(uint32_t layer, uint32_t level, float u, float v) const;
+
+		void intersectSphere(const Ray& ray, RayHit& bestHit, uint32_t index) const;
+		bool occludesSphere(const Ray& ray, uint32_t index) const;
+
+		static void intersectPlane(const Ray& ray, RayHit& bestHit, const Plane& plane, uint32_t index);
+		static bool occludesPlane(const Ray& ray, const Plane& plane);
+		static TriangleRay createTriangleRay(const Ray& ray);
+		static float intersectTriangle(const Ray& ray, const TriangleRay& triangleRay, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
+		static glm::vec3 getTriangleNormal(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& direction);
+		static float intersectBox(const Ray& ray, const glm::vec3& inverseDirection, const glm::vec3& boxMin, const glm::vec3& boxMax, float maxDistance);
+
+	private:
+		static const uint32_t TILE_SIZE = 16;
+		static const uint32_t ANTIALIASING_SAMPLES = 2;
+		static const int MAX_BOUNCES = 5;
+		static const uint32_t BVH_STACK_SIZE = 32;
+		static const uint32_t PLANE_OBJECT_BIT = 0x80000000u;
+		static const uint32_t MESH_OBJECT_BIT = 0x40000000u;
+
+	private:
+		Scene _scene;
+		Bvh _bvh;
+
+		// Center and radius of the spheres at the time of the frame being rendered, as written by animate.comp
+		std::vector<glm::vec4> _spherePositions;
+
+		struct {
+			uint32_t size;
+
+			// Mip chain of each face, RGBA8
+			std::vector<std::vector<uint8_t>> layers[6];
+		} _skyBox;
+
+		ThreadPool _threadPool;
+		CpuRenderStatistics _statistics;
+	};
+}
+
+#endif
\ No newline at end of file
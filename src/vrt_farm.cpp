@@ -0,0 +1,781 @@
+#include "vrt_farm.hpp"
+#include "vrt_ray_tracer.hpp"
+#include "vrt_scene_file.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace vrt {
+	const uint32_t FARM_PROTOCOL_VERSION = 1;
+	const uint32_t FarmConnection::MAX_MESSAGE_SIZE = 256 * 1024 * 1024;
+
+	namespace {
+		// Delay between two attempts of a worker to reach the coordinator
+		const std::chrono::milliseconds CONNECT_RETRY_INTERVAL{ 500 };
+
+		// The coordinator checks the timeouts at least this often, in milliseconds
+		const int POLL_INTERVAL = 1000;
+
+		// Time the local workers get to leave once their connection is closed, a worker stuck on the GPU is terminated after it
+		const std::chrono::seconds LOCAL_WORKER_EXIT_TIMEOUT{ 5 };
+		const std::chrono::milliseconds LOCAL_WORKER_EXIT_POLL_INTERVAL{ 50 };
+
+		const size_t RECEIVE_CHUNK_SIZE = 64 * 1024;
+
+		struct MessageHeader {
+			uint32_t type;
+			uint32_t size;
+		};
+
+		struct SocketAddress {
+			bool isUnix;
+			std::string path;
+			std::string host;
+			std::string port;
+		};
+
+		SocketAddress parseAddress(const std::string& address) {
+			if (address.rfind("unix:", 0) == 0) {
+				return { true, address.substr(5), "", "" };
+			}
+
+			size_t separator = address.rfind(':');
+
+			if (address.rfind("tcp:", 0) == 0 && separator > 3) {
+				return { false, "", address.substr(4, separator - 4), address.substr(separator + 1) };
+			}
+
+			throw std::runtime_error("Farm addresses are expected as tcp:HOST:PORT or unix:PATH, not " + address);
+		}
+
+		sockaddr_un getUnixAddress(const std::string& path) {
+			sockaddr_un unixAddress{};
+			unixAddress.sun_family = AF_UNIX;
+
+			if (path.size() >= sizeof(unixAddress.sun_path)) {
+				throw std::runtime_error("The socket path is too long: " + path);
+			}
+
+			memcpy(unixAddress.sun_path, path.c_str(), path.size() + 1);
+
+			return unixAddress;
+		}
+
+		// An empty host or * listens on every interface
+		addrinfo* resolveAddress(const SocketAddress& address, bool isPassive) {
+			addrinfo hints{};
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_STREAM;
+			hints.ai_flags = isPassive ? AI_PASSIVE : 0;
+
+			const char* host = address.host.empty() || address.host == "*" ? nullptr : address.host.c_str();
+			addrinfo* addresses = nullptr;
+			int result = getaddrinfo(host, address.port.c_str(), &hints, &addresses);
+
+			if (result != 0) {
+				throw std::runtime_error("Failed to resolve " + address.host + ": " + gai_strerror(result));
+			}
+
+			return addresses;
+		}
+
+		bool sendAll(int socket, const void* data, size_t size) {
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+			while (size > 0) {
+				// A peer which is gone fails the call instead of raising SIGPIPE
+				ssize_t count = ::send(socket, bytes, size, MSG_NOSIGNAL);
+
+				if (count < 0 && errno == EINTR) {
+					continue;
+				}
+
+				if (count <= 0) {
+					return false;
+				}
+
+				bytes += count;
+				size -= static_cast<size_t>(count);
+			}
+
+			return true;
+		}
+
+		template<typename T>
+		bool readPayload(const FarmMessage& message, T& value) {
+			if (message.payload.size() < sizeof(T)) {
+				return false;
+			}
+
+			memcpy(&value, message.payload.data(), sizeof(T));
+
+			return true;
+		}
+
+		// Same camera as the viewer when it starts, the animation advances as if it was running at 60 frames per second
+		Settings getFrameSettings(const FarmOptions& options, uint32_t frame) {
+			glm::vec3 lightDirection{ 1.0f, -2.0f, 0.5f };
+			lightDirection = glm::normalize(lightDirection);
+
+			Settings settings{};
+			settings.projection = createInverseProjectionMatrix(40.0f, static_cast<float>(options.frameWidth) / static_cast<float>(options.frameHeight));
+			settings.transform = glm::mat4{ 1.0f };
+			settings.directionalLight = { lightDirection, 1.0f };
+			settings.angle = frame * 0.8f / 60.0f;
+			settings.useBvh = 1;
+
+			return settings;
+		}
+
+		std::string writeFrame(const std::string& pattern, uint32_t frame, uint32_t width, uint32_t height, const std::vector<uint8_t>& pixels) {
+			char path[4096];
+			snprintf(path, sizeof(path), pattern.c_str(), frame);
+
+			std::ofstream file(path, std::ios::binary);
+
+			if (!file.is_open()) {
+				throw std::runtime_error(std::string("Failed to open ") + path);
+			}
+
+			file << "P6\n" << width << " " << height << "\n255\n";
+
+			for (size_t index = 0; index < pixels.size(); index += 4) {
+				file.write(reinterpret_cast<const char*>(&pixels[index]), 3);
+			}
+
+			return path;
+		}
+
+		struct FarmWorker {
+			std::unique_ptr<FarmConnection> connection;
+
+			// Set once the hello has been answered
+			bool isReady;
+
+			// Jobs handed out, in the order the worker traces them
+			std::vector<uint32_t> jobs;
+			std::chrono::steady_clock::time_point lastMessage;
+		};
+
+		struct FarmJobState {
+			FarmJob job;
+			uint32_t frame;
+
+			// Workers tracing the job, more than one once it has been duplicated
+			uint32_t assignmentCount;
+			bool isComplete;
+
+			std::chrono::steady_clock::time_point assignedTime;
+		};
+
+		// The pixels are allocated with the first tile back and released once the frame is written
+		struct FarmFrame {
+			std::vector<uint8_t> pixels;
+			uint32_t remainingJobCount;
+		};
+
+		class FarmCoordinator {
+		public:
+			FarmCoordinator(const FarmOptions& options, const std::function<void(const FarmEvent&)>& onEvent);
+			~FarmCoordinator();
+
+			FarmCoordinator(FarmCoordinator&) = delete;
+			FarmCoordinator& operator=(FarmCoordinator&) = delete;
+
+			void run(const char* workerExecutable);
+
+		private:
+			void startLocalWorkers(const char* workerExecutable);
+			void acceptWorker();
+			bool handleMessage(FarmWorker& worker, const FarmMessage& message);
+			bool completeJob(FarmWorker& worker, const FarmMessage& message);
+			void dropWorker(size_t workerIndex, const char* reason);
+			void assignJobs();
+			bool popJob(const FarmWorker& worker, uint32_t& jobIndex);
+
+			const FarmOptions& _options;
+			const std::function<void(const FarmEvent&)>& _onEvent;
+			int _listener;
+
+			std::vector<FarmWorker> _workers;
+			std::vector<pid_t> _localWorkers;
+
+			std::vector<FarmJobState> _jobs;
+			std::deque<uint32_t> _pendingJobs;
+
+			std::vector<FarmFrame> _frames;
+			uint32_t _writtenFrameCount;
+		};
+
+		// The jobs are laid out frame after frame, each frame row after row
+		FarmCoordinator::FarmCoordinator(const FarmOptions& options, const std::function<void(const FarmEvent&)>& onEvent)
+			: _options{ options }, _onEvent{ onEvent }, _listener{ -1 }, _writtenFrameCount{ 0 } {
+			if (options.frameWidth == 0 || options.frameHeight == 0 || options.tileSize == 0 || options.passCount == 0 || options.jobsPerWorker == 0) {
+				throw std::runtime_error("A farm render needs a frame, tiles, passes and jobs per worker");
+			}
+
+			uint32_t jobsPerFrame = ((options.frameWidth + options.tileSize - 1) / options.tileSize) * ((options.frameHeight + options.tileSize - 1) / options.tileSize);
+			_frames.resize(options.frameCount, FarmFrame{ {}, jobsPerFrame });
+
+			for (uint32_t frame = 0; frame < options.frameCount; frame++) {
+				Settings settings = getFrameSettings(options, options.firstFrame + frame);
+
+				for (uint32_t y = 0; y < options.frameHeight; y += options.tileSize) {
+					for (uint32_t x = 0; x < options.frameWidth; x += options.tileSize) {
+						FarmJobState state{};
+						state.job.settings = settings;
+						state.job.id = static_cast<uint32_t>(_jobs.size());
+						state.job.x = x;
+						state.job.y = y;
+						state.job.width = std::min(options.tileSize, options.frameWidth - x);
+						state.job.height = std::min(options.tileSize, options.frameHeight - y);
+						state.frame = frame;
+
+						_pendingJobs.push_back(state.job.id);
+						_jobs.push_back(state);
+					}
+				}
+			}
+		}
+
+		FarmCoordinator::~FarmCoordinator() {
+			_workers.clear();
+
+			if (_listener >= 0) {
+				close(_listener);
+			}
+
+			// The local workers leave once their connection is closed, those which do not are terminated
+			auto deadline = std::chrono::steady_clock::now() + LOCAL_WORKER_EXIT_TIMEOUT;
+
+			for (pid_t process : _localWorkers) {
+				while (waitpid(process, nullptr, WNOHANG) == 0) {
+					if (std::chrono::steady_clock::now() >= deadline) {
+						kill(process, SIGTERM);
+						waitpid(process, nullptr, 0);
+
+						break;
+					}
+
+					std::this_thread::sleep_for(LOCAL_WORKER_EXIT_POLL_INTERVAL);
+				}
+			}
+		}
+
+		void FarmCoordinator::run(const char* workerExecutable) {
+			_listener = listenFarmSocket(_options.address);
+			startLocalWorkers(workerExecutable);
+
+			auto lastWorkerTime = std::chrono::steady_clock::now();
+
+			while (_writtenFrameCount < _options.frameCount) {
+				std::vector<pollfd> descriptors{ pollfd{ _listener, POLLIN, 0 } };
+
+				for (const FarmWorker& worker : _workers) {
+					descriptors.push_back(pollfd{ worker.connection->getSocket(), POLLIN, 0 });
+				}
+
+				if (poll(descriptors.data(), descriptors.size(), POLL_INTERVAL) < 0 && errno != EINTR) {
+					throw std::runtime_error("Failed to wait for the workers");
+				}
+
+				// Visited backwards, so dropping a worker keeps the indices of the ones left to visit
+				for (size_t index = descriptors.size() - 1; index-- > 0;) {
+					if (descriptors[index + 1].revents == 0) {
+						continue;
+					}
+
+					FarmWorker& worker = _workers[index];
+					std::vector<FarmMessage> messages;
+					bool isConnected = worker.connection->receiveAvailable(messages);
+
+					// The results sent right before a disconnection still count
+					for (const FarmMessage& message : messages) {
+						if (!handleMessage(worker, message)) {
+							isConnected = false;
+
+							break;
+						}
+					}
+
+					if (!isConnected) {
+						dropWorker(index, "disconnected");
+					}
+				}
+
+				if ((descriptors[0].revents & POLLIN) != 0) {
+					acceptWorker();
+				}
+
+				auto now = std::chrono::steady_clock::now();
+
+				for (size_t index = _workers.size(); index-- > 0;) {
+					const FarmWorker& worker = _workers[index];
+
+					if (!worker.jobs.empty() && std::chrono::duration<float>(now - worker.lastMessage).count() > _options.timeout) {
+						dropWorker(index, "timed out");
+					}
+				}
+
+				if (!_workers.empty()) {
+					lastWorkerTime = now;
+				} else if (std::chrono::duration<float>(now - lastWorkerTime).count() > _options.timeout) {
+					throw std::runtime_error("No worker left to render the frames");
+				}
+
+				assignJobs();
+			}
+
+			for (FarmWorker& worker : _workers) {
+				worker.connection->send(FarmMessageType::Shutdown, nullptr, 0);
+			}
+		}
+
+		// The workers connect to the address the coordinator listens on, so it has to be reachable from this machine
+		void FarmCoordinator::startLocalWorkers(const char* workerExecutable) {
+			for (uint32_t index = 0; index < _options.localWorkerCount; index++) {
+				pid_t process = fork();
+
+				if (process == 0) {
+					execlp(workerExecutable, workerExecutable, "worker", _options.address.c_str(), nullptr);
+					_exit(127);
+				}
+
+				if (process < 0) {
+					throw std::runtime_error("Failed to start a local worker");
+				}
+
+				_localWorkers.push_back(process);
+			}
+		}
+
+		void FarmCoordinator::acceptWorker() {
+			int socket = accept(_listener, nullptr, nullptr);
+
+			if (socket < 0) {
+				return;
+			}
+
+			_workers.push_back(FarmWorker{ std::make_unique<FarmConnection>(socket), false, {}, std::chrono::steady_clock::now() });
+		}
+
+		// Returns false when the worker broke the protocol or could not be answered
+		bool FarmCoordinator::handleMessage(FarmWorker& worker, const FarmMessage& message) {
+			worker.lastMessage = std::chrono::steady_clock::now();
+
+			if (message.type == FarmMessageType::Hello && !worker.isReady) {
+				FarmHello hello{};
+
+				if (!readPayload(message, hello) || hello.version != FARM_PROTOCOL_VERSION || hello.settingsSize != sizeof(Settings)) {
+					return false;
+				}
+
+				FarmSetup setup{ _options.frameWidth, _options.frameHeight, _options.tileSize, _options.passCount };
+				worker.isReady = worker.connection->send(FarmMessageType::Setup, &setup, sizeof(FarmSetup), _options.scenePath.data(), _options.scenePath.size());
+
+				return worker.isReady;
+			}
+
+			if (message.type == FarmMessageType::Result) {
+				return completeJob(worker, message);
+			}
+
+			return false;
+		}
+
+		bool FarmCoordinator::completeJob(FarmWorker& worker, const FarmMessage& message) {
+			FarmResult result{};
+
+			if (!readPayload(message, result) || result.id >= _jobs.size()) {
+				return false;
+			}
+
+			auto assignment = std::find(worker.jobs.begin(), worker.jobs.end(), result.id);
+			FarmJobState& state = _jobs[result.id];
+			const FarmJob& job = state.job;
+
+			if (assignment == worker.jobs.end() || result.width != job.width || result.height != job.height
+				|| message.payload.size() != sizeof(FarmResult) + static_cast<size_t>(job.width) * job.height * 4) {
+				return false;
+			}
+
+			worker.jobs.erase(assignment);
+			state.assignmentCount--;
+
+			// The job was duplicated and the other worker was faster
+			if (state.isComplete) {
+				return true;
+			}
+
+			state.isComplete = true;
+
+			FarmFrame& frame = _frames[state.frame];
+
+			if (frame.pixels.empty()) {
+				frame.pixels.resize(static_cast<size_t>(_options.frameWidth) * _options.frameHeight * 4);
+			}
+
+			const uint8_t* pixels = message.payload.data() + sizeof(FarmResult);
+
+			for (uint32_t row = 0; row < job.height; row++) {
+				memcpy(&frame.pixels[(static_cast<size_t>(job.y + row) * _options.frameWidth + job.x) * 4], &pixels[static_cast<size_t>(row) * job.width * 4], static_cast<size_t>(job.width) * 4);
+			}
+
+			if (--frame.remainingJobCount == 0) {
+				uint32_t frameNumber = _options.firstFrame + state.frame;
+				std::string path = writeFrame(_options.outputPattern, frameNumber, _options.frameWidth, _options.frameHeight, frame.pixels);
+				std::vector<uint8_t>().swap(frame.pixels);
+
+				_writtenFrameCount++;
+
+				if (_onEvent) {
+					_onEvent({ FarmEventType::FrameWritten, frameNumber, path, nullptr, 0 });
+				}
+			}
+
+			return true;
+		}
+
+		// The jobs no other worker traces are handed out first, they hold back the frames the closest to completion
+		void FarmCoordinator::dropWorker(size_t workerIndex, const char* reason) {
+			FarmWorker& worker = _workers[workerIndex];
+			uint32_t requeuedCount = 0;
+
+			for (auto job = worker.jobs.rbegin(); job != worker.jobs.rend(); job++) {
+				FarmJobState& state = _jobs[*job];
+				state.assignmentCount--;
+
+				if (!state.isComplete && state.assignmentCount == 0) {
+					_pendingJobs.push_front(*job);
+					requeuedCount++;
+				}
+			}
+
+			_workers.erase(_workers.begin() + workerIndex);
+
+			if (_onEvent) {
+				_onEvent({ FarmEventType::WorkerDropped, 0, {}, reason, requeuedCount });
+			}
+		}
+
+		// A job is recorded on the worker before being sent, so it is handed out again if the worker turns out to be gone
+		void FarmCoordinator::assignJobs() {
+			auto now = std::chrono::steady_clock::now();
+
+			for (FarmWorker& worker : _workers) {
+				uint32_t jobIndex = 0;
+
+				while (worker.isReady && worker.jobs.size() < _options.jobsPerWorker && popJob(worker, jobIndex)) {
+					FarmJobState& state = _jobs[jobIndex];
+
+					if (state.assignmentCount == 0) {
+						state.assignedTime = now;
+					}
+
+					state.assignmentCount++;
+					worker.jobs.push_back(jobIndex);
+
+					if (!worker.connection->send(FarmMessageType::Job, &state.job, sizeof(FarmJob))) {
+						break;
+					}
+				}
+			}
+		}
+
+		// Once nothing is left to hand out, an idle worker duplicates the job running the longest on a single worker, so
+		// a slow worker does not hold back the last frames
+		bool FarmCoordinator::popJob(const FarmWorker& worker, uint32_t& jobIndex) {
+			while (!_pendingJobs.empty()) {
+				jobIndex = _pendingJobs.front();
+				_pendingJobs.pop_front();
+
+				if (!_jobs[jobIndex].isComplete && _jobs[jobIndex].assignmentCount == 0) {
+					return true;
+				}
+			}
+
+			if (!worker.jobs.empty()) {
+				return false;
+			}
+
+			bool hasJob = false;
+
+			for (const FarmJobState& state : _jobs) {
+				if (!state.isComplete && state.assignmentCount == 1 && (!hasJob || state.assignedTime < _jobs[jobIndex].assignedTime)) {
+					jobIndex = state.job.id;
+					hasJob = true;
+				}
+			}
+
+			return hasJob;
+		}
+	}
+
+	int listenFarmSocket(const std::string& address) {
+		SocketAddress socketAddress = parseAddress(address);
+
+		if (socketAddress.isUnix) {
+			sockaddr_un unixAddress = getUnixAddress(socketAddress.path);
+			unlink(socketAddress.path.c_str());
+
+			int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+			if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&unixAddress), sizeof(sockaddr_un)) != 0 || listen(listener, SOMAXCONN) != 0) {
+				if (listener >= 0) {
+					close(listener);
+				}
+
+				throw std::runtime_error("Failed to listen on " + address);
+			}
+
+			return listener;
+		}
+
+		addrinfo* addresses = resolveAddress(socketAddress, true);
+		int listener = -1;
+
+		for (addrinfo* candidate = addresses; candidate != nullptr && listener < 0; candidate = candidate->ai_next) {
+			listener = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+
+			if (listener < 0) {
+				continue;
+			}
+
+			// A coordinator started again right away can take the port back
+			int reuse = 1;
+			setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+			if (bind(listener, candidate->ai_addr, candidate->ai_addrlen) != 0 || listen(listener, SOMAXCONN) != 0) {
+				close(listener);
+				listener = -1;
+			}
+		}
+
+		freeaddrinfo(addresses);
+
+		if (listener < 0) {
+			throw std::runtime_error("Failed to listen on " + address);
+		}
+
+		return listener;
+	}
+
+	int connectFarmSocket(const std::string& address) {
+		SocketAddress socketAddress = parseAddress(address);
+
+		if (socketAddress.isUnix) {
+			sockaddr_un unixAddress = getUnixAddress(socketAddress.path);
+			int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+
+			if (connection >= 0 && connect(connection, reinterpret_cast<sockaddr*>(&unixAddress), sizeof(sockaddr_un)) != 0) {
+				close(connection);
+				connection = -1;
+			}
+
+			return connection;
+		}
+
+		addrinfo* addresses = resolveAddress(socketAddress, false);
+		int connection = -1;
+
+		for (addrinfo* candidate = addresses; candidate != nullptr && connection < 0; candidate = candidate->ai_next) {
+			connection = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+
+			if (connection >= 0 && connect(connection, candidate->ai_addr, candidate->ai_addrlen) != 0) {
+				close(connection);
+				connection = -1;
+			}
+		}
+
+		freeaddrinfo(addresses);
+
+		// The jobs and the results are sent as soon as they are ready
+		if (connection >= 0) {
+			int noDelay = 1;
+			setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+		}
+
+		return connection;
+	}
+
+	FarmConnection::FarmConnection(int socket) : _socket{ socket }, _buffer{}, _isMalformed{ false } { }
+
+	FarmConnection::~FarmConnection() {
+		close(_socket);
+	}
+
+	bool FarmConnection::send(FarmMessageType type, const void* payload, size_t size, const void* extra, size_t extraSize) {
+		MessageHeader header{ static_cast<uint32_t>(type), static_cast<uint32_t>(size + extraSize) };
+
+		return sendAll(_socket, &header, sizeof(MessageHeader)) && sendAll(_socket, payload, size) && sendAll(_socket, extra, extraSize);
+	}
+
+	bool FarmConnection::receive(FarmMessage& message) {
+		std::vector<uint8_t> chunk(RECEIVE_CHUNK_SIZE);
+
+		while (!popMessage(message)) {
+			if (_isMalformed) {
+				return false;
+			}
+
+			ssize_t count = recv(_socket, chunk.data(), chunk.size(), 0);
+
+			if (count < 0 && errno == EINTR) {
+				continue;
+			}
+
+			if (count <= 0) {
+				return false;
+			}
+
+			_buffer.insert(_buffer.end(), chunk.begin(), chunk.begin() + count);
+		}
+
+		return true;
+	}
+
+	bool FarmConnection::receiveAvailable(std::vector<FarmMessage>& messages) {
+		std::vector<uint8_t> chunk(RECEIVE_CHUNK_SIZE);
+		bool isConnected = true;
+
+		while (true) {
+			ssize_t count = recv(_socket, chunk.data(), chunk.size(), MSG_DONTWAIT);
+
+			if (count > 0) {
+				_buffer.insert(_buffer.end(), chunk.begin(), chunk.begin() + count);
+			} else if (count < 0 && errno == EINTR) {
+				continue;
+			} else {
+				isConnected = count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+
+				break;
+			}
+		}
+
+		FarmMessage message;
+
+		while (popMessage(message)) {
+			messages.push_back(std::move(message));
+		}
+
+		return isConnected && !_isMalformed;
+	}
+
+	bool FarmConnection::popMessage(FarmMessage& message) {
+		MessageHeader header{};
+
+		if (_buffer.size() < sizeof(MessageHeader)) {
+			return false;
+		}
+
+		memcpy(&header, _buffer.data(), sizeof(MessageHeader));
+
+		if (header.size > MAX_MESSAGE_SIZE) {
+			_isMalformed = true;
+
+			return false;
+		}
+
+		size_t messageSize = sizeof(MessageHeader) + header.size;
+
+		if (_buffer.size() < messageSize) {
+			return false;
+		}
+
+		message.type = static_cast<FarmMessageType>(header.type);
+		message.payload.assign(_buffer.begin() + sizeof(MessageHeader), _buffer.begin() + messageSize);
+		_buffer.erase(_buffer.begin(), _buffer.begin() + messageSize);
+
+		return true;
+	}
+
+	void runFarmCoordinator(const FarmOptions& options, const char* workerExecutable, const std::function<void(const FarmEvent&)>& onEvent) {
+		FarmCoordinator coordinator{ options, onEvent };
+		coordinator.run(workerExecutable);
+	}
+
+	// Every job is traced as a single tile of the target texture, its passes being separate submissions
+	void runFarmWorker(const std::string& address, float timeout) {
+		auto connectStart = std::chrono::steady_clock::now();
+		int socket = connectFarmSocket(address);
+
+		while (socket < 0) {
+			if (std::chrono::duration<float>(std::chrono::steady_clock::now() - connectStart).count() > timeout) {
+				throw std::runtime_error("Failed to reach the coordinator at " + address);
+			}
+
+			std::this_thread::sleep_for(CONNECT_RETRY_INTERVAL);
+			socket = connectFarmSocket(address);
+		}
+
+		FarmConnection connection{ socket };
+		FarmHello hello{ FARM_PROTOCOL_VERSION, static_cast<uint32_t>(sizeof(Settings)) };
+		FarmMessage message;
+		FarmSetup setup{};
+
+		if (!connection.send(FarmMessageType::Hello, &hello, sizeof(FarmHello)) || !connection.receive(message)
+			|| message.type != FarmMessageType::Setup || !readPayload(message, setup)) {
+			throw std::runtime_error("The coordinator turned the worker away");
+		}
+
+		std::string scenePath{ message.payload.begin() + sizeof(FarmSetup), message.payload.end() };
+		uint32_t width = std::min(setup.tileSize, setup.frameWidth);
+		uint32_t height = std::min(setup.tileSize, setup.frameHeight);
+
+		RayTracer rayTracer = scenePath.empty()
+			? RayTracer{ width, height, createDefaultScene() }
+			: RayTracer{ width, height, SceneFile{ scenePath.c_str() } };
+
+		std::vector<uint8_t> pixels;
+
+		while (connection.receive(message) && message.type == FarmMessageType::Job) {
+			FarmJob job{};
+
+			if (!readPayload(message, job)) {
+				throw std::runtime_error("Received a malformed job");
+			}
+
+			rayTracer.updateSettings(job.settings);
+
+			TiledRenderOptions tiledOptions{};
+			tiledOptions.width = setup.frameWidth;
+			tiledOptions.height = setup.frameHeight;
+			tiledOptions.tileSize = setup.tileSize;
+			tiledOptions.passCount = setup.passCount;
+			tiledOptions.region = { { static_cast<int32_t>(job.x), static_cast<int32_t>(job.y) }, { job.width, job.height } };
+
+			pixels.resize(static_cast<size_t>(job.width) * job.height * 4);
+
+			rayTracer.renderTiled(tiledOptions, [&](const RenderedTile& tile) {
+				for (uint32_t row = 0; row < tile.height; row++) {
+					size_t offset = (static_cast<size_t>(tile.y - job.y + row) * job.width + (tile.x - job.x)) * 4;
+					memcpy(&pixels[offset], tile.pixels + static_cast<size_t>(row) * tile.width * 4, static_cast<size_t>(tile.width) * 4);
+				}
+			});
+
+			FarmResult result{ job.id, job.width, job.height };
+
+			if (!connection.send(FarmMessageType::Result, &result, sizeof(FarmResult), pixels.data(), pixels.size())) {
+				break;
+			}
+		}
+	}
+}
\ No newline at end of file
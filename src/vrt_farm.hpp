@@ -0,0 +1,168 @@
+#ifndef __VULKAN_RAY_TRACING_FARM_HPP__
+#define __VULKAN_RAY_TRACING_FARM_HPP__
+
+#include "vrt_scene.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Render farm over stream sockets, POSIX only. A coordinator splits the frames of an animation into tiles and hands
+// them out to worker processes tracing headlessly, on the same machine or on other nodes. Messages are sent in the
+// memory layout of the build, so every process has to run the same build on the same architecture.
+namespace vrt {
+	// Bumped whenever a message changes, the coordinator turns away the workers speaking another version
+	extern const uint32_t FARM_PROTOCOL_VERSION;
+
+	enum class FarmMessageType : uint32_t {
+		// Worker to coordinator, once connected: FarmHello
+		Hello = 0,
+
+		// Coordinator to worker, in answer to the hello: FarmSetup followed by the path of the scene file
+		Setup = 1,
+
+		// Coordinator to worker: FarmJob
+		Job = 2,
+
+		// Worker to coordinator: FarmResult followed by the tightly packed RGBA8 rows of the job
+		Result = 3,
+
+		// Coordinator to worker, once every frame has been written. Empty.
+		Shutdown = 4
+	};
+
+	struct FarmHello {
+		uint32_t version;
+		uint32_t settingsSize;
+	};
+
+	// An empty scene path renders the default scene
+	struct FarmSetup {
+		uint32_t frameWidth;
+		uint32_t frameHeight;
+		uint32_t tileSize;
+		uint32_t passCount;
+	};
+
+	// Tile of a frame, the settings carry the camera and the animation time of the frame
+	struct FarmJob {
+		Settings settings;
+		uint32_t id;
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	struct FarmResult {
+		uint32_t id;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	struct FarmMessage {
+		FarmMessageType type;
+		std::vector<uint8_t> payload;
+	};
+
+	// Addresses are either tcp:HOST:PORT or unix:PATH. Listening on a Unix socket replaces the file at its path.
+	int listenFarmSocket(const std::string& address);
+
+	// Returns -1 when nothing listens at the address yet
+	int connectFarmSocket(const std::string& address);
+
+	// Framed messages over a connected socket, which is closed with the connection
+	class FarmConnection {
+	public:
+		explicit FarmConnection(int socket);
+		~FarmConnection();
+
+		FarmConnection(FarmConnection&) = delete;
+		FarmConnection& operator=(FarmConnection&) = delete;
+
+		// The extra bytes follow the payload in the same message. Returns false once the peer is gone.
+		bool send(FarmMessageType type, const void* payload, size_t size, const void* extra = nullptr, size_t extraSize = 0);
+
+		// Blocks until a whole message arrived, returns false once the peer closed the connection
+		bool receive(FarmMessage& message);
+
+		// Reads what the socket holds without blocking, then appends the complete messages. Returns false once the
+		// peer closed the connection or sent a malformed message.
+		bool receiveAvailable(std::vector<FarmMessage>& messages);
+
+		int getSocket() const { return _socket; }
+
+	private:
+		// Largest message accepted, above any tile a worker sends back
+		static const uint32_t MAX_MESSAGE_SIZE;
+
+		bool popMessage(FarmMessage& message);
+
+		int _socket;
+		std::vector<uint8_t> _buffer;
+		bool _isMalformed;
+	};
+
+	struct FarmOptions {
+		std::string address;
+
+		// Loaded by every worker, so the path has to be valid on all of them. Empty renders the default scene.
+		std::string scenePath;
+
+		// printf pattern of the PPM images written, given the frame number
+		std::string outputPattern = "frame_%04d.ppm";
+
+		uint32_t firstFrame = 0;
+		uint32_t frameCount = 1;
+
+		uint32_t frameWidth = 1920;
+		uint32_t frameHeight = 1080;
+
+		// Side of the tiles handed out, every worker traces one tile at a time
+		uint32_t tileSize = 256;
+		uint32_t passCount = 1;
+
+		// Jobs queued on each worker, so it never waits for the next one
+		uint32_t jobsPerWorker = 2;
+
+		// Worker processes started on this machine, the others connect on their own
+		uint32_t localWorkerCount = 0;
+
+		// Seconds a worker with jobs may go without sending a result before it is considered dead, so it has to
+		// exceed the time a tile takes. Also the time the coordinator waits without any worker before giving up.
+		float timeout = 60.0f;
+	};
+
+	enum class FarmEventType : uint32_t {
+		// All the tiles of a frame were back and it was written
+		FrameWritten = 0,
+
+		// A worker disconnected or stopped answering
+		WorkerDropped = 1
+	};
+
+	// Handed to the callback of runFarmCoordinator as the render progresses
+	struct FarmEvent {
+		FarmEventType type;
+
+		// FrameWritten: the frame number and the image written
+		uint32_t frame;
+		std::string path;
+
+		// WorkerDropped: why, and how many of its jobs no other worker traced and were handed out again
+		const char* reason;
+		uint32_t requeuedJobCount;
+	};
+
+	// Hands the tiles out in frame order and writes every frame once its tiles are back. The jobs of a worker which
+	// disconnects or stops answering are handed out again. Once there is nothing left to hand out, the idle workers
+	// duplicate the jobs running the longest, the first result wins. Local workers are started from the executable.
+	void runFarmCoordinator(const FarmOptions& options, const char* workerExecutable, const std::function<void(const FarmEvent&)>& onEvent = {});
+
+	// Connects to the coordinator, retrying until the timeout, then traces the jobs it receives until it shuts down
+	void runFarmWorker(const std::string& address, float timeout = 60.0f);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "vrt_frame_writer.hpp"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace vrt {
+	namespace {
+		std::vector<uint8_t> getRgbPixels(uint32_t width, uint32_t height, const std::vector<uint8_t>& pixels) {
+			size_t pixelCount = static_cast<size_t>(width) * height;
+			std::vector<uint8_t> rgbPixels(pixelCount * 3);
+
+			for (size_t pixel = 0; pixel < pixelCount; pixel++) {
+				memcpy(&rgbPixels[pixel * 3], &pixels[pixel * 4], 3);
+			}
+
+			return rgbPixels;
+		}
+
+		void appendPngData(void* context, void* data, int size) {
+			std::vector<uint8_t>& encoded = *static_cast<std::vector<uint8_t>*>(context);
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+			encoded.insert(encoded.end(), bytes, bytes + size);
+		}
+	}
+
+	FrameWriter::FrameWriter(const FrameWriterOptions& options)
+		: _options{ options }, _pipe{ nullptr }, _previousSigPipeHandler{ nullptr }, _queuedFrameCount{ 0 }, _writtenFrameCount{ 0 }, _nextSequence{ 0 },
+		_nextPipeSequence{ 0 }, _isPipeBroken{ false }, _pool{ options.threadCount } {
+		if (_options.maxQueuedFrames == 0) {
+			throw std::runtime_error("The frame writer needs room for at least one frame");
+		}
+
+		if (!_options.output.empty() && _options.output[0] == '|') {
+			_pipe = popen(_options.output.c_str() + 1, "w");
+
+			if (_pipe == nullptr) {
+				throw std::runtime_error("Failed to start " + _options.output.substr(1));
+			}
+
+#ifndef _WIN32
+			// A command which exits early fails the writes instead of terminating the process
+			_previousSigPipeHandler = signal(SIGPIPE, SIG_IGN);
+#endif
+		}
+	}
+
+	// Failures are only reported by flush
+	FrameWriter::~FrameWriter() {
+		try {
+			_pool.wait();
+		} catch (...) {
+		}
+
+		if (_pipe != nullptr) {
+			pclose(_pipe);
+
+#ifndef _WIN32
+			if (_previousSigPipeHandler != SIG_ERR) {
+				signal(SIGPIPE, _previousSigPipeHandler);
+			}
+#endif
+		}
+	}
+
+	void FrameWriter::write(uint64_t index, uint32_t width, uint32_t height, const uint8_t* pixels) {
+		uint64_t sequence;
+
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			_frameFinished.wait(lock, [this] { return _queuedFrameCount < _options.maxQueuedFrames; });
+
+			_queuedFrameCount++;
+			sequence = _nextSequence++;
+		}
+
+		std::vector<uint8_t> frame(pixels, pixels + static_cast<size_t>(width) * height * 4);
+
+		// The frame is released from the queue even when it fails, the pool keeps the exception for flush
+		_pool.submit([this, sequence, index, width, height, frame = std::move(frame)]() mutable {
+			std::vector<uint8_t> data;
+
+			try {
+				data = encodeFrame(width, height, frame);
+
+				if (_pipe == nullptr) {
+					writeFile(index, data);
+					data.clear();
+				}
+			} catch (...) {
+				finishFrame(sequence, {}, false);
+
+				throw;
+			}
+
+			finishFrame(sequence, std::move(data), true);
+		});
+	}
+
+	void FrameWriter::flush() {
+		_pool.wait();
+
+		std::lock_guard<std::mutex> lock{ _mutex };
+
+		if (_isPipeBroken) {
+			throw std::runtime_error("Failed to write the frames to " + _options.output.substr(1));
+		}
+
+		if (_pipe != nullptr) {
+			fflush(_pipe);
+		}
+	}
+
+	uint64_t FrameWriter::getWrittenFrameCount() {
+		std::lock_guard<std::mutex> lock{ _mutex };
+
+		return _writtenFrameCount;
+	}
+
+	std::vector<uint8_t> FrameWriter::encodeFrame(uint32_t width, uint32_t height, std::vector<uint8_t>& pixels) const {
+		if (_options.format == ImageFileFormat::Raw) {
+			return std::move(pixels);
+		}
+
+		std::vector<uint8_t> rgbPixels = getRgbPixels(width, height, pixels);
+
+		if (_options.format == ImageFileFormat::Ppm) {
+			std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+			rgbPixels.insert(rgbPixels.begin(), header.begin(), header.end());
+
+			return rgbPixels;
+		}
+
+		std::vector<uint8_t> encoded;
+
+		if (stbi_write_png_to_func(appendPngData, &encoded, static_cast<int>(width), static_cast<int>(height), 3, rgbPixels.data(), static_cast<int>(width * 3)) == 0) {
+			throw std::runtime_error("Failed to encode a frame as PNG");
+		}
+
+		return encoded;
+	}
+
+	void FrameWriter::writeFile(uint64_t index, const std::vector<uint8_t>& data) const {
+		char path[4096];
+		snprintf(path, sizeof(path), _options.output.c_str(), static_cast<unsigned long long>(index));
+
+		std::ofstream file(path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+		if (!file) {
+			throw std::runtime_error(std::string("Failed to write ") + path);
+		}
+	}
+
+	// The pipe is written under the lock, so the encoders only wait for each other while a frame is being sent
+	void FrameWriter::finishFrame(uint64_t sequence, std::vector<uint8_t> data, bool isWritten) {
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+
+			if (_pipe != nullptr) {
+				_pipeFrames[sequence] = { std::move(data), isWritten };
+
+				for (auto frame = _pipeFrames.begin(); frame != _pipeFrames.end() && frame->first == _nextPipeSequence; frame = _pipeFrames.erase(frame)) {
+					const PipeFrame& pipeFrame = frame->second;
+
+					if (pipeFrame.isEncoded && !_isPipeBroken) {
+						if (fwrite(pipeFrame.data.data(), 1, pipeFrame.data.size(), _pipe) == pipeFrame.data.size()) {
+							_writtenFrameCount++;
+						} else {
+							_isPipeBroken = true;
+						}
+					}
+
+					_queuedFrameCount--;
+					_nextPipeSequence++;
+				}
+			} else {
+				_queuedFrameCount--;
+
+				if (isWritten) {
+					_writtenFrameCount++;
+				}
+			}
+		}
+
+		_frameFinished.notify_all();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#ifndef __VULKAN_RAY_TRACING_FRAME_WRITER_HPP__
+#define __VULKAN_RAY_TRACING_FRAME_WRITER_HPP__
+
+#include "vrt_thread_pool.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vrt {
+	enum class ImageFileFormat : uint32_t {
+		// Lossless and compressed, by far the slowest to encode
+		Png = 0,
+
+		// Binary PPM, the RGB channels behind a short header
+		Ppm = 1,
+
+		// The RGBA8 rows as traced, without any header
+		Raw = 2
+	};
+
+	struct FrameWriterOptions {
+		// printf pattern of the files written, given the index of the frame as an unsigned long long, so it needs a
+		// conversion such as %05llu. When it starts with | instead, the rest is run as a command which receives the
+		// frames in order on its standard input, such as "| ffmpeg -f rawvideo ...".
+		std::string output = "frame_%05llu.png";
+		ImageFileFormat format = ImageFileFormat::Png;
+
+		// Zero starts one writer per core
+		uint32_t threadCount = 0;
+
+		// Frames copied and not written yet, write blocks beyond so the memory stays bounded when the disk or the
+		// encoder cannot keep up. While piping, the frames waiting for an earlier one to be sent count as well.
+		uint32_t maxQueuedFrames = 8;
+	};
+
+	// Encodes and writes the frames on a pool of threads, so saving them costs the render thread a copy. While a
+	// writer pipes to a command, SIGPIPE is ignored by the whole process, so a command which exits early fails the
+	// writes instead of terminating it. The previous handler is restored by the destructor.
+	class FrameWriter {
+	public:
+		FrameWriter(const FrameWriterOptions& options);
+		~FrameWriter();
+
+		FrameWriter(FrameWriter&) = delete;
+		FrameWriter& operator=(FrameWriter&) = delete;
+
+		// Copies the tightly packed RGBA8 rows, which can be released as soon as it returns
+		void write(uint64_t index, uint32_t width, uint32_t height, const uint8_t* pixels);
+
+		// Blocks until every frame queued was written, rethrows the first failure
+		void flush();
+
+		uint64_t getWrittenFrameCount();
+
+	private:
+		std::vector<uint8_t> encodeFrame(uint32_t width, uint32_t height, std::vector<uint8_t>& pixels) const;
+		void writeFile(uint64_t index, const std::vector<uint8_t>& data) const;
+		void finishFrame(uint64_t sequence, std::vector<uint8_t> data, bool isWritten);
+
+		FrameWriterOptions _options;
+		FILE* _pipe;
+		void (*_previousSigPipeHandler)(int);
+
+		std::mutex _mutex;
+		std::condition_variable _frameFinished;
+		uint32_t _queuedFrameCount;
+		uint64_t _writtenFrameCount;
+
+		struct PipeFrame {
+			std::vector<uint8_t> data;
+			bool isEncoded;
+		};
+
+		// Frames are numbered in the order they are queued, the pipe receives them in that order. Those encoded before
+		// the previous ones wait in the map and stay queued until sent, a failed frame leaves an entry which is skipped.
+		uint64_t _nextSequence;
+		uint64_t _nextPipeSequence;
+		std::map<uint64_t, PipeFrame> _pipeFrames;
+		bool _isPipeBroken;
+
+		// Declared last, so its threads are joined before the members they use are destroyed
+		ThreadPool _pool;
+	};
+}
+
+#endif
\ No newline at end of file
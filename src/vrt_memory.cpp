@@ -0,0 +1,235 @@
+#include "vrt_memory.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vrt {
+	const VkDeviceSize MemoryAllocator::BLOCK_SIZE = 64 * 1024 * 1024;
+
+	namespace {
+		VkDeviceSize alignOffset(VkDeviceSize offset, VkDeviceSize alignment) {
+			return (offset + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	MemoryAllocator::MemoryAllocator() : _device{ VK_NULL_HANDLE }, _memoryProperties{}, _bufferImageGranularity{ 1 } {}
+
+	MemoryAllocator::~MemoryAllocator() {
+		destroy();
+	}
+
+	void MemoryAllocator::create(VkPhysicalDevice physicalDevice, VkDevice device) {
+		_device = device;
+
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &_memoryProperties);
+
+		VkPhysicalDeviceProperties physicalDeviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+		_bufferImageGranularity = physicalDeviceProperties.limits.bufferImageGranularity;
+
+		_blocks.resize(_memoryProperties.memoryTypeCount);
+	}
+
+	// Must be called before the device is destroyed, the resources bound to the blocks have to be destroyed first
+	void MemoryAllocator::destroy() {
+		for (auto& blocks : _blocks) {
+			for (auto& block : blocks) {
+				if (block.handle != nullptr) {
+					vkUnmapMemory(_device, block.memory);
+				}
+
+				vkFreeMemory(_device, block.memory, nullptr);
+			}
+		}
+
+		_blocks.clear();
+	}
+
+	Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool isLinear) {
+		uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+		std::vector<Block>& blocks = _blocks[memoryType];
+
+		bool sharesBlocks = _bufferImageGranularity <= 1;
+
+		Block* target = nullptr;
+		VkDeviceSize offset = 0;
+
+		for (auto& block : blocks) {
+			if ((sharesBlocks || block.isLinear == isLinear) && allocateFromBlock(block, requirements.size, requirements.alignment, offset)) {
+				target = &block;
+
+				break;
+			}
+		}
+
+		if (target == nullptr) {
+			// Resources larger than a block get a dedicated one
+			VkMemoryAllocateInfo memoryAllocateInfo{};
+			memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			memoryAllocateInfo.allocationSize = std::max<VkDeviceSize>(getBlockSize(memoryType), requirements.size);
+			memoryAllocateInfo.memoryTypeIndex = memoryType;
+
+			Block block{};
+			block.size = memoryAllocateInfo.allocationSize;
+			block.isLinear = isLinear;
+			block.freeRanges.push_back({ 0, block.size });
+
+			if (vkAllocateMemory(_device, &memoryAllocateInfo, nullptr, &block.memory) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate a device memory block");
+			}
+
+			if (_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+				void* handle;
+
+				if (vkMapMemory(_device, block.memory, 0, VK_WHOLE_SIZE, 0, &handle) != VK_SUCCESS) {
+					vkFreeMemory(_device, block.memory, nullptr);
+
+					throw std::runtime_error("Failed to map a device memory block");
+				}
+
+				block.handle = static_cast<uint8_t*>(handle);
+			}
+
+			blocks.push_back(block);
+			target = &blocks.back();
+
+			allocateFromBlock(*target, requirements.size, requirements.alignment, offset);
+		}
+
+		Allocation allocation{};
+		allocation.memory = target->memory;
+		allocation.offset = offset;
+		allocation.size = requirements.size;
+		allocation.memoryType = memoryType;
+		allocation.handle = target->handle != nullptr ? target->handle + offset : nullptr;
+
+		return allocation;
+	}
+
+	void MemoryAllocator::free(const Allocation& allocation) {
+		std::vector<Block>& blocks = _blocks[allocation.memoryType];
+
+		auto block = std::find_if(blocks.begin(), blocks.end(), [&](const Block& block) { return block.memory == allocation.memory; });
+
+		if (block == blocks.end()) {
+			throw std::runtime_error("The allocation does not belong to the allocator");
+		}
+
+		// Empty blocks go back to the device, a scene reload allocates new ones
+		if (--block->allocationCount == 0) {
+			if (block->handle != nullptr) {
+				vkUnmapMemory(_device, block->memory);
+			}
+
+			vkFreeMemory(_device, block->memory, nullptr);
+			blocks.erase(block);
+
+			return;
+		}
+
+		std::vector<Range>& ranges = block->freeRanges;
+
+		auto next = std::lower_bound(ranges.begin(), ranges.end(), allocation.offset, [](const Range& range, VkDeviceSize offset) { return range.offset < offset; });
+		Range freed{ allocation.offset, allocation.size };
+
+		if (next != ranges.end() && freed.offset + freed.size == next->offset) {
+			freed.size += next->size;
+			next = ranges.erase(next);
+		}
+
+		if (next != ranges.begin() && std::prev(next)->offset + std::prev(next)->size == freed.offset) {
+			std::prev(next)->size += freed.size;
+		} else {
+			ranges.insert(next, freed);
+		}
+	}
+
+	MemoryStatistics MemoryAllocator::getStatistics() const {
+		MemoryStatistics statistics{};
+
+		VkDeviceSize freeBytes = 0;
+		// Sum of the largest free range of each block, so the ratio is the per block one weighted by the free bytes
+		VkDeviceSize largestFreeRanges = 0;
+
+		for (const auto& blocks : _blocks) {
+			for (const auto& block : blocks) {
+				statistics.blockCount++;
+				statistics.allocationCount += block.allocationCount;
+				statistics.blockBytes += block.size;
+
+				VkDeviceSize largestFreeRange = 0;
+
+				for (const auto& range : block.freeRanges) {
+					freeBytes += range.size;
+					largestFreeRange = std::max(largestFreeRange, range.size);
+				}
+
+				largestFreeRanges += largestFreeRange;
+			}
+		}
+
+		statistics.usedBytes = statistics.blockBytes - freeBytes;
+		statistics.fragmentation = freeBytes > 0 ? 1.0f - static_cast<float>(largestFreeRanges) / static_cast<float>(freeBytes) : 0.0f;
+
+		return statistics;
+	}
+
+	bool MemoryAllocator::hasMemoryType(VkMemoryPropertyFlags properties) const {
+		for (uint32_t i = 0; i < _memoryProperties.memoryTypeCount; i++) {
+			if ((_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+		for (uint32_t i = 0; i < _memoryProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("Could not find a matching memory type");
+	}
+
+	// Small heaps, such as the host visible window of device local memory, are split in smaller blocks
+	VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryType) const {
+		VkDeviceSize heapSize = _memoryProperties.memoryHeaps[_memoryProperties.memoryTypes[memoryType].heapIndex].size;
+
+		return std::min(BLOCK_SIZE, heapSize / 8);
+	}
+
+	// First fit, the alignment padding in front of the allocation stays free
+	bool MemoryAllocator::allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+		for (auto range = block.freeRanges.begin(); range != block.freeRanges.end(); range++) {
+			VkDeviceSize start = alignOffset(range->offset, std::max<VkDeviceSize>(alignment, 1));
+			VkDeviceSize rangeEnd = range->offset + range->size;
+
+			if (start + size > rangeEnd) {
+				continue;
+			}
+
+			Range before{ range->offset, start - range->offset };
+			Range after{ start + size, rangeEnd - start - size };
+
+			range = block.freeRanges.erase(range);
+
+			if (after.size > 0) {
+				range = block.freeRanges.insert(range, after);
+			}
+
+			if (before.size > 0) {
+				block.freeRanges.insert(range, before);
+			}
+
+			block.allocationCount++;
+			offset = start;
+
+			return true;
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,95 @@
+#ifndef __VULKAN_RAY_TRACING_MEMORY_HPP__
+#define __VULKAN_RAY_TRACING_MEMORY_HPP__
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace vrt {
+	// Range of a device memory block bound to a single buffer or image.
+	struct Allocation {
+		VkDeviceMemory memory;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		uint32_t memoryType;
+
+		// Points into the persistent mapping of the block, null when the memory is not host visible
+		void* handle;
+	};
+
+	struct MemoryStatistics {
+		uint32_t blockCount;
+		uint32_t allocationCount;
+
+		// Allocated from the device, and bound to resources out of it
+		VkDeviceSize blockBytes;
+		VkDeviceSize usedBytes;
+
+		// 1 - largest free range / free bytes of each block, averaged weighted by the free bytes, 0 when the free space
+		// of every block is contiguous
+		float fragmentation;
+	};
+
+	// Sub-allocates buffers and images from large blocks, one list of blocks per memory type, so the number of
+	// device allocations stays far below maxMemoryAllocationCount. Host visible blocks are mapped once for their
+	// whole lifetime. When bufferImageGranularity is larger than one, buffers and images are placed in separate
+	// blocks, so linear and optimal resources never share a granularity page.
+	class MemoryAllocator {
+	public:
+		MemoryAllocator();
+		~MemoryAllocator();
+
+		MemoryAllocator(MemoryAllocator&) = delete;
+		MemoryAllocator& operator=(MemoryAllocator&) = delete;
+
+		void create(VkPhysicalDevice physicalDevice, VkDevice device);
+		void destroy();
+
+		// Linear resources are buffers and linear images, the others are optimal images
+		Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool isLinear);
+		void free(const Allocation& allocation);
+
+		MemoryStatistics getStatistics() const;
+
+		// Whether any memory type has all the properties, to request optional ones such as HOST_CACHED
+		bool hasMemoryType(VkMemoryPropertyFlags properties) const;
+
+	public:
+		static const VkDeviceSize BLOCK_SIZE;
+
+	private:
+		struct Range {
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+
+		struct Block {
+			VkDeviceMemory memory;
+			VkDeviceSize size;
+			bool isLinear;
+			uint8_t* handle;
+
+			uint32_t allocationCount;
+
+			// Sorted by offset, two free ranges are never adjacent
+			std::vector<Range> freeRanges;
+		};
+
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+		VkDeviceSize getBlockSize(uint32_t memoryType) const;
+
+		static bool allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+
+	private:
+		VkDevice _device;
+
+		VkPhysicalDeviceMemoryProperties _memoryProperties;
+		VkDeviceSize _bufferImageGranularity;
+
+		// Indexed by memory type
+		std::vector<std::vector<Block>> _blocks;
+	};
+}
+
+#endif
@@ -0,0 +1,178 @@
+#include "vrt_mesh.hpp"
+#include "vrt_bvh.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace vrt {
+	const uint32_t MESH_TRIANGLE_BITS = 22;
+	const uint32_t MAX_MESH_COUNT = 256;
+
+	namespace {
+		const float QUANTIZATION_MAX = 65535.0f;
+		const float FLOAT_MAX = std::numeric_limits<float>::max();
+
+		bool isKeyword(const char* cursor, char keyword) {
+			return cursor[0] == keyword && (cursor[1] == ' ' || cursor[1] == '\t');
+		}
+	}
+
+	MeshGeometry loadObjMesh(const char* path) {
+		std::ifstream file(path);
+
+		if (!file.is_open()) {
+			throw std::runtime_error(std::string("Failed to open the mesh file ") + path);
+		}
+
+		MeshGeometry geometry{};
+		std::vector<uint32_t> face;
+		std::string line;
+
+		while (std::getline(file, line)) {
+			const char* cursor = line.c_str();
+
+			while (*cursor == ' ' || *cursor == '\t') {
+				cursor++;
+			}
+
+			if (isKeyword(cursor, 'v')) {
+				glm::vec3 position;
+				cursor += 2;
+
+				for (int axis = 0; axis < 3; axis++) {
+					char* end;
+					position[axis] = std::strtof(cursor, &end);
+
+					if (end == cursor) {
+						throw std::runtime_error(std::string("Invalid vertex in the mesh file ") + path);
+					}
+
+					cursor = end;
+				}
+
+				geometry.positions.push_back(position);
+			} else if (isKeyword(cursor, 'f')) {
+				face.clear();
+				cursor += 2;
+
+				while (true) {
+					char* end;
+					long index = std::strtol(cursor, &end, 10);
+
+					if (end == cursor) {
+						break;
+					}
+
+					// Only the position is kept from the v/vt/vn references, negative ones count back from the last vertex
+					cursor = end;
+
+					while (*cursor != '\0' && *cursor != ' ' && *cursor != '\t') {
+						cursor++;
+					}
+
+					long vertexCount = static_cast<long>(geometry.positions.size());
+					long position = index < 0 ? vertexCount + index : index - 1;
+
+					if (index == 0 || position < 0 || position >= vertexCount) {
+						throw std::runtime_error(std::string("A face references a missing vertex in the mesh file ") + path);
+					}
+
+					face.push_back(static_cast<uint32_t>(position));
+				}
+
+				if (face.size() < 3) {
+					throw std::runtime_error(std::string("A face has less than three vertices in the mesh file ") + path);
+				}
+
+				for (size_t vertex = 1; vertex + 1 < face.size(); vertex++) {
+					geometry.indices.push_back(face[0]);
+					geometry.indices.push_back(face[vertex]);
+					geometry.indices.push_back(face[vertex + 1]);
+				}
+			}
+		}
+
+		if (geometry.indices.empty()) {
+			throw std::runtime_error(std::string("The mesh file has no face ") + path);
+		}
+
+		return geometry;
+	}
+
+	uint32_t addMesh(Scene& scene, const MeshGeometry& geometry, const glm::mat4& transform, uint32_t material) {
+		if (geometry.indices.empty() || geometry.indices.size() % 3 != 0) {
+			throw std::runtime_error("A mesh needs at least one whole triangle");
+		}
+
+		if (scene.meshes.size() >= MAX_MESH_COUNT) {
+			throw std::runtime_error("Too many meshes in the scene");
+		}
+
+		if (geometry.indices.size() / 3 > (1u << MESH_TRIANGLE_BITS)) {
+			throw std::runtime_error("Too many triangles in the mesh");
+		}
+
+		for (uint32_t index : geometry.indices) {
+			if (index >= geometry.positions.size()) {
+				throw std::runtime_error("A triangle references a missing vertex");
+			}
+		}
+
+		std::vector<glm::vec3> positions{ geometry.positions.size() };
+		glm::vec3 min{ FLOAT_MAX, FLOAT_MAX, FLOAT_MAX };
+		glm::vec3 max{ -FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX };
+
+		for (size_t index = 0; index < positions.size(); index++) {
+			positions[index] = glm::vec3(transform * glm::vec4(geometry.positions[index], 1.0f));
+
+			min = glm::min(min, positions[index]);
+			max = glm::max(max, positions[index]);
+		}
+
+		Mesh mesh{};
+		mesh.origin = min;
+
+		// A flat mesh keeps a non zero scale on its empty axis, where every vertex quantizes to 0
+		mesh.scale = glm::max(max - min, glm::vec3(std::numeric_limits<float>::min())) / QUANTIZATION_MAX;
+
+		std::vector<MeshVertex> vertices{ positions.size() };
+
+		for (size_t index = 0; index < positions.size(); index++) {
+			glm::vec3 quantized = glm::clamp(glm::round((positions[index] - mesh.origin) / mesh.scale), 0.0f, QUANTIZATION_MAX);
+			vertices[index] = { static_cast<uint16_t>(quantized.x), static_cast<uint16_t>(quantized.y), static_cast<uint16_t>(quantized.z), 0 };
+
+			// The hierarchy bounds the triangles the shader will intersect
+			positions[index] = getMeshVertexPosition(mesh, vertices[index]);
+		}
+
+		Bvh bvh = buildTriangleBvh(positions, geometry.indices);
+
+		mesh.firstNode = static_cast<uint32_t>(scene.meshNodes.size());
+		mesh.firstTriangle = static_cast<uint32_t>(scene.meshIndices.size() / 3);
+		mesh.firstVertex = static_cast<uint32_t>(scene.meshVertices.size());
+		mesh.triangleCount = static_cast<uint32_t>(geometry.indices.size() / 3);
+		mesh.material = material;
+		mesh.nodeCount = static_cast<uint32_t>(bvh.nodes.size());
+
+		scene.meshVertices.insert(scene.meshVertices.end(), vertices.begin(), vertices.end());
+		scene.meshNodes.insert(scene.meshNodes.end(), bvh.nodes.begin(), bvh.nodes.end());
+
+		// Sorted along the leaves, which then reference their triangles directly
+		for (uint32_t triangle : bvh.indices) {
+			for (uint32_t vertex = 0; vertex < 3; vertex++) {
+				scene.meshIndices.push_back(geometry.indices[3 * static_cast<size_t>(triangle) + vertex]);
+			}
+		}
+
+		scene.meshes.push_back(mesh);
+
+		return static_cast<uint32_t>(scene.meshes.size() - 1);
+	}
+
+	glm::vec3 getMeshVertexPosition(const Mesh& mesh, const MeshVertex& vertex) {
+		return mesh.origin + glm::vec3(vertex.x, vertex.y, vertex.z) * mesh.scale;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef __VULKAN_RAY_TRACING_MESH_HPP__
+#define __VULKAN_RAY_TRACING_MESH_HPP__
+
+#include "vrt_scene.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace vrt {
+	// A hit on a mesh packs the index of the mesh above the index of its triangle, see RayHit in ray_tracing.glsl
+	extern const uint32_t MESH_TRIANGLE_BITS;
+	extern const uint32_t MAX_MESH_COUNT;
+
+	// Indexed triangles as read from a file, before quantization
+	struct MeshGeometry {
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+	};
+
+	// Reads the vertices and faces of a Wavefront OBJ file, polygons are split in fans. Normals, texture coordinates,
+	// groups and materials are ignored.
+	MeshGeometry loadObjMesh(const char* path);
+
+	// Transforms the positions and quantizes them over the bounds of the mesh, then builds its BVH over the quantized
+	// triangles and appends everything to the scene. Returns the index of the mesh.
+	uint32_t addMesh(Scene& scene, const MeshGeometry& geometry, const glm::mat4& transform, uint32_t material);
+
+	glm::vec3 getMeshVertexPosition(const Mesh& mesh, const MeshVertex& vertex);
+}
+
+#endif
\ No newline at end of file
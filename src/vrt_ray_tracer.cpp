@@ -1,145 +1,1336 @@
 #include "vrt_ray_tracer.hpp"
+#include "vrt_bvh.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
 #include <stdexcept>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <random>
 #include <set>
 
 namespace vrt {
+	namespace {
+		// Prefix of the pipeline cache file, the driver data is only handed back to the device and driver which wrote it
+		struct PipelineCacheFileHeader {
+			char magic[4];
+			uint32_t version;
+
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint8_t deviceUUID[VK_UUID_SIZE];
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+
+			uint64_t dataSize;
+		};
+
+		const char PIPELINE_CACHE_MAGIC[4] = { 'V', 'R', 'T', 'P' };
+		const uint32_t PIPELINE_CACHE_VERSION = 1;
+
+		// Shared by every device, the converted sky box does not depend on the driver
+		const char* SKY_BOX_CACHE_FILE_NAME = "sky_box.vrtc";
+
+		// Specialization constants of ray_tracing.comp, in the order of their constant_id
+		struct ComputeSpecialization {
+			uint32_t samplesPerPixel;
+			uint32_t maxBounces;
+			uint32_t workgroupWidth;
+			uint32_t workgroupHeight;
+		};
+
+		bool readBinaryFile(const char* path, std::vector<char>& data) {
+			std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+			if (!file.is_open()) {
+				return false;
+			}
+
+			data.resize(static_cast<size_t>(file.tellg()));
+
+			file.seekg(0);
+			file.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+			return static_cast<bool>(file);
+		}
+
+		PipelineCacheFileHeader createPipelineCacheHeader(VkPhysicalDevice physicalDevice) {
+			VkPhysicalDeviceIDProperties physicalDeviceIdProperties{};
+			physicalDeviceIdProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+			VkPhysicalDeviceProperties2 physicalDeviceProperties{};
+			physicalDeviceProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			physicalDeviceProperties.pNext = &physicalDeviceIdProperties;
+			vkGetPhysicalDeviceProperties2(physicalDevice, &physicalDeviceProperties);
+
+			PipelineCacheFileHeader header{};
+			memcpy(header.magic, PIPELINE_CACHE_MAGIC, sizeof(header.magic));
+			header.version = PIPELINE_CACHE_VERSION;
+			header.vendorID = physicalDeviceProperties.properties.vendorID;
+			header.deviceID = physicalDeviceProperties.properties.deviceID;
+			header.driverVersion = physicalDeviceProperties.properties.driverVersion;
+			memcpy(header.deviceUUID, physicalDeviceIdProperties.deviceUUID, VK_UUID_SIZE);
+			memcpy(header.pipelineCacheUUID, physicalDeviceProperties.properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+			return header;
+		}
+
+		// Push constants of the compute pipelines, Region in ray_tracing.glsl. The megakernel ignores the sample and
+		// the bounce.
+		struct ComputePushConstants {
+			VkExtent2D extent;
+			uint32_t sampleIndex;
+			uint32_t bounceIndex;
+			VkOffset2D offset;
+			VkExtent2D frameExtent;
+		};
+
+		// QueueCounter in wavefront.glsl, its first members form a VkDispatchIndirectCommand
+		struct QueueCounter {
+			uint32_t groupCountX;
+			uint32_t groupCountY;
+			uint32_t groupCountZ;
+			uint32_t count;
+		};
+
+		// Sizes of Path and HitRecord in wavefront.glsl with the std430 layout
+		const VkDeviceSize WAVEFRONT_PATH_SIZE = 64;
+		const VkDeviceSize WAVEFRONT_HIT_SIZE = 8;
+
+		// The counters are reset with vkCmdUpdateBuffer, which takes at most 64 KiB
+		const VkDeviceSize MAX_WAVEFRONT_COUNTERS_SIZE = 65536;
+
+		// Uploaded in place of the mesh buffers when the scene has no mesh, the shaders skip a mesh without triangles
+		const Mesh EMPTY_MESH{};
+		const MeshVertex EMPTY_MESH_VERTEX{};
+		const uint32_t EMPTY_MESH_INDEX = 0;
+		const BvhNode EMPTY_MESH_NODE{};
+
+		bool isSameExtent(VkExtent2D first, VkExtent2D second) {
+			return first.width == second.width && first.height == second.height;
+		}
+
+		uint64_t getTimestampMask(uint32_t validBits) {
+			return validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+		}
+
+		// Only the valid bits of the timestamps count, the difference is taken modulo them so a counter which wrapped
+		// between the two still gives the elapsed ticks
+		uint64_t getElapsedTicks(uint64_t start, uint64_t end, uint64_t mask) {
+			return ((end & mask) - (start & mask)) & mask;
+		}
+
+		// Unique per writer, so processes saving the same cache at once never write into each other's file
+		std::string getTemporaryPath(const std::string& path) {
+			std::random_device device;
+
+			char suffix[32];
+			snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", device(), device());
+
+			return path + suffix;
+		}
+	}
+
 	const char* RayTracer::SHADER_VERTEX_PATH = "shaders/rendering.vert.spv";
 	const char* RayTracer::SHADER_FRAGMENT_PATH = "shaders/rendering.frag.spv";
 	const char* RayTracer::SHADER_COMPUTE_PATH = "shaders/ray_tracing.comp.spv";
+	const char* RayTracer::SHADER_ANIMATION_PATH = "shaders/animate.comp.spv";
+	const char* RayTracer::SHADER_WAVEFRONT_GENERATE_PATH = "shaders/wavefront_generate.comp.spv";
+	const char* RayTracer::SHADER_WAVEFRONT_EXTEND_PATH = "shaders/wavefront_extend.comp.spv";
+	const char* RayTracer::SHADER_WAVEFRONT_SHADE_PATH = "shaders/wavefront_shade.comp.spv";
+	const char* RayTracer::SHADER_WAVEFRONT_SHADOW_PATH = "shaders/wavefront_shadow.comp.spv";
+	const char* RayTracer::SHADER_WAVEFRONT_RESOLVE_PATH = "shaders/wavefront_resolve.comp.spv";
+
+	const VkFormat RayTracer::TARGET_TEXTURE_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+	const VkFormat RayTracer::ACCUMULATION_TEXTURE_FORMAT = VK_FORMAT_R32G32B32A32_SFLOAT;
+
+	const uint32_t RayTracer::MAX_ACCUMULATED_FRAMES = 1 << 16;
+
+	const VkDeviceSize RayTracer::STAGING_ARENA_SIZE = 128 * 1024 * 1024;
+	const VkDeviceSize RayTracer::STAGING_CHUNK_SIZE = 32 * 1024 * 1024;
+	const VkDeviceSize RayTracer::STAGING_ALIGNMENT = 256;
+
+	const uint32_t RayTracer::ANIMATION_WORKGROUP_SIZE = 64;
+	const uint32_t RayTracer::WAVEFRONT_WORKGROUP_SIZE = 256;
+
+	const VkExtent2D RayTracer::DEFAULT_WORKGROUP_SIZE = { 16, 16 };
+	const std::vector<VkExtent2D> RayTracer::WORKGROUP_SIZE_CANDIDATES{ { 8, 4 }, { 8, 8 }, { 16, 8 }, { 8, 16 }, { 16, 16 }, { 32, 4 }, { 32, 8 }, { 64, 4 } };
+	const uint32_t RayTracer::WORKGROUP_TUNING_ROUNDS = 5;
+
+	const uint32_t RayTracer::TIMESTAMPS_PER_FRAME = 4;
+
+	const double RayTracer::RENDER_SCALE_SMOOTHING = 0.1;
+	const double RayTracer::RENDER_SCALE_HEADROOM = 0.9;
+	const double RayTracer::RENDER_SCALE_STEP = 0.02;
+
+	RayTracer::RayTracer(SurfaceProvider& surfaceProvider, const Scene& scene, const Options& options) : _surfaceProvider{ &surfaceProvider }, _options{ options }, _currentFrame{ 0 }, _lastSubmittedFrame{ 0 } {
+		startAssetLoading();
+
+		initialize(scene);
+	}
+
+	RayTracer::RayTracer(uint32_t width, uint32_t height, const Scene& scene, const Options& options) : _surfaceProvider{ nullptr }, _options{ options }, _currentFrame{ 0 }, _lastSubmittedFrame{ 0 } {
+		startAssetLoading();
 
-	const char* RayTracer::SKY_BOX_TEXTURE_PATHS[6] = {
-		"../data/skybox/back.jpg",
-		"../data/skybox/front.jpg",
-		"../data/skybox/top.jpg",
-		"../data/skybox/bottom.jpg",
-		"../data/skybox/right.jpg",
-		"../data/skybox/left.jpg"
-	};
+		_targetTexture.extent = { width, height };
+
+		initialize(scene);
+	}
+
+	RayTracer::RayTracer(SurfaceProvider& surfaceProvider, const SceneFile& sceneFile, const Options& options) : _surfaceProvider{ &surfaceProvider }, _options{ options }, _currentFrame{ 0 }, _lastSubmittedFrame{ 0 } {
+		startAssetLoading();
+
+		initialize(sceneFile.getData());
+	}
+
+	RayTracer::RayTracer(uint32_t width, uint32_t height, const SceneFile& sceneFile, const Options& options) : _surfaceProvider{ nullptr }, _options{ options }, _currentFrame{ 0 }, _lastSubmittedFrame{ 0 } {
+		startAssetLoading();
+
+		_targetTexture.extent = { width, height };
+
+		initialize(sceneFile.getData());
+	}
+
+	void RayTracer::initialize(const Scene& scene) {
+		Bvh bvh = buildBvh(scene.spheres, scene.animations);
+		std::vector<SphereAnimation> staticAnimations;
+		recordStartupStage("bvh");
+
+		initialize(createSceneData(scene, bvh, staticAnimations));
+	}
+
+	void RayTracer::initialize(const SceneData& scene) {
+		if (_options.framesInFlight == 0) {
+			throw std::runtime_error("At least one frame has to be in flight");
+		}
+
+		if (_options.samplesPerPixel == 0) {
+			throw std::runtime_error("At least one sample per pixel is required");
+		}
+
+		if (_options.maxBounces == 0) {
+			throw std::runtime_error("At least one bounce is required");
+		}
+
+		if (!(_options.renderScale > 0.0f && _options.renderScale <= 1.0f)) {
+			throw std::runtime_error("The render scale has to be in (0, 1]");
+		}
+
+		if (_options.frameTimeBudget > 0.0f && !(_options.minRenderScale > 0.0f && _options.minRenderScale <= _options.renderScale)) {
+			throw std::runtime_error("The minimum render scale has to be in (0, renderScale]");
+		}
+
+		if (_options.wavefront && 2 * _options.samplesPerPixel * _options.maxBounces * sizeof(QueueCounter) > MAX_WAVEFRONT_COUNTERS_SIZE) {
+			throw std::runtime_error("Too many samples and bounces for the wavefront queue counters");
+		}
+
+		if (_options.uploadRingSize < _options.framesInFlight) {
+			throw std::runtime_error("The upload ring is too small for the frames in flight");
+		}
+
+		if (scene.sphereCount == 0 || scene.planeCount == 0) {
+			throw std::runtime_error("The scene needs at least one sphere and one plane");
+		}
+
+		if (scene.materialCount == 0) {
+			throw std::runtime_error("The scene needs at least one material");
+		}
+
+		if (scene.animationCount != scene.sphereCount) {
+			throw std::runtime_error("Every sphere needs an animation");
+		}
+
+		_accumulation.enabled = false;
+		_accumulation.frameCount = 0;
+		_capture.frameCount = 0;
 
-	RayTracer::RayTracer(Window& window) : _window{ window } {
 		createInstance();
+		recordStartupStage("instance");
+
 		createDevice();
 		createCommandPools();
-		createSwapChain();
+		createTransferResources();
+		recordStartupStage("device");
+
+		createPipelineCache();
+		recordStartupStage("pipeline cache");
+
+		createQueryPool();
+
+		_resolution.scale = 1.0f;
+		_resolution.computeTimePerPixel = 0.0;
+		_resolution.renderTime = 0.0;
+
+		if (!isHeadless()) {
+			createSwapChain(VK_NULL_HANDLE);
+			createRenderPass();
+			createFrameBuffers();
+
+			_resolution.scale = _options.renderScale;
+			_targetTexture.extent = getScaledExtent(_options.renderScale);
+		}
+
+		_resolution.extent = _targetTexture.extent;
+
+		createSampler();
 		createTargetTexture();
+		recordStartupStage("swap chain and targets");
+
+		// The scene is copied on the transfer queue while the assets are still being decoded
+		createStorageBuffers(scene);
+		recordStartupStage("scene upload");
+
+		joinAssetLoading();
+		recordStartupStage("asset wait");
+
 		createSkyBox();
-		createStorageBuffers();
 		createDescriptorSets();
-		createGraphicsPipeline();
+		recordStartupStage("sky box upload");
+
+		if (!isHeadless()) {
+			createGraphicsPipeline();
+		}
+
 		createComputePipeline();
-		createDrawCommandBuffers();
-		createComputeCommandBuffer();
+		savePipelineCache();
+		recordStartupStage("pipelines");
+
+		if (!isHeadless()) {
+			createDrawCommandBuffers();
+		} else {
+			createReadbackBuffer();
+		}
+
+		createComputeCommandBuffers();
+		createUploadRing();
 		createSemaphoresAndFences();
+		recordStartupStage("command buffers");
+
+		_startup.statistics.total = getStartupTime();
+	}
+
+	// Everything the constructor reads from the disk is loaded on worker threads, while the main thread creates
+	// the device. The sky box comes from its cache when it is up to date, otherwise the faces are decoded and
+	// converted in parallel. The shader files are only read.
+	void RayTracer::startAssetLoading() {
+		_startup.start = std::chrono::steady_clock::now();
+		_startup.stageStart = _startup.start;
+		_startup.statistics = {};
+
+		std::vector<const char*> shaderPaths{ SHADER_ANIMATION_PATH };
+
+		if (_options.wavefront) {
+			shaderPaths.insert(shaderPaths.end(), { SHADER_WAVEFRONT_GENERATE_PATH, SHADER_WAVEFRONT_EXTEND_PATH, SHADER_WAVEFRONT_SHADE_PATH, SHADER_WAVEFRONT_SHADOW_PATH, SHADER_WAVEFRONT_RESOLVE_PATH });
+		} else {
+			shaderPaths.push_back(SHADER_COMPUTE_PATH);
+		}
+
+		if (!isHeadless()) {
+			shaderPaths.push_back(SHADER_VERTEX_PATH);
+			shaderPaths.push_back(SHADER_FRAGMENT_PATH);
+		}
+
+		// Every task writes its own slot, the containers are not resized once the tasks are submitted: the cache
+		// lookup first, then the six faces and the shaders
+		_assets.isSkyBoxCached = false;
+		_assets.hasSkyBoxSources = false;
+		_assets.taskEnds.resize(7 + shaderPaths.size());
+
+		if (_options.cacheDirectory != nullptr) {
+			_assets.skyBoxCachePath = (std::filesystem::path(_options.cacheDirectory) / SKY_BOX_CACHE_FILE_NAME).string();
+		}
+
+		for (const char* path : shaderPaths) {
+			_assets.shaderCodes[path] = {};
+		}
+
+		uint32_t taskCount = static_cast<uint32_t>(_assets.taskEnds.size());
+		_assets.pool = std::make_unique<ThreadPool>(std::min(taskCount, std::max(1u, std::thread::hardware_concurrency())));
+
+		_assets.pool->submit([this] {
+			_assets.hasSkyBoxSources = getSkyBoxSources(_assets.skyBoxSources);
+
+			if (_assets.hasSkyBoxSources && !_assets.skyBoxCachePath.empty()) {
+				_assets.isSkyBoxCached = readSkyBoxCache(_assets.skyBoxCachePath.c_str(), _assets.skyBoxSources, _assets.skyBox);
+			}
+
+			// Always converted to BC1, which is decompressed again on the devices which cannot sample it
+			for (uint32_t face = 0; face < 6 && !_assets.isSkyBoxCached; face++) {
+				_assets.pool->submit([this, face] {
+					int width, height, channels;
+					std::unique_ptr<stbi_uc, void (*)(void*)> pixels(stbi_load(SKY_BOX_TEXTURE_PATHS[face], &width, &height, &channels, STBI_rgb_alpha), stbi_image_free);
+
+					// Faces which are not square are left empty, and reported by createSkyBox
+					if (pixels && width == height) {
+						_assets.skyBoxFaceSizes[face] = static_cast<uint32_t>(width);
+						_assets.skyBoxFaces[face] = convertSkyBoxFace(pixels.get(), static_cast<uint32_t>(width), SkyBoxFormat::Bc1);
+					}
+
+					_assets.taskEnds[1 + face] = std::chrono::steady_clock::now();
+				});
+			}
+
+			_assets.taskEnds[0] = std::chrono::steady_clock::now();
+		});
+
+		for (size_t index = 0; index < shaderPaths.size(); index++) {
+			std::vector<char>& code = _assets.shaderCodes[shaderPaths[index]];
+
+			// A missing file is reported by loadShaderModule, which reads it again on the main thread
+			_assets.pool->submit([this, index, &code, path = shaderPaths[index]] {
+				if (!readBinaryFile(path, code)) {
+					code.clear();
+				}
+
+				_assets.taskEnds[7 + index] = std::chrono::steady_clock::now();
+			});
+		}
+	}
+
+	void RayTracer::joinAssetLoading() {
+		_assets.pool->wait();
+		_assets.pool.reset();
+
+		auto lastTaskEnd = *std::max_element(_assets.taskEnds.begin(), _assets.taskEnds.end());
+		_startup.statistics.assetLoading = std::chrono::duration<double, std::milli>(lastTaskEnd - _startup.start).count();
+	}
+
+	void RayTracer::recordStartupStage(const char* name) {
+		auto now = std::chrono::steady_clock::now();
+
+		_startup.statistics.stages.push_back({ name, std::chrono::duration<double, std::milli>(now - _startup.stageStart).count() });
+		_startup.stageStart = now;
+	}
+
+	double RayTracer::getStartupTime() const {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _startup.start).count();
+	}
+
+	RayTracer::~RayTracer() {
+		vkDeviceWaitIdle(_logicalDevice);
+
+		collectUploads();
+		vkDestroySemaphore(_logicalDevice, _transfer.timeline, nullptr);
+		vkDestroySemaphore(_logicalDevice, _transfer.handoverTimeline, nullptr);
+		_allocator.free(_transfer.stagingMemory);
+		vkDestroyBuffer(_logicalDevice, _transfer.stagingBuffer, nullptr);
+
+		for (uint32_t frame = 0; frame < _options.framesInFlight; frame++) {
+			vkDestroyFence(_logicalDevice, _sync.frameComplete[frame], nullptr);
+		}
+
+		if (!isHeadless()) {
+			for (uint32_t frame = 0; frame < _options.framesInFlight; frame++) {
+				vkDestroySemaphore(_logicalDevice, _sync.computeComplete[frame], nullptr);
+				vkDestroySemaphore(_logicalDevice, _sync.presentComplete[frame], nullptr);
+			}
+
+			for (auto semaphore : _sync.renderComplete) {
+				vkDestroySemaphore(_logicalDevice, semaphore, nullptr);
+			}
+		} else {
+			_allocator.free(_readback.memory);
+			vkDestroyBuffer(_logicalDevice, _readback.buffer, nullptr);
+		}
+
+		for (size_t frame = 0; frame < _capture.buffers.size(); frame++) {
+			if (_capture.buffers[frame] != VK_NULL_HANDLE) {
+				_allocator.free(_capture.memories[frame]);
+				vkDestroyBuffer(_logicalDevice, _capture.buffers[frame], nullptr);
+			}
+		}
+
+		if (_timestamps.enabled) {
+			vkDestroyQueryPool(_logicalDevice, _timestamps.queryPool, nullptr);
+		}
+
+		_allocator.free(_upload.memory);
+		vkDestroyBuffer(_logicalDevice, _upload.buffer, nullptr);
+
+		vkDestroyPipelineCache(_logicalDevice, _pipelineCache.cache, nullptr);
+
+		vkDestroyPipeline(_logicalDevice, _compute.animationPipeline, nullptr);
+		vkDestroyPipeline(_logicalDevice, _compute.pipeline, nullptr);
+
+		if (_options.wavefront) {
+			vkDestroyPipeline(_logicalDevice, _wavefront.generatePipeline, nullptr);
+			vkDestroyPipeline(_logicalDevice, _wavefront.extendPipeline, nullptr);
+			vkDestroyPipeline(_logicalDevice, _wavefront.shadePipeline, nullptr);
+			vkDestroyPipeline(_logicalDevice, _wavefront.shadowPipeline, nullptr);
+			vkDestroyPipeline(_logicalDevice, _wavefront.resolvePipeline, nullptr);
+		}
+		vkDestroyPipelineLayout(_logicalDevice, _compute.pipelineLayout, nullptr);
+
+		if (!isHeadless()) {
+			vkDestroyPipeline(_logicalDevice, _graphics.pipeline, nullptr);
+			vkDestroyPipelineLayout(_logicalDevice, _graphics.pipelineLayout, nullptr);
+		}
+
+		_allocator.free(_scene.spherePositionMemory);
+		vkDestroyBuffer(_logicalDevice, _scene.spherePositionBuffer, nullptr);
+		_allocator.free(_scene.meshNodeMemory);
+		vkDestroyBuffer(_logicalDevice, _scene.meshNodeBuffer, nullptr);
+		_allocator.free(_scene.meshIndexMemory);
+		vkDestroyBuffer(_logicalDevice, _scene.meshIndexBuffer, nullptr);
+		_allocator.free(_scene.meshVertexMemory);
+		vkDestroyBuffer(_logicalDevice, _scene.meshVertexBuffer, nullptr);
+		_allocator.free(_scene.meshMemory);
+		vkDestroyBuffer(_logicalDevice, _scene.meshBuffer, nullptr);
+		_allocator.free(_scene.animationMemory);
+		vkDestroyBuffer(_logicalDevice, _scene.animationBuffer, nullptr);
+		_allocator.free(_scene.bvhIndexMemory);
+		vkDestroyBuffer(_logicalDevice, _scene.bvhIndexBuffer, nullptr);
+		_allocator.free(_scene.bvhNodeMemory);
+		vkDestroyBuffer(_logicalDevice, _scene.bvhNodeBuffer, nullptr);
+		_allocator.free(_scene.materialMemory);
+		vkDestroyBuffer(_logicalDevice, _scene.materialBuffer, nullptr);
+		_allocator.free(_scene.planeMemory);
+		vkDestroyBuffer(_logicalDevice, _scene.planeBuffer, nullptr);
+		_allocator.free(_scene.sphereMemory);
+		vkDestroyBuffer(_logicalDevice, _scene.sphereBuffer, nullptr);
+
+		for (uint32_t frame = 0; frame < _options.framesInFlight; frame++) {
+			_allocator.free(_scene.settingMemories[frame]);
+			vkDestroyBuffer(_logicalDevice, _scene.settingBuffers[frame], nullptr);
+		}
+
+		vkDestroyImageView(_logicalDevice, _skyBox.imageView, nullptr);
+		vkDestroyImage(_logicalDevice, _skyBox.image, nullptr);
+		_allocator.free(_skyBox.imageDeviceMemory);
+
+		destroyTargetTexture();
+		vkDestroySampler(_logicalDevice, _sampler, nullptr);
+
+		vkDestroyDescriptorSetLayout(_logicalDevice, _compute.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(_logicalDevice, _descriptorPool, nullptr);
+
+		if (!isHeadless()) {
+			vkDestroyDescriptorSetLayout(_logicalDevice, _graphics.descriptorSetLayout, nullptr);
+
+			destroySwapChainResources();
+			vkDestroyRenderPass(_logicalDevice, _swapChain.renderPass, nullptr);
+			vkDestroySwapchainKHR(_logicalDevice, _swapChain.swapChain, nullptr);
+		}
+
+		vkDestroyCommandPool(_logicalDevice, _graphics.commandPool, nullptr);
+		vkDestroyCommandPool(_logicalDevice, _compute.commandPool, nullptr);
+		vkDestroyCommandPool(_logicalDevice, _transfer.commandPool, nullptr);
+
+		_allocator.destroy();
+		vkDestroyDevice(_logicalDevice, nullptr);
+
+		if (!isHeadless()) {
+			vkDestroySurfaceKHR(_instance, _surface, nullptr);
+		}
+
+		vkDestroyInstance(_instance, nullptr);
+	}
+
+	void RayTracer::drawFrame() {
+		uint32_t frame = _currentFrame;
+
+		// Only wait for the frame which used this slot last, the others keep running on the GPU
+		vkWaitForFences(_logicalDevice, 1, &_sync.frameComplete[frame], VK_TRUE, UINT64_MAX);
+		deliverCapture(frame);
+
+		auto frameStart = std::chrono::steady_clock::now();
+
+		// The image is acquired before anything is submitted, so the frame can still be dropped when the swap chain
+		// turns out to be out of date. The fence is only reset once the frame is certain to be submitted.
+		uint32_t imageIndex = 0;
+
+		if (!isHeadless()) {
+			if (_swapChain.isOutdated && !recreateSwapChain()) {
+				return;
+			}
+
+			VkResult result = vkAcquireNextImageKHR(_logicalDevice, _swapChain.swapChain, UINT64_MAX, _sync.presentComplete[frame], VK_NULL_HANDLE, &imageIndex);
+
+			if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+				_swapChain.isOutdated = true;
+				recreateSwapChain();
+
+				return;
+			}
+
+			if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+				throw std::runtime_error("Failed to acquire the swap chain image");
+			}
+		}
+
+		vkResetFences(_logicalDevice, 1, &_sync.frameComplete[frame]);
+		readTimestamps(frame);
+
+		// The render scale changed, or the buffer was outdated by a new swap chain or workgroup size
+		if (!isSameExtent(_resolution.frameExtents[frame], _resolution.extent)) {
+			recordComputeCommandBuffer(frame);
+		}
+
+		updateAccumulation();
+		memcpy(_scene.settingHandles[frame], &_scene.settings, sizeof(Settings));
+
+		VkCommandBuffer captureCommandBuffer = VK_NULL_HANDLE;
+
+		if (_capture.callback) {
+			prepareCapture(frame);
+
+			if (isHeadless()) {
+				captureCommandBuffer = _capture.commandBuffers[frame];
+			}
+		}
+
+		submitComputeFrame(frame, captureCommandBuffer);
+
+		if (isHeadless()) {
+			recordFrameTimes(frameStart);
+
+			return;
+		}
+
+		recordDrawCommandBuffer(frame, imageIndex);
+
+		VkSemaphore waitSemaphores[] = { _sync.computeComplete[frame], _sync.presentComplete[frame] };
+		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pWaitDstStageMask = waitStages;
+		submitInfo.waitSemaphoreCount = 2;
+		submitInfo.pWaitSemaphores = waitSemaphores;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &_sync.renderComplete[imageIndex];
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &_graphics.drawCommandBuffers[frame];
+
+		if (vkQueueSubmit(_graphics.queue, 1, &submitInfo, _sync.frameComplete[frame]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit the render job");
+		}
+
+		VkPresentInfoKHR presentInfo{};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.pNext = NULL;
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = &_swapChain.swapChain;
+		presentInfo.pImageIndices = &imageIndex;
+		presentInfo.pWaitSemaphores = &_sync.renderComplete[imageIndex];
+		presentInfo.waitSemaphoreCount = 1;
+
+		VkResult presentResult = vkQueuePresentKHR(_graphics.queue, &presentInfo);
+
+		// Some platforms never report a resized window as out of date, the size of the frame buffer is checked too.
+		// The swap chain is recreated by the next call.
+		int frameBufferWidth, frameBufferHeight;
+		_surfaceProvider->getFrameBufferSize(&frameBufferWidth, &frameBufferHeight);
+
+		if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) {
+			_swapChain.isOutdated = true;
+		} else if (presentResult != VK_SUCCESS) {
+			throw std::runtime_error("Failed to present the frame");
+		}
+
+		if (frameBufferWidth != _swapChain.frameBufferWidth || frameBufferHeight != _swapChain.frameBufferHeight) {
+			_swapChain.isOutdated = true;
+		}
+
+		recordFrameTimes(frameStart);
+	}
+
+	// The copies submitted on the transfer queue since the last frame are waited for on the GPU, their ownership
+	// is acquired first, then the object updates run right before the pre-recorded dispatch. The readback, when
+	// given, runs after it in the same submission.
+	void RayTracer::submitComputeFrame(uint32_t frameIndex, VkCommandBuffer readbackCommandBuffer) {
+		bool hasTransfers = _transfer.submittedValue > _transfer.acquiredValue;
+		bool hasAcquires = !_transfer.bufferAcquires.empty() || !_transfer.imageAcquires.empty();
+		bool hasUploads = !_upload.sphereRegions.empty() || !_upload.planeRegions.empty() || !_upload.materialRegions.empty();
+
+		std::vector<VkCommandBuffer> computeCommandBuffers;
+
+		if (hasAcquires) {
+			recordAcquireCommandBuffer(frameIndex);
+			computeCommandBuffers.push_back(_transfer.acquireCommandBuffers[frameIndex]);
+		}
+
+		if (hasUploads) {
+			recordUploadCommandBuffer(frameIndex);
+			computeCommandBuffers.push_back(_upload.commandBuffers[frameIndex]);
+		}
+
+		computeCommandBuffers.push_back(_compute.commandBuffers[frameIndex]);
+
+		if (readbackCommandBuffer != VK_NULL_HANDLE) {
+			computeCommandBuffers.push_back(readbackCommandBuffer);
+		}
+
+		VkPipelineStageFlags transferWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineSubmitInfo.waitSemaphoreValueCount = 1;
+		timelineSubmitInfo.pWaitSemaphoreValues = &_transfer.submittedValue;
+
+		VkSubmitInfo computeSubmitInfo{};
+		computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		computeSubmitInfo.commandBufferCount = static_cast<uint32_t>(computeCommandBuffers.size());
+		computeSubmitInfo.pCommandBuffers = computeCommandBuffers.data();
+
+		if (hasTransfers) {
+			computeSubmitInfo.pNext = &timelineSubmitInfo;
+			computeSubmitInfo.waitSemaphoreCount = 1;
+			computeSubmitInfo.pWaitSemaphores = &_transfer.timeline;
+			computeSubmitInfo.pWaitDstStageMask = &transferWaitStage;
+		}
+
+		if (!isHeadless()) {
+			computeSubmitInfo.signalSemaphoreCount = 1;
+			computeSubmitInfo.pSignalSemaphores = &_sync.computeComplete[frameIndex];
+		}
+
+		if (vkQueueSubmit(_compute.queue, 1, &computeSubmitInfo, isHeadless() ? _sync.frameComplete[frameIndex] : VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit the compute job");
+		}
+
+		_lastSubmittedFrame = frameIndex;
+		_currentFrame = (_currentFrame + 1) % _options.framesInFlight;
+
+		if (_startup.statistics.firstFrame == 0.0) {
+			_startup.statistics.firstFrame = getStartupTime();
+		}
+
+		_transfer.acquiredValue = _transfer.submittedValue;
+		_transfer.bufferAcquires.clear();
+		_transfer.imageAcquires.clear();
+		collectUploads();
+
+		_upload.sphereRegions.clear();
+		_upload.planeRegions.clear();
+		_upload.materialRegions.clear();
+		_upload.segmentUsed = 0;
+		_upload.segmentAcquired = false;
+
+		if (_timestamps.enabled) {
+			_timestamps.written[frameIndex] = true;
+		}
+	}
+
+	void RayTracer::updateSettings(Settings& settings) {
+		// Copied into the buffer of the next frame once its slot is free, so frames in flight keep their own values
+		_scene.settings = settings;
+	}
+
+	void RayTracer::updateSpheres(uint32_t first, const Sphere* spheres, uint32_t count) {
+		checkSpheres(first, spheres, count);
+
+		VkDeviceSize size = static_cast<VkDeviceSize>(count) * sizeof(Sphere);
+		memcpy(reserveUpload(_upload.sphereRegions, static_cast<VkDeviceSize>(first) * sizeof(Sphere), size), spheres, static_cast<size_t>(size));
+
+		// The history was traced with the previous objects, blending into it would leave ghosts behind
+		resetAccumulation();
+	}
+
+	void RayTracer::updatePlanes(uint32_t first, const Plane* planes, uint32_t count) {
+		checkPlanes(first, planes, count);
+
+		VkDeviceSize size = static_cast<VkDeviceSize>(count) * sizeof(Plane);
+		memcpy(reserveUpload(_upload.planeRegions, static_cast<VkDeviceSize>(first) * sizeof(Plane), size), planes, static_cast<size_t>(size));
+
+		resetAccumulation();
+	}
+
+	void RayTracer::updateMaterials(uint32_t first, const Material* materials, uint32_t count) {
+		checkMaterials(first, count);
+
+		VkDeviceSize size = static_cast<VkDeviceSize>(count) * sizeof(Material);
+		memcpy(reserveUpload(_upload.materialRegions, static_cast<VkDeviceSize>(first) * sizeof(Material), size), materials, static_cast<size_t>(size));
+
+		resetAccumulation();
+	}
+
+	RayTracer::UploadHandle RayTracer::uploadSpheres(uint32_t first, const Sphere* spheres, uint32_t count) {
+		checkSpheres(first, spheres, count);
+
+		return streamBuffer(_scene.sphereBuffer, static_cast<VkDeviceSize>(first) * sizeof(Sphere), spheres, static_cast<VkDeviceSize>(count) * sizeof(Sphere));
+	}
+
+	RayTracer::UploadHandle RayTracer::uploadPlanes(uint32_t first, const Plane* planes, uint32_t count) {
+		checkPlanes(first, planes, count);
+
+		return streamBuffer(_scene.planeBuffer, static_cast<VkDeviceSize>(first) * sizeof(Plane), planes, static_cast<VkDeviceSize>(count) * sizeof(Plane));
+	}
+
+	RayTracer::UploadHandle RayTracer::uploadMaterials(uint32_t first, const Material* materials, uint32_t count) {
+		checkMaterials(first, count);
+
+		return streamBuffer(_scene.materialBuffer, static_cast<VkDeviceSize>(first) * sizeof(Material), materials, static_cast<VkDeviceSize>(count) * sizeof(Material));
+	}
+
+	void RayTracer::checkSpheres(uint32_t first, const Sphere* spheres, uint32_t count) const {
+		if (first > _scene.sphereCount || count > _scene.sphereCount - first) {
+			throw std::runtime_error("The updated spheres are out of the scene");
+		}
+
+		for (uint32_t index = 0; index < count; index++) {
+			if (spheres[index].material >= _scene.materialCount) {
+				throw std::runtime_error("An updated sphere references a missing material");
+			}
+		}
+	}
+
+	void RayTracer::checkPlanes(uint32_t first, const Plane* planes, uint32_t count) const {
+		if (first > _scene.planeCount || count > _scene.planeCount - first) {
+			throw std::runtime_error("The updated planes are out of the scene");
+		}
+
+		for (uint32_t index = 0; index < count; index++) {
+			if (planes[index].material >= _scene.materialCount) {
+				throw std::runtime_error("An updated plane references a missing material");
+			}
+		}
+	}
+
+	void RayTracer::checkMaterials(uint32_t first, uint32_t count) const {
+		if (first > _scene.materialCount || count > _scene.materialCount - first) {
+			throw std::runtime_error("The updated materials are out of the scene");
+		}
+	}
+
+	void* RayTracer::reserveUpload(std::vector<VkBufferCopy>& regions, VkDeviceSize offset, VkDeviceSize size) {
+		// The segment of the next frame may still be read by the copies of its previous use. drawFrame waits for
+		// the same fence anyway, so waiting here only moves the wait earlier.
+		if (!_upload.segmentAcquired) {
+			vkWaitForFences(_logicalDevice, 1, &_sync.frameComplete[_currentFrame], VK_TRUE, UINT64_MAX);
+			_upload.segmentAcquired = true;
+		}
+
+		if (size > _upload.segmentSize - _upload.segmentUsed) {
+			throw std::runtime_error("The upload ring is full, increase Options::uploadRingSize");
+		}
+
+		VkDeviceSize sourceOffset = _currentFrame * _upload.segmentSize + _upload.segmentUsed;
+		_upload.segmentUsed += size;
+
+		// Consecutive updates of consecutive objects are merged into a single region
+		if (!regions.empty() && regions.back().srcOffset + regions.back().size == sourceOffset && regions.back().dstOffset + regions.back().size == offset) {
+			regions.back().size += size;
+		} else {
+			VkBufferCopy region{};
+			region.srcOffset = sourceOffset;
+			region.dstOffset = offset;
+			region.size = size;
+
+			regions.push_back(region);
+		}
+
+		return _upload.handle + sourceOffset;
+	}
+
+	void RayTracer::setAccumulationEnabled(bool enabled) {
+		_accumulation.enabled = enabled;
+		_accumulation.frameCount = 0;
+	}
+
+	void RayTracer::resetAccumulation() {
+		_accumulation.frameCount = 0;
+	}
+
+	void RayTracer::updateAccumulation() {
+		Settings& settings = _scene.settings;
+		const Settings& lastSettings = _accumulation.lastSettings;
+
+		bool unchanged = settings.projection == lastSettings.projection && settings.transform == lastSettings.transform
+			&& settings.directionalLight == lastSettings.directionalLight && settings.angle == lastSettings.angle && settings.useBvh == lastSettings.useBvh;
+
+		if (!_accumulation.enabled || !unchanged) {
+			_accumulation.frameCount = 0;
+		}
+
+		// Frame 0 overwrites the accumulation image, the following ones blend into it with a decreasing weight
+		settings.frameIndex = _accumulation.frameCount;
+		_accumulation.lastSettings = settings;
+
+		if (_accumulation.enabled && _accumulation.frameCount < MAX_ACCUMULATED_FRAMES) {
+			_accumulation.frameCount++;
+		}
+	}
+
+	FrameStatistics RayTracer::getFrameStatistics() const {
+		FrameStatistics statistics{};
+		statistics.computeTime = _statistics.computeTime.getSummary();
+		statistics.renderTime = _statistics.renderTime.getSummary();
+		statistics.submitTime = _statistics.submitTime.getSummary();
+		statistics.presentInterval = _statistics.presentInterval.getSummary();
+
+		return statistics;
+	}
+
+	void RayTracer::readFrame(std::vector<uint8_t>& pixels) {
+		if (!isHeadless()) {
+			throw std::runtime_error("Frames can only be read back in headless mode");
+		}
+
+		uint32_t frame = _lastSubmittedFrame;
+		vkWaitForFences(_logicalDevice, 1, &_sync.frameComplete[frame], VK_TRUE, UINT64_MAX);
+
+		VkCommandBuffer copyCommandBuffer;
+		createCommandBuffers(_compute.commandPool, &copyCommandBuffer);
+
+		recordReadback(copyCommandBuffer, frame, _readback.buffer, _targetTexture.extent);
+		submitCommandBuffers(_compute.commandPool, _compute.queue, &copyCommandBuffer);
+
+		size_t size = static_cast<size_t>(_targetTexture.extent.width) * _targetTexture.extent.height * 4;
+
+		pixels.resize(size);
+		memcpy(pixels.data(), _readback.handle, size);
+	}
+
+	void RayTracer::setFrameCapture(std::function<void(const CapturedFrame&)> callback) {
+		flushCapture();
+
+		if (callback && !_capture.callback) {
+			_capture.frameCount = 0;
+		}
+
+		_capture.callback = std::move(callback);
+
+		if (!_capture.callback || !_capture.buffers.empty()) {
+			return;
+		}
+
+		uint32_t frameCount = _options.framesInFlight;
+
+		_capture.buffers.assign(frameCount, VK_NULL_HANDLE);
+		_capture.memories.resize(frameCount);
+		_capture.sizes.assign(frameCount, 0);
+		_capture.extents.assign(frameCount, VkExtent2D{ 0, 0 });
+		_capture.frameIndices.assign(frameCount, 0);
+
+		if (isHeadless()) {
+			_capture.commandBuffers.resize(frameCount);
+
+			VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+			commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			commandBufferAllocateInfo.commandPool = _compute.commandPool;
+			commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			commandBufferAllocateInfo.commandBufferCount = frameCount;
+
+			if (vkAllocateCommandBuffers(_logicalDevice, &commandBufferAllocateInfo, _capture.commandBuffers.data()) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate the capture command buffers");
+			}
+		}
+	}
+
+	// The slots are waited on in the order they were submitted from, so the frames come out in order
+	void RayTracer::flushCapture() {
+		uint32_t frameCount = static_cast<uint32_t>(_capture.buffers.size());
+
+		for (uint32_t index = 0; index < frameCount; index++) {
+			uint32_t frame = (_currentFrame + index) % frameCount;
+
+			if (_capture.extents[frame].width > 0) {
+				vkWaitForFences(_logicalDevice, 1, &_sync.frameComplete[frame], VK_TRUE, UINT64_MAX);
+				deliverCapture(frame);
+			}
+		}
+	}
+
+	// Called with the fence of the slot signaled, the buffer is read in place and reused by the next frame
+	void RayTracer::deliverCapture(uint32_t frameIndex) {
+		if (_capture.buffers.empty() || _capture.extents[frameIndex].width == 0) {
+			return;
+		}
+
+		CapturedFrame capturedFrame{};
+		capturedFrame.index = _capture.frameIndices[frameIndex];
+		capturedFrame.width = _capture.extents[frameIndex].width;
+		capturedFrame.height = _capture.extents[frameIndex].height;
+		capturedFrame.pixels = static_cast<const uint8_t*>(_capture.memories[frameIndex].handle);
+
+		_capture.extents[frameIndex] = { 0, 0 };
+
+		if (_capture.callback) {
+			_capture.callback(capturedFrame);
+		}
+	}
+
+	// Sized for the whole target texture, so a change of the render scale does not reallocate the buffer. The host
+	// reads the pixels back, cached memory makes that much faster on the devices which have some.
+	void RayTracer::prepareCapture(uint32_t frameIndex) {
+		VkDeviceSize size = static_cast<VkDeviceSize>(_targetTexture.extent.width) * _targetTexture.extent.height * 4;
+
+		if (_capture.sizes[frameIndex] < size) {
+			if (_capture.buffers[frameIndex] != VK_NULL_HANDLE) {
+				_allocator.free(_capture.memories[frameIndex]);
+				vkDestroyBuffer(_logicalDevice, _capture.buffers[frameIndex], nullptr);
+			}
+
+			VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+			if (_allocator.hasMemoryType(properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+				properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+			}
+
+			createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, size, _capture.buffers[frameIndex], _capture.memories[frameIndex]);
+			_capture.sizes[frameIndex] = size;
+		}
+
+		_capture.extents[frameIndex] = _resolution.frameExtents[frameIndex];
+		_capture.frameIndices[frameIndex] = _capture.frameCount++;
+
+		if (!isHeadless()) {
+			return;
+		}
+
+		VkCommandBuffer commandBuffer = _capture.commandBuffers[frameIndex];
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		VkCommandBufferBeginInfo commandBufferBeginInfo{};
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+		if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin the recording of the capture command buffer");
+		}
+
+		recordReadback(commandBuffer, frameIndex, _capture.buffers[frameIndex], _capture.extents[frameIndex]);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to end the recording of the capture command buffer");
+		}
 	}
 
-	RayTracer::~RayTracer() {
-		vkDeviceWaitIdle(_logicalDevice);
+	// Every pass of a tile is traced from a frame slot, as drawFrame would, with the tile in the top left corner of
+	// the target texture. The last pass also copies the tile to the readback buffer of the slot, which is handed to
+	// the callback once the fence of the slot is waited on, either to reuse it or at the end.
+	void RayTracer::renderTiled(const TiledRenderOptions& tiledOptions, const std::function<void(const RenderedTile&)>& onTile) {
+		if (!isHeadless()) {
+			throw std::runtime_error("Tiled renders are only available in headless mode");
+		}
+
+		// The tiles reuse the slots, the frames captured from them are handed out first
+		flushCapture();
+
+		if (tiledOptions.width == 0 || tiledOptions.height == 0 || tiledOptions.tileSize == 0 || tiledOptions.passCount == 0) {
+			throw std::runtime_error("A tiled render needs a frame, tiles and passes");
+		}
+
+		VkRect2D frameRegion = tiledOptions.region;
+
+		if (frameRegion.extent.width == 0 || frameRegion.extent.height == 0) {
+			frameRegion = { { 0, 0 }, { tiledOptions.width, tiledOptions.height } };
+		}
+
+		uint32_t regionX = static_cast<uint32_t>(frameRegion.offset.x);
+		uint32_t regionY = static_cast<uint32_t>(frameRegion.offset.y);
+
+		if (frameRegion.offset.x < 0 || frameRegion.offset.y < 0
+			|| regionX + frameRegion.extent.width > tiledOptions.width || regionY + frameRegion.extent.height > tiledOptions.height) {
+			throw std::runtime_error("The region of a tiled render has to lie within its frame");
+		}
+
+		uint32_t regionEndX = regionX + frameRegion.extent.width;
+		uint32_t regionEndY = regionY + frameRegion.extent.height;
+
+		VkExtent2D tileExtent = {
+			std::min(tiledOptions.tileSize, _targetTexture.extent.width),
+			std::min(tiledOptions.tileSize, _targetTexture.extent.height)
+		};
+
+		uint32_t frameCount = _options.framesInFlight;
+		VkDeviceSize readbackSize = static_cast<VkDeviceSize>(tileExtent.width) * tileExtent.height * 4;
+
+		std::vector<VkBuffer> readbackBuffers(frameCount);
+		std::vector<Allocation> readbackMemories(frameCount);
+		std::vector<VkCommandBuffer> readbackCommandBuffers(frameCount);
+
+		for (uint32_t frame = 0; frame < frameCount; frame++) {
+			createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackSize, readbackBuffers[frame], readbackMemories[frame]);
+		}
+
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferAllocateInfo.commandPool = _compute.commandPool;
+		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferAllocateInfo.commandBufferCount = frameCount;
+
+		if (vkAllocateCommandBuffers(_logicalDevice, &commandBufferAllocateInfo, readbackCommandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate the tile readback command buffers");
+		}
+
+		// Tile whose last pass was submitted from each slot, a zero width when there is none
+		std::vector<RenderedTile> pendingTiles(frameCount, RenderedTile{ 0, 0, 0, 0, nullptr });
+
+		auto waitForFrame = [&](uint32_t frame) {
+			vkWaitForFences(_logicalDevice, 1, &_sync.frameComplete[frame], VK_TRUE, UINT64_MAX);
+
+			if (pendingTiles[frame].width > 0) {
+				onTile(pendingTiles[frame]);
+				pendingTiles[frame].width = 0;
+			}
+		};
+
+		Settings settings = _scene.settings;
+
+		for (uint32_t y = regionY; y < regionEndY; y += tileExtent.height) {
+			for (uint32_t x = regionX; x < regionEndX; x += tileExtent.width) {
+				TraceRegion region{};
+				region.extent = { std::min(tileExtent.width, regionEndX - x), std::min(tileExtent.height, regionEndY - y) };
+				region.offset = { static_cast<int32_t>(x), static_cast<int32_t>(y) };
+				region.frameExtent = { tiledOptions.width, tiledOptions.height };
+
+				for (uint32_t pass = 0; pass < tiledOptions.passCount; pass++) {
+					uint32_t frame = _currentFrame;
+
+					waitForFrame(frame);
+					vkResetFences(_logicalDevice, 1, &_sync.frameComplete[frame]);
+					readTimestamps(frame);
+
+					recordComputeCommandBuffer(frame, region);
+
+					// Frame 0 overwrites the accumulation image, as for the frames drawn
+					settings.frameIndex = std::min(pass, MAX_ACCUMULATED_FRAMES);
+					memcpy(_scene.settingHandles[frame], &settings, sizeof(Settings));
+
+					VkCommandBuffer readbackCommandBuffer = VK_NULL_HANDLE;
+
+					if (pass + 1 == tiledOptions.passCount) {
+						readbackCommandBuffer = readbackCommandBuffers[frame];
+						vkResetCommandBuffer(readbackCommandBuffer, 0);
+
+						VkCommandBufferBeginInfo commandBufferBeginInfo{};
+						commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+						if (vkBeginCommandBuffer(readbackCommandBuffer, &commandBufferBeginInfo) != VK_SUCCESS) {
+							throw std::runtime_error("Failed to begin the recording of the tile readback command buffer");
+						}
+
+						recordReadback(readbackCommandBuffer, frame, readbackBuffers[frame], region.extent);
+
+						if (vkEndCommandBuffer(readbackCommandBuffer) != VK_SUCCESS) {
+							throw std::runtime_error("Failed to end the recording of the tile readback command buffer");
+						}
+
+						pendingTiles[frame] = { x, y, region.extent.width, region.extent.height, static_cast<const uint8_t*>(readbackMemories[frame].handle) };
+					}
+
+					submitComputeFrame(frame, readbackCommandBuffer);
+				}
+			}
+		}
+
+		// The slots are waited on in the order they were submitted from, so the last tiles come out in order too
+		for (uint32_t index = 0; index < frameCount; index++) {
+			waitForFrame((_currentFrame + index) % frameCount);
+		}
+
+		vkFreeCommandBuffers(_logicalDevice, _compute.commandPool, frameCount, readbackCommandBuffers.data());
+
+		for (uint32_t frame = 0; frame < frameCount; frame++) {
+			_allocator.free(readbackMemories[frame]);
+			vkDestroyBuffer(_logicalDevice, readbackBuffers[frame], nullptr);
+		}
+
+		// The frame command buffers now trace tiles, and the accumulation image holds the last one
+		std::fill(_resolution.frameExtents.begin(), _resolution.frameExtents.end(), VkExtent2D{ 0, 0 });
+		resetAccumulation();
+	}
+
+	// The shapes are dispatched in turn for every round, so clock changes affect them alike. Barriers separate
+	// the dispatches, the timestamps written at the compute stage around one of them only cover its execution.
+	std::vector<WorkgroupTiming> RayTracer::tuneWorkgroupSize() {
+		if (!_timestamps.enabled) {
+			throw std::runtime_error("The device cannot time the dispatches");
+		}
+
+		if (_options.wavefront) {
+			throw std::runtime_error("Only the workgroup size of the megakernel can be tuned");
+		}
+
+		vkDeviceWaitIdle(_logicalDevice);
+
+		std::vector<VkExtent2D> candidates;
+
+		for (VkExtent2D workgroupSize : WORKGROUP_SIZE_CANDIDATES) {
+			if (isWorkgroupSizeSupported(workgroupSize)) {
+				candidates.push_back(workgroupSize);
+			}
+		}
+
+		if (candidates.empty()) {
+			throw std::runtime_error("The device supports none of the candidate workgroup sizes");
+		}
+
+		VkShaderModule shaderCompute{};
+		loadShaderModule(SHADER_COMPUTE_PATH, shaderCompute);
+
+		std::vector<VkPipeline> pipelines(candidates.size());
+
+		for (size_t index = 0; index < candidates.size(); index++) {
+			createRayTracingPipeline(shaderCompute, candidates[index], pipelines[index]);
+		}
+
+		vkDestroyShaderModule(_logicalDevice, shaderCompute, nullptr);
+
+		uint32_t queryCount = static_cast<uint32_t>(candidates.size()) * WORKGROUP_TUNING_ROUNDS * 2;
+
+		VkQueryPoolCreateInfo queryPoolCreateInfo{};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = queryCount;
+
+		VkQueryPool queryPool;
+
+		if (vkCreateQueryPool(_logicalDevice, &queryPoolCreateInfo, nullptr, &queryPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create the tuning query pool");
+		}
+
+		// The device is idle, so the first frame slot is free. Its frame is traced from scratch.
+		Settings settings = _scene.settings;
+		settings.frameIndex = 0;
+		memcpy(_scene.settingHandles[0], &settings, sizeof(Settings));
 
-		vkDestroyFence(_logicalDevice, _sync.computeComplete, nullptr);
-		vkDestroySemaphore(_logicalDevice, _sync.presentComplete, nullptr);
-		vkDestroySemaphore(_logicalDevice, _sync.renderComplete, nullptr);
+		// The uploads no frame has waited for yet, and the object updates queued for the next frame, are applied
+		// before the timed dispatches as drawFrame would, so the shapes are timed on the current scene. The command
+		// buffers of the current slot are free, the device is idle.
+		bool hasTransfers = _transfer.submittedValue > _transfer.acquiredValue;
+		std::vector<VkCommandBuffer> commandBuffers;
 
-		vkDestroyPipeline(_logicalDevice, _compute.pipeline, nullptr);
-		vkDestroyPipelineLayout(_logicalDevice, _compute.pipelineLayout, nullptr);
-		vkDestroyPipeline(_logicalDevice, _graphics.pipeline, nullptr);
-		vkDestroyPipelineLayout(_logicalDevice, _graphics.pipelineLayout, nullptr);
+		if (!_transfer.bufferAcquires.empty() || !_transfer.imageAcquires.empty()) {
+			recordAcquireCommandBuffer(_currentFrame);
+			commandBuffers.push_back(_transfer.acquireCommandBuffers[_currentFrame]);
+		}
 
-		vkFreeMemory(_logicalDevice, _scene.planeMemory, nullptr);
-		vkDestroyBuffer(_logicalDevice, _scene.planeBuffer, nullptr);
-		vkFreeMemory(_logicalDevice, _scene.sphereMemory, nullptr);
-		vkDestroyBuffer(_logicalDevice, _scene.sphereBuffer, nullptr);
-		vkUnmapMemory(_logicalDevice, _scene.settingMemory);
-		vkFreeMemory(_logicalDevice, _scene.settingMemory, nullptr);
-		vkDestroyBuffer(_logicalDevice, _scene.settingBuffer, nullptr);
+		if (!_upload.sphereRegions.empty() || !_upload.planeRegions.empty() || !_upload.materialRegions.empty()) {
+			recordUploadCommandBuffer(_currentFrame);
+			commandBuffers.push_back(_upload.commandBuffers[_currentFrame]);
+		}
 
-		vkDestroyImageView(_logicalDevice, _skyBox.imageView, nullptr);
-		vkDestroyImage(_logicalDevice, _skyBox.image, nullptr);
-		vkFreeMemory(_logicalDevice, _skyBox.imageDeviceMemory, nullptr);
+		VkCommandBuffer commandBuffer;
+		createCommandBuffers(_compute.commandPool, &commandBuffer);
+		commandBuffers.push_back(commandBuffer);
 
-		vkDestroyImageView(_logicalDevice, _targetTexture.imageView, nullptr);
-		vkDestroyImage(_logicalDevice, _targetTexture.image, nullptr);
-		vkFreeMemory(_logicalDevice, _targetTexture.imageDeviceMemory, nullptr);
+		vkCmdResetQueryPool(commandBuffer, queryPool, 0, queryCount);
 
-		vkDestroySampler(_logicalDevice, _sampler, nullptr);
+		ComputePushConstants pushConstants{ _resolution.extent, 0, 0, { 0, 0 }, _resolution.extent };
 
-		vkDestroyDescriptorSetLayout(_logicalDevice, _compute.descriptorSetLayout, nullptr);
-		vkDestroyDescriptorSetLayout(_logicalDevice, _graphics.descriptorSetLayout, nullptr);
-		vkDestroyDescriptorPool(_logicalDevice, _descriptorPool, nullptr);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _compute.pipelineLayout, 0, 1, &_compute.descriptorSets[0], 0, 0);
+		vkCmdPushConstants(commandBuffer, _compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pushConstants);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _compute.animationPipeline);
+		vkCmdDispatch(commandBuffer, (_scene.sphereCount + ANIMATION_WORKGROUP_SIZE - 1) / ANIMATION_WORKGROUP_SIZE, 1, 1);
 
-		for (auto frameBuffer : _swapChain.frameBuffers) {
-			vkDestroyFramebuffer(_logicalDevice, frameBuffer, nullptr);
-		}
+		VkMemoryBarrier memoryBarrier{};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-		vkDestroyRenderPass(_logicalDevice, _swapChain.renderPass, nullptr);
+		for (uint32_t round = 0; round < WORKGROUP_TUNING_ROUNDS; round++) {
+			for (uint32_t index = 0; index < static_cast<uint32_t>(candidates.size()); index++) {
+				uint32_t query = (round * static_cast<uint32_t>(candidates.size()) + index) * 2;
 
-		for (auto imageView : _swapChain.imageViews) {
-			vkDestroyImageView(_logicalDevice, imageView, nullptr);
-		}
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, query);
 
-		vkDestroySwapchainKHR(_logicalDevice, _swapChain.swapChain, nullptr);
-		vkDestroyCommandPool(_logicalDevice, _graphics.commandPool, nullptr);
-		vkDestroyCommandPool(_logicalDevice, _compute.commandPool, nullptr);
-		vkDestroyDevice(_logicalDevice, nullptr);
-		vkDestroySurfaceKHR(_instance, _surface, nullptr);
-		vkDestroyInstance(_instance, nullptr);
-	}
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[index]);
+				vkCmdDispatch(commandBuffer,
+					(_resolution.extent.width + candidates[index].width - 1) / candidates[index].width,
+					(_resolution.extent.height + candidates[index].height - 1) / candidates[index].height, 1);
 
-	void RayTracer::drawFrame() {
-		VkSubmitInfo computeSubmitInfo{};
-		computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		computeSubmitInfo.commandBufferCount = 1;
-		computeSubmitInfo.pCommandBuffers = &_compute.commandBuffer;
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, query + 1);
+			}
+		}
 
-		if (vkQueueSubmit(_compute.queue, 1, &computeSubmitInfo, _sync.computeComplete) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to submit the compute job");
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record the tuning command buffer");
 		}
 
-		vkWaitForFences(_logicalDevice, 1, &_sync.computeComplete, VK_TRUE, UINT64_MAX);
-		vkResetFences(_logicalDevice, 1, &_sync.computeComplete);
+		VkPipelineStageFlags transferWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
-		uint32_t imageIndex;
-		vkAcquireNextImageKHR(_logicalDevice, _swapChain.swapChain, UINT64_MAX, _sync.presentComplete, (VkFence) nullptr, &imageIndex);
+		VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineSubmitInfo.waitSemaphoreValueCount = 1;
+		timelineSubmitInfo.pWaitSemaphoreValues = &_transfer.submittedValue;
 
-		VkPipelineStageFlags waitStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.pWaitDstStageMask = &waitStages;
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = &_sync.presentComplete;
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &_sync.renderComplete;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &_graphics.drawCommandBuffers[imageIndex];
+		submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+		submitInfo.pCommandBuffers = commandBuffers.data();
+
+		if (hasTransfers) {
+			submitInfo.pNext = &timelineSubmitInfo;
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &_transfer.timeline;
+			submitInfo.pWaitDstStageMask = &transferWaitStage;
+		}
 
-		if (vkQueueSubmit(_graphics.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to submit the render job");
+		if (vkQueueSubmit(_compute.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit the tuning dispatches");
 		}
 
-		VkPresentInfoKHR presentInfo{};
-		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-		presentInfo.pNext = NULL;
-		presentInfo.swapchainCount = 1;
-		presentInfo.pSwapchains = &_swapChain.swapChain;
-		presentInfo.pImageIndices = &imageIndex;
-		presentInfo.pWaitSemaphores = &_sync.renderComplete;
-		presentInfo.waitSemaphoreCount = 1;
+		vkQueueWaitIdle(_compute.queue);
+		vkFreeCommandBuffers(_logicalDevice, _compute.commandPool, 1, &commandBuffer);
+
+		_transfer.acquiredValue = _transfer.submittedValue;
+		_transfer.bufferAcquires.clear();
+		_transfer.imageAcquires.clear();
+		collectUploads();
+
+		// The segment of the current slot was consumed by the submission, which completed
+		_upload.sphereRegions.clear();
+		_upload.planeRegions.clear();
+		_upload.materialRegions.clear();
+		_upload.segmentUsed = 0;
+		_upload.segmentAcquired = false;
 
-		vkQueuePresentKHR(_graphics.queue, &presentInfo);
+		std::vector<uint64_t> timestamps(queryCount);
 
-		if (vkQueueWaitIdle(_graphics.queue) != VK_SUCCESS) {
-			throw std::runtime_error("Render job failed");
+		if (vkGetQueryPoolResults(_logicalDevice, queryPool, 0, queryCount, timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to read the tuning timestamps");
 		}
-	}
 
-	void RayTracer::updateSettings(Settings& settings) {
-		memcpy(_scene.settingHandle, &settings, sizeof(Settings));
+		vkDestroyQueryPool(_logicalDevice, queryPool, nullptr);
+
+		double millisecondsPerTick = _timestamps.period / 1e6;
+		std::vector<WorkgroupTiming> timings;
+		size_t fastest = 0;
+
+		for (size_t index = 0; index < candidates.size(); index++) {
+			std::vector<double> times;
+
+			for (uint32_t round = 0; round < WORKGROUP_TUNING_ROUNDS; round++) {
+				size_t query = (round * candidates.size() + index) * 2;
+				times.push_back(getElapsedTicks(timestamps[query], timestamps[query + 1], _timestamps.computeMask) * millisecondsPerTick);
+			}
+
+			std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+			timings.push_back({ candidates[index], times[times.size() / 2] });
+
+			if (timings[index].time < timings[fastest].time) {
+				fastest = index;
+			}
+		}
+
+		for (size_t index = 0; index < pipelines.size(); index++) {
+			if (index != fastest) {
+				vkDestroyPipeline(_logicalDevice, pipelines[index], nullptr);
+			}
+		}
+
+		// The frame command buffers bake the pipeline and the dispatch size, they are recorded again on their next use
+		vkDestroyPipeline(_logicalDevice, _compute.pipeline, nullptr);
+		_compute.pipeline = pipelines[fastest];
+		_compute.workgroupSize = candidates[fastest];
+
+		std::fill(_resolution.frameExtents.begin(), _resolution.frameExtents.end(), VkExtent2D{ 0, 0 });
+
+		savePipelineCache();
+		saveWorkgroupSize();
+		resetAccumulation();
+
+		return timings;
 	}
 
 	void RayTracer::createInstance() {
@@ -151,14 +1342,17 @@ namespace vrt {
 		applicationInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
 		applicationInfo.apiVersion = VK_API_VERSION_1_3;
 
-		uint32_t enabledExtensionCount;
-		const char** enabledExtensionNames = glfwGetRequiredInstanceExtensions(&enabledExtensionCount);
+		std::vector<const char*> enabledExtensionNames;
+
+		if (!isHeadless()) {
+			enabledExtensionNames = _surfaceProvider->getRequiredInstanceExtensions();
+		}
 
 		VkInstanceCreateInfo instanceCreateInfo{};
 		instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 		instanceCreateInfo.pApplicationInfo = &applicationInfo;
-		instanceCreateInfo.enabledExtensionCount = enabledExtensionCount;
-		instanceCreateInfo.ppEnabledExtensionNames = enabledExtensionNames;
+		instanceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensionNames.size());
+		instanceCreateInfo.ppEnabledExtensionNames = enabledExtensionNames.data();
 
 #ifndef NDEBUG
 		uint32_t availableLayerCount;
@@ -202,7 +1396,9 @@ namespace vrt {
 			throw std::runtime_error("Failed to create the Vulkan instance");
 		}
 
-		_window.createWindowSurface(_instance, &_surface);
+		if (!isHeadless()) {
+			_surfaceProvider->createWindowSurface(_instance, &_surface);
+		}
 	}
 
 	void RayTracer::createDevice() {
@@ -228,6 +1424,27 @@ namespace vrt {
 			throw std::runtime_error("Unable to find a device meeting the requirements");
 		}
 
+		VkPhysicalDeviceProperties physicalDeviceProperties;
+		vkGetPhysicalDeviceProperties(_physicalDevice, &physicalDeviceProperties);
+		strncpy(_deviceName, physicalDeviceProperties.deviceName, VK_MAX_PHYSICAL_DEVICE_NAME_SIZE);
+
+		// The wavefront kernels append to the queues with one atomic per subgroup
+		if (_options.wavefront) {
+			VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+			subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+			VkPhysicalDeviceProperties2 physicalDeviceProperties2{};
+			physicalDeviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			physicalDeviceProperties2.pNext = &subgroupProperties;
+			vkGetPhysicalDeviceProperties2(_physicalDevice, &physicalDeviceProperties2);
+
+			VkSubgroupFeatureFlags requiredOperations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+
+			if ((subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) == 0 || (subgroupProperties.supportedOperations & requiredOperations) != requiredOperations) {
+				throw std::runtime_error("The device does not support the subgroup ballots of the wavefront kernels");
+			}
+		}
+
 		uint32_t queueFamilyPropertyCount;
 		vkGetPhysicalDeviceQueueFamilyProperties(_physicalDevice, &queueFamilyPropertyCount, nullptr);
 
@@ -238,6 +1455,12 @@ namespace vrt {
 		getComputeQueueFamilyIndex(queueFamilyProperties, &_queueFamilyIndices.compute);
 		getTransferQueueFamilyIndex(queueFamilyProperties, &_queueFamilyIndices.transfer);
 
+		// Without presentation there is nothing for the compute work to overlap with, so everything
+		// runs on the graphics family, which also removes the need for queue family ownership transfers.
+		if (isHeadless()) {
+			_queueFamilyIndices.compute = _queueFamilyIndices.graphics;
+		}
+
 		std::vector<VkDeviceQueueCreateInfo> deviceQueueCreateInfo;
 		std::set<uint32_t> uniqueQueueFamilyIndices = {
 			_queueFamilyIndices.graphics,
@@ -257,12 +1480,32 @@ namespace vrt {
 			deviceQueueCreateInfo.push_back(queueCreateInfo);
 		}
 
+		std::vector<const char*> requiredExtensions = getRequiredDeviceExtensions();
+
 		VkPhysicalDeviceFeatures requiredFeatures{};
+
+		// The sky box stays compressed in memory when the device can filter BC1, saving bandwidth on every miss
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(_physicalDevice, &supportedFeatures);
+
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(_physicalDevice, VK_FORMAT_BC1_RGB_UNORM_BLOCK, &formatProperties);
+
+		VkFormatFeatureFlags requiredFormatFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+		_skyBox.isCompressed = supportedFeatures.textureCompressionBC == VK_TRUE && (formatProperties.optimalTilingFeatures & requiredFormatFeatures) == requiredFormatFeatures;
+		requiredFeatures.textureCompressionBC = _skyBox.isCompressed ? VK_TRUE : VK_FALSE;
+
+		// Orders the transfer queue uploads with the frames
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		vulkan12Features.timelineSemaphore = VK_TRUE;
+
 		VkDeviceCreateInfo deviceCreateInfo{};
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceCreateInfo.pNext = &vulkan12Features;
 		deviceCreateInfo.pEnabledFeatures = &requiredFeatures;
-		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(REQUIRED_EXTENSION_PROPERTIES.size());
-		deviceCreateInfo.ppEnabledExtensionNames = REQUIRED_EXTENSION_PROPERTIES.data();
+		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(requiredExtensions.size());
+		deviceCreateInfo.ppEnabledExtensionNames = requiredExtensions.data();
 		deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(deviceQueueCreateInfo.size());
 		deviceCreateInfo.pQueueCreateInfos = deviceQueueCreateInfo.data();
 
@@ -277,6 +1520,8 @@ namespace vrt {
 		if (vkCreateDevice(_physicalDevice, &deviceCreateInfo, nullptr, &_logicalDevice) != VK_SUCCESS) {
 			throw std::runtime_error("Unable to create the logical device");
 		}
+
+		_allocator.create(_physicalDevice, _logicalDevice);
 	}
 
 	void RayTracer::createCommandPools() {
@@ -302,7 +1547,92 @@ namespace vrt {
 		vkGetDeviceQueue(_logicalDevice, _queueFamilyIndices.compute, 0, &_compute.queue);
 	}
 
-	void RayTracer::createSwapChain() {
+	void RayTracer::createTransferResources() {
+		VkCommandPoolCreateInfo transferCommandPoolCreateInfo{};
+		transferCommandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		transferCommandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		transferCommandPoolCreateInfo.queueFamilyIndex = _queueFamilyIndices.transfer;
+
+		if (vkCreateCommandPool(_logicalDevice, &transferCommandPoolCreateInfo, nullptr, &_transfer.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create the transfer command pool");
+		}
+
+		vkGetDeviceQueue(_logicalDevice, _queueFamilyIndices.transfer, 0, &_transfer.queue);
+
+		VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo{};
+		semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		semaphoreTypeCreateInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreCreateInfo{};
+		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+
+		if (vkCreateSemaphore(_logicalDevice, &semaphoreCreateInfo, nullptr, &_transfer.timeline) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create the transfer timeline semaphore");
+		}
+
+		if (vkCreateSemaphore(_logicalDevice, &semaphoreCreateInfo, nullptr, &_transfer.handoverTimeline) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create the handover timeline semaphore");
+		}
+
+		_transfer.submittedValue = 0;
+		_transfer.acquiredValue = 0;
+		_transfer.handoverValue = 0;
+		createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, STAGING_ARENA_SIZE, _transfer.stagingBuffer, _transfer.stagingMemory);
+		_transfer.stagingHead = 0;
+
+		// Recorded by recordAcquireCommandBuffer on the frames which follow new uploads
+		_transfer.acquireCommandBuffers.resize(_options.framesInFlight);
+
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferAllocateInfo.commandPool = _compute.commandPool;
+		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferAllocateInfo.commandBufferCount = _options.framesInFlight;
+
+		if (vkAllocateCommandBuffers(_logicalDevice, &commandBufferAllocateInfo, _transfer.acquireCommandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate the acquire command buffers");
+		}
+	}
+
+	void RayTracer::createQueryPool() {
+		VkPhysicalDeviceProperties physicalDeviceProperties;
+		vkGetPhysicalDeviceProperties(_physicalDevice, &physicalDeviceProperties);
+
+		uint32_t queueFamilyPropertyCount;
+		vkGetPhysicalDeviceQueueFamilyProperties(_physicalDevice, &queueFamilyPropertyCount, nullptr);
+
+		std::vector<VkQueueFamilyProperties> queueFamilyProperties{ queueFamilyPropertyCount };
+		vkGetPhysicalDeviceQueueFamilyProperties(_physicalDevice, &queueFamilyPropertyCount, queueFamilyProperties.data());
+
+		// Timings are optional, devices which cannot write timestamps on both queues only report CPU times
+		_timestamps.period = physicalDeviceProperties.limits.timestampPeriod;
+		_timestamps.enabled = _timestamps.period > 0.0f &&
+			queueFamilyProperties[_queueFamilyIndices.graphics].timestampValidBits > 0 &&
+			queueFamilyProperties[_queueFamilyIndices.compute].timestampValidBits > 0;
+
+		_timestamps.graphicsMask = getTimestampMask(queueFamilyProperties[_queueFamilyIndices.graphics].timestampValidBits);
+		_timestamps.computeMask = getTimestampMask(queueFamilyProperties[_queueFamilyIndices.compute].timestampValidBits);
+
+		_timestamps.written.assign(_options.framesInFlight, false);
+		_statistics.hasPresented = false;
+
+		if (!_timestamps.enabled) {
+			return;
+		}
+
+		VkQueryPoolCreateInfo queryPoolCreateInfo{};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = TIMESTAMPS_PER_FRAME * _options.framesInFlight;
+
+		if (vkCreateQueryPool(_logicalDevice, &queryPoolCreateInfo, nullptr, &_timestamps.queryPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create the timestamp query pool");
+		}
+	}
+
+	void RayTracer::createSwapChain(VkSwapchainKHR oldSwapChain) {
 		auto surfaceFormat = selectSurfaceFormat();
 		auto presentMode = selectPresentMode();
 		auto surfaceCapabilities = getSurfaceCapabilities();
@@ -328,7 +1658,7 @@ namespace vrt {
 		swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		swapChainCreateInfo.presentMode = presentMode;
 		swapChainCreateInfo.clipped = VK_TRUE;
-		swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+		swapChainCreateInfo.oldSwapchain = oldSwapChain;
 
 		if (surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
 			swapChainCreateInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
@@ -343,9 +1673,14 @@ namespace vrt {
 		}
 
 		_swapChain.format = surfaceFormat.format;
+		_swapChain.isOutdated = false;
+		_surfaceProvider->getFrameBufferSize(&_swapChain.frameBufferWidth, &_swapChain.frameBufferHeight);
+
+		// The implementation may create more images than requested
+		vkGetSwapchainImagesKHR(_logicalDevice, _swapChain.swapChain, &_swapChain.imageCount, nullptr);
+
 		_swapChain.images.resize(_swapChain.imageCount);
 		_swapChain.imageViews.resize(_swapChain.imageCount);
-		_swapChain.frameBuffers.resize(_swapChain.imageCount);
 
 		vkGetSwapchainImagesKHR(_logicalDevice, _swapChain.swapChain, &_swapChain.imageCount, _swapChain.images.data());
 
@@ -370,7 +1705,10 @@ namespace vrt {
 				throw std::runtime_error("Failed to create the image view");
 			}
 		}
+	}
 
+	// Only depends on the format of the swap chain, which stays the same when it is recreated
+	void RayTracer::createRenderPass() {
 		VkAttachmentDescription colorAttachment{};
 		colorAttachment.format = _swapChain.format;
 		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -410,6 +1748,10 @@ namespace vrt {
 		if (vkCreateRenderPass(_logicalDevice, &renderPassInfo, nullptr, &_swapChain.renderPass) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create render pass!");
 		}
+	}
+
+	void RayTracer::createFrameBuffers() {
+		_swapChain.frameBuffers.resize(_swapChain.imageCount);
 
 		for (size_t i = 0; i < _swapChain.imageCount; i++) {
 			VkImageView attachments[] = { _swapChain.imageViews[i] };
@@ -429,24 +1771,141 @@ namespace vrt {
 		}
 	}
 
+	// The device is idled first, nothing the frames in flight use is destroyed under them. The target texture is only
+	// reallocated when its size changes, the compute command buffers are recorded again by their next frame.
+	bool RayTracer::recreateSwapChain() {
+		int width, height;
+		_surfaceProvider->getFrameBufferSize(&width, &height);
+
+		if (width == 0 || height == 0) {
+			return false;
+		}
+
+		vkDeviceWaitIdle(_logicalDevice);
+
+		VkSwapchainKHR oldSwapChain = _swapChain.swapChain;
+
+		destroySwapChainResources();
+		createSwapChain(oldSwapChain);
+		vkDestroySwapchainKHR(_logicalDevice, oldSwapChain, nullptr);
+		createFrameBuffers();
+
+		// The new swap chain may not have as many images
+		for (auto semaphore : _sync.renderComplete) {
+			vkDestroySemaphore(_logicalDevice, semaphore, nullptr);
+		}
+
+		createRenderSemaphores();
+
+		VkExtent2D targetExtent = getScaledExtent(_options.renderScale);
+
+		if (!isSameExtent(targetExtent, _targetTexture.extent)) {
+			destroyTargetTexture();
+
+			_targetTexture.extent = targetExtent;
+			createTargetTexture();
+			writeTargetDescriptorSets();
+			releaseTargetTexturesToCompute();
+
+			// The barriers of the command buffers name the previous images
+			std::fill(_resolution.frameExtents.begin(), _resolution.frameExtents.end(), VkExtent2D{ 0, 0 });
+		}
+
+		_resolution.extent = getScaledExtent(_resolution.scale);
+		resetAccumulation();
+
+		return true;
+	}
+
+	void RayTracer::destroySwapChainResources() {
+		for (auto frameBuffer : _swapChain.frameBuffers) {
+			vkDestroyFramebuffer(_logicalDevice, frameBuffer, nullptr);
+		}
+
+		for (auto imageView : _swapChain.imageViews) {
+			vkDestroyImageView(_logicalDevice, imageView, nullptr);
+		}
+	}
+
 	void RayTracer::createTargetTexture() {
-		createImageAndView(VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _targetTexture.image, _targetTexture.imageDeviceMemory, _targetTexture.imageView, _swapChain.extent.width, _swapChain.extent.height);
-		changeImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, _targetTexture.image);
-		
-		// TODO move?
+		// Copied by the readbacks when headless, and by the frame capture in both modes
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+		_targetTexture.images.resize(_options.framesInFlight);
+		_targetTexture.imageViews.resize(_options.framesInFlight);
+		_targetTexture.imageDeviceMemories.resize(_options.framesInFlight);
+
+		for (uint32_t frame = 0; frame < _options.framesInFlight; frame++) {
+			createImageAndView(usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, TARGET_TEXTURE_FORMAT, _targetTexture.images[frame], _targetTexture.imageDeviceMemories[frame], _targetTexture.imageViews[frame], _targetTexture.extent.width, _targetTexture.extent.height);
+			changeImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, _targetTexture.images[frame]);
+		}
+
+		// Only ever touched by the compute shader, which overwrites it on the first frame after a reset
+		createImageAndView(VK_IMAGE_USAGE_STORAGE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ACCUMULATION_TEXTURE_FORMAT, _accumulation.image, _accumulation.imageDeviceMemory, _accumulation.imageView, _targetTexture.extent.width, _targetTexture.extent.height);
+		changeImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, _accumulation.image);
+
+		if (_options.wavefront) {
+			createWavefrontBuffers();
+		}
+	}
+
+	void RayTracer::destroyTargetTexture() {
+		for (uint32_t frame = 0; frame < _options.framesInFlight; frame++) {
+			vkDestroyImageView(_logicalDevice, _targetTexture.imageViews[frame], nullptr);
+			vkDestroyImage(_logicalDevice, _targetTexture.images[frame], nullptr);
+			_allocator.free(_targetTexture.imageDeviceMemories[frame]);
+		}
+
+		vkDestroyImageView(_logicalDevice, _accumulation.imageView, nullptr);
+		vkDestroyImage(_logicalDevice, _accumulation.image, nullptr);
+		_allocator.free(_accumulation.imageDeviceMemory);
+
+		if (_options.wavefront) {
+			destroyWavefrontBuffers();
+		}
+	}
+
+	// A path per pixel of the target texture, the frames only use the part they trace
+	void RayTracer::createWavefrontBuffers() {
+		VkDeviceSize pathCount = static_cast<VkDeviceSize>(_targetTexture.extent.width) * _targetTexture.extent.height;
+		VkDeviceSize counterCount = 2 * _options.samplesPerPixel * _options.maxBounces;
+
+		createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pathCount * WAVEFRONT_PATH_SIZE, _wavefront.pathBuffer, _wavefront.pathMemory);
+		createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pathCount * WAVEFRONT_HIT_SIZE, _wavefront.hitBuffer, _wavefront.hitMemory);
+		createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pathCount * 3 * sizeof(uint32_t), _wavefront.queueBuffer, _wavefront.queueMemory);
+		createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pathCount * 4 * sizeof(float), _wavefront.radianceBuffer, _wavefront.radianceMemory);
+		createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, counterCount * sizeof(QueueCounter), _wavefront.counterBuffer, _wavefront.counterMemory);
+	}
+
+	void RayTracer::destroyWavefrontBuffers() {
+		vkDestroyBuffer(_logicalDevice, _wavefront.pathBuffer, nullptr);
+		_allocator.free(_wavefront.pathMemory);
+		vkDestroyBuffer(_logicalDevice, _wavefront.hitBuffer, nullptr);
+		_allocator.free(_wavefront.hitMemory);
+		vkDestroyBuffer(_logicalDevice, _wavefront.queueBuffer, nullptr);
+		_allocator.free(_wavefront.queueMemory);
+		vkDestroyBuffer(_logicalDevice, _wavefront.radianceBuffer, nullptr);
+		_allocator.free(_wavefront.radianceMemory);
+		vkDestroyBuffer(_logicalDevice, _wavefront.counterBuffer, nullptr);
+		_allocator.free(_wavefront.counterMemory);
+	}
+
+	// Shared by the sky box and the target textures
+	void RayTracer::createSampler() {
 		VkSamplerCreateInfo samplerCreateInfo{};
 		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
 		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
 		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+		// The upscaling filters read past the edges of the target texture, the border color would bleed in
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
 		samplerCreateInfo.mipLodBias = 0.0f;
 		samplerCreateInfo.maxAnisotropy = 1.0f;
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerCreateInfo.minLod = 0.0f;
-		samplerCreateInfo.maxLod = 0.0f;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 
 		if (vkCreateSampler(_logicalDevice, &samplerCreateInfo, nullptr, &_sampler) != VK_SUCCESS) {
@@ -454,134 +1913,210 @@ namespace vrt {
 		}
 	}
 
+	// The image comes from the cache or from the faces converted by the asset loading tasks, every mip level is
+	// copied from a single staging region. A freshly converted sky box is written to the cache once submitted.
 	void RayTracer::createSkyBox() {
-		int texWidth, texHeight, texChannels;
-		stbi_uc* layers[6];
-		for (size_t index = 0; index < 6; index++) {
-			layers[index] = stbi_load(SKY_BOX_TEXTURE_PATHS[index], &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		if (!_assets.isSkyBoxCached) {
+			for (size_t index = 0; index < 6; index++) {
+				if (_assets.skyBoxFaces[index].empty()) {
+					throw std::runtime_error("Failed to load the skybox texture image!");
+				}
+
+				if (_assets.skyBoxFaceSizes[index] != _assets.skyBoxFaceSizes[0]) {
+					throw std::runtime_error("The sky box faces do not have the same size");
+				}
+			}
+
+			_assets.skyBox = assembleSkyBox(SkyBoxFormat::Bc1, _assets.skyBoxFaceSizes[0], _assets.skyBoxFaces);
+
+			for (auto& face : _assets.skyBoxFaces) {
+				face.clear();
+			}
 		}
-		
-		if (!layers[0] || !layers[1] || !layers[2] || !layers[3] || !layers[4] || !layers[5]) {
-			throw std::runtime_error("Failed to load the skybox texture image!");
+
+		const SkyBoxImage* image = &_assets.skyBox;
+		SkyBoxImage decompressed;
+
+		if (image->format == SkyBoxFormat::Bc1 && !_skyBox.isCompressed) {
+			decompressed = decompressSkyBox(*image);
+			image = &decompressed;
 		}
 
-		VkDeviceSize imageSize = texWidth * texHeight * 4 * 6;
-		VkDeviceSize layerSize = texWidth * texHeight * 4;
+		VkFormat format = image->format == SkyBoxFormat::Bc1 ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_R8G8B8A8_UNORM;
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-		createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, imageSize, stagingBuffer, stagingMemory);
-		createCubeMap(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _skyBox.image, _skyBox.imageDeviceMemory, _skyBox.imageView, texWidth, texHeight);
-		changeImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, _skyBox.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, 6);
+		createCubeMap(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, format, _skyBox.image, _skyBox.imageDeviceMemory, _skyBox.imageView, image->size, image->mipLevelCount);
 
-		void* dataPointer;
-		vkMapMemory(_logicalDevice, stagingMemory, 0, imageSize, 0, &dataPointer);
+		// The data is staged in chunks of at most STAGING_CHUNK_SIZE, so an uncompressed sky box of any size fits in
+		// the arena. Each chunk is a contiguous range of the data, made of bands of rows of one face. The rows of BC1
+		// are rows of 4x4 blocks. The first chunk moves the image to the transfer layout, the last one releases it.
+		uint32_t blockSize = image->format == SkyBoxFormat::Bc1 ? 4 : 1;
 
-		for (int layer = 0; layer < 6; layer++) {
-			memcpy(static_cast<char*>(dataPointer) + (layer * layerSize), layers[layer], static_cast<size_t>(layerSize));
-		}
+		std::vector<VkBufferImageCopy> bufferImageCopies;
+		size_t chunkStart = 0;
+		size_t chunkEnd = 0;
+		bool isFirstChunk = true;
 
-		vkUnmapMemory(_logicalDevice, stagingMemory);
+		auto submitChunk = [&](bool isLastChunk) {
+			StagingRegion staging = acquireStagingRegion(chunkEnd - chunkStart);
+			memcpy(staging.handle, image->data.data() + chunkStart, chunkEnd - chunkStart);
 
-		for (int layer = 0; layer < 6; layer++) {
-			stbi_image_free(layers[layer]);
-		}
+			VkCommandBuffer copyCommandBuffer;
+			createCommandBuffers(_transfer.commandPool, &copyCommandBuffer);
 
-		VkCommandBuffer copyCommandBuffer;
-		createCommandBuffers(_graphics.commandPool, &copyCommandBuffer);
+			if (isFirstChunk) {
+				VkImageMemoryBarrier imageMemoryBarrier{};
+				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageMemoryBarrier.image = _skyBox.image;
+				imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, image->mipLevelCount, 0, 6 };
+				imageMemoryBarrier.srcAccessMask = 0;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
-		VkBufferImageCopy bufferImageCopy{};
-		bufferImageCopy.bufferOffset = 0;
-		bufferImageCopy.bufferRowLength = 0;
-		bufferImageCopy.bufferImageHeight = 0;
-		bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferImageCopy.imageSubresource.mipLevel = 0;
-		bufferImageCopy.imageSubresource.baseArrayLayer = 0;
-		bufferImageCopy.imageSubresource.layerCount = 6;
-		bufferImageCopy.imageOffset = { 0, 0, 0 };
-		bufferImageCopy.imageExtent = { (uint32_t)texWidth, (uint32_t)texHeight, 1 };
+				vkCmdPipelineBarrier(copyCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				isFirstChunk = false;
+			}
 
-		// std::cout << "outbuffer=" << &stagingBuffer << std::endl;
-		vkCmdCopyBufferToImage(copyCommandBuffer, stagingBuffer, _skyBox.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferImageCopy);
-		submitCommandBuffers(_graphics.commandPool, _graphics.queue, &copyCommandBuffer);
-		changeImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, _skyBox.image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, 6);
-	
-		vkFreeMemory(_logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(_logicalDevice, stagingBuffer, nullptr);
-	}
-
-	void RayTracer::createStorageBuffers() {
-		createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, sizeof(Settings), _scene.settingBuffer, _scene.settingMemory);
-		vkMapMemory(_logicalDevice, _scene.settingMemory, 0, sizeof(Settings), 0, &_scene.settingHandle);
-
-		std::vector<Sphere> spheres{ 0 };
-
-		for (int i = 0; i < 5; i++) {
-			for (int j = 0; j < 5; j++) {
-				Sphere sphere{};
-				sphere.radius = 2.0f;
-				sphere.position = { i * 7, 1.0f, j * 7 };
-				sphere.albedo = { 0.2f, 0.2f, 0.2f };
-				sphere.specular = { 0.8f, 0.8f, 0.8f };
-
-				glm::vec3 color = {
-					static_cast <float> (rand()) / static_cast <float> (RAND_MAX),
-					static_cast <float> (rand()) / static_cast <float> (RAND_MAX),
-					static_cast <float> (rand()) / static_cast <float> (RAND_MAX)
-				};
-
-				if (static_cast <float> (rand()) / static_cast <float> (RAND_MAX) < 0.5f) {
-					sphere.albedo = color;
-					sphere.specular = { 0.1f, 0.1f, 0.1f };
-				} else {
-					sphere.albedo = { 0.0f, 0.0f, 0.0f };
-					sphere.specular = color;
-				}
+			// The offsets were taken from the start of the chunk
+			for (auto& bufferImageCopy : bufferImageCopies) {
+				bufferImageCopy.bufferOffset += staging.offset;
+			}
+
+			vkCmdCopyBufferToImage(copyCommandBuffer, _transfer.stagingBuffer, _skyBox.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferImageCopies.size()), bufferImageCopies.data());
+
+			if (isLastChunk) {
+				releaseImage(copyCommandBuffer, _skyBox.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, image->mipLevelCount, 6);
+			}
 
-				spheres.push_back(sphere);
+			submitTransfer(copyCommandBuffer, staging);
+
+			bufferImageCopies.clear();
+			chunkStart = chunkEnd;
+		};
+
+		for (uint32_t level = 0; level < image->mipLevelCount; level++) {
+			uint32_t levelSize = std::max(1u, image->size >> level);
+			uint32_t blockRowCount = (levelSize + blockSize - 1) / blockSize;
+
+			size_t faceSize = getSkyBoxFaceSize(image->format, image->size, level);
+			size_t rowSize = faceSize / blockRowCount;
+			uint32_t bandRowCount = static_cast<uint32_t>(std::max<size_t>(1, static_cast<size_t>(STAGING_CHUNK_SIZE) / rowSize));
+
+			for (uint32_t face = 0; face < 6; face++) {
+				for (uint32_t row = 0; row < blockRowCount; row += bandRowCount) {
+					uint32_t rowCount = std::min(bandRowCount, blockRowCount - row);
+					size_t bandSize = rowCount * rowSize;
+
+					if (chunkEnd + bandSize - chunkStart > STAGING_CHUNK_SIZE) {
+						submitChunk(false);
+					}
+
+					uint32_t y = row * blockSize;
+
+					VkBufferImageCopy bufferImageCopy{};
+					bufferImageCopy.bufferOffset = chunkEnd - chunkStart;
+					bufferImageCopy.bufferRowLength = 0;
+					bufferImageCopy.bufferImageHeight = 0;
+					bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					bufferImageCopy.imageSubresource.mipLevel = level;
+					bufferImageCopy.imageSubresource.baseArrayLayer = face;
+					bufferImageCopy.imageSubresource.layerCount = 1;
+					bufferImageCopy.imageOffset = { 0, static_cast<int32_t>(y), 0 };
+					bufferImageCopy.imageExtent = { levelSize, std::min(rowCount * blockSize, levelSize - y), 1 };
+
+					bufferImageCopies.push_back(bufferImageCopy);
+					chunkEnd += bandSize;
+				}
 			}
 		}
 
+		submitChunk(true);
+
+		// Overlaps with the copy, a cache which cannot be written is rebuilt on the next start
+		if (!_assets.isSkyBoxCached && _assets.hasSkyBoxSources && !_assets.skyBoxCachePath.empty()) {
+			writeSkyBoxCache(_assets.skyBoxCachePath.c_str(), _assets.skyBoxSources, _assets.skyBox);
+		}
+
+		_assets.skyBox = {};
+	}
+
+	void RayTracer::createStorageBuffers(const SceneData& scene) {
+		_scene.settings = {};
+		_scene.settingBuffers.resize(_options.framesInFlight);
+		_scene.settingMemories.resize(_options.framesInFlight);
+		_scene.settingHandles.resize(_options.framesInFlight);
+
+		for (uint32_t frame = 0; frame < _options.framesInFlight; frame++) {
+			createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, sizeof(Settings), _scene.settingBuffers[frame], _scene.settingMemories[frame]);
+			_scene.settingHandles[frame] = _scene.settingMemories[frame].handle;
+		}
+
+		_scene.sphereCount = scene.sphereCount;
+		_scene.planeCount = scene.planeCount;
+		_scene.materialCount = scene.materialCount;
 
-		VkDeviceSize spheresBufferSize = spheres.size() * sizeof(Sphere);
-		createStorageBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, spheresBufferSize, _scene.sphereBuffer, _scene.sphereMemory, spheres.data());
+		VkDeviceSize spheresBufferSize = static_cast<VkDeviceSize>(scene.sphereCount) * sizeof(Sphere);
+		createStorageBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, spheresBufferSize, _scene.sphereBuffer, _scene.sphereMemory, scene.spheres);
 	
-		glm::vec3 x = { -1, 0, 0 };
+		VkDeviceSize planesBufferSize = static_cast<VkDeviceSize>(scene.planeCount) * sizeof(Plane);
+		createStorageBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, planesBufferSize, _scene.planeBuffer, _scene.planeMemory, scene.planes);
 
-		std::vector<Plane> planes = {
-			{ { 0.0f, -1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, {1.0f, 1.0f, 1.0f}, {0.1f, 0.1f, 0.1f} },
-		};
+		VkDeviceSize materialsBufferSize = static_cast<VkDeviceSize>(scene.materialCount) * sizeof(Material);
+		createStorageBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, materialsBufferSize, _scene.materialBuffer, _scene.materialMemory, scene.materials);
+
+		VkDeviceSize bvhNodesBufferSize = static_cast<VkDeviceSize>(scene.bvhNodeCount) * sizeof(BvhNode);
+		createStorageBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, bvhNodesBufferSize, _scene.bvhNodeBuffer, _scene.bvhNodeMemory, scene.bvhNodes);
+
+		VkDeviceSize bvhIndicesBufferSize = static_cast<VkDeviceSize>(scene.bvhIndexCount) * sizeof(uint32_t);
+		createStorageBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, bvhIndicesBufferSize, _scene.bvhIndexBuffer, _scene.bvhIndexMemory, scene.bvhIndices);
+
+		VkDeviceSize animationsBufferSize = static_cast<VkDeviceSize>(scene.animationCount) * sizeof(SphereAnimation);
+		createStorageBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, animationsBufferSize, _scene.animationBuffer, _scene.animationMemory, scene.animations);
 
-		VkDeviceSize planesBufferSize = planes.size() * sizeof(Plane);
-		createStorageBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, planesBufferSize, _scene.planeBuffer, _scene.planeMemory, planes.data());
+		// Storage buffers cannot be empty
+		bool hasMeshes = scene.meshCount > 0;
+
+		VkDeviceSize meshesBufferSize = hasMeshes ? static_cast<VkDeviceSize>(scene.meshCount) * sizeof(Mesh) : sizeof(Mesh);
+		createStorageBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshesBufferSize, _scene.meshBuffer, _scene.meshMemory, hasMeshes ? static_cast<const void*>(scene.meshes) : &EMPTY_MESH);
+
+		VkDeviceSize meshVerticesBufferSize = hasMeshes ? static_cast<VkDeviceSize>(scene.meshVertexCount) * sizeof(MeshVertex) : sizeof(MeshVertex);
+		createStorageBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshVerticesBufferSize, _scene.meshVertexBuffer, _scene.meshVertexMemory, hasMeshes ? static_cast<const void*>(scene.meshVertices) : &EMPTY_MESH_VERTEX);
+
+		VkDeviceSize meshIndicesBufferSize = hasMeshes ? static_cast<VkDeviceSize>(scene.meshIndexCount) * sizeof(uint32_t) : sizeof(uint32_t);
+		createStorageBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshIndicesBufferSize, _scene.meshIndexBuffer, _scene.meshIndexMemory, hasMeshes ? static_cast<const void*>(scene.meshIndices) : &EMPTY_MESH_INDEX);
+
+		VkDeviceSize meshNodesBufferSize = hasMeshes ? static_cast<VkDeviceSize>(scene.meshNodeCount) * sizeof(BvhNode) : sizeof(BvhNode);
+		createStorageBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshNodesBufferSize, _scene.meshNodeBuffer, _scene.meshNodeMemory, hasMeshes ? static_cast<const void*>(scene.meshNodes) : &EMPTY_MESH_NODE);
+
+		VkDeviceSize spherePositionsBufferSize = static_cast<VkDeviceSize>(scene.sphereCount) * sizeof(glm::vec4);
+		createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, spherePositionsBufferSize, _scene.spherePositionBuffer, _scene.spherePositionMemory);
 	}
 
 	// TODO move descriptor set creation into their respective pipelines
 	// TODO note: the descriptor pool has to be created after the swap chain
 	void RayTracer::createDescriptorSets() {
+		uint32_t frameCount = _options.framesInFlight;
+
 		std::vector<VkDescriptorPoolSize> descriptorPoolSizes = {
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 },
-			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 }
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * frameCount },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 * frameCount },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2 * frameCount },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 16 * frameCount }
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
 		descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 		descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size());
 		descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes.data();
-		descriptorPoolCreateInfo.maxSets = _swapChain.imageCount;
+		descriptorPoolCreateInfo.maxSets = 2 * frameCount;
 
 		if (vkCreateDescriptorPool(_logicalDevice, &descriptorPoolCreateInfo, nullptr, &_descriptorPool) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create the descriptor pool!");
 		}
 
-		VkDescriptorImageInfo descriptorImageInfo{};
-		descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-		descriptorImageInfo.imageView = _targetTexture.imageView;
-		descriptorImageInfo.sampler = _sampler;
-
-		{
+		if (!isHeadless()) {
 			VkDescriptorSetLayoutBinding graphicsDescriptorSetLayoutBinding{};
 			graphicsDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 			graphicsDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -597,31 +2132,24 @@ namespace vrt {
 				throw std::runtime_error("Failed to create the graphics descriptor set layout");
 			}
 
+			std::vector<VkDescriptorSetLayout> graphicsDescriptorSetLayouts(frameCount, _graphics.descriptorSetLayout);
+			_graphics.descriptorSets.resize(frameCount);
+
 			VkDescriptorSetAllocateInfo graphicsDescriptorSetAllocateInfo{};
 			graphicsDescriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 			graphicsDescriptorSetAllocateInfo.descriptorPool = _descriptorPool;
-			graphicsDescriptorSetAllocateInfo.descriptorSetCount = 1;
-			graphicsDescriptorSetAllocateInfo.pSetLayouts = &_graphics.descriptorSetLayout;
+			graphicsDescriptorSetAllocateInfo.descriptorSetCount = frameCount;
+			graphicsDescriptorSetAllocateInfo.pSetLayouts = graphicsDescriptorSetLayouts.data();
 
-			if (vkAllocateDescriptorSets(_logicalDevice, &graphicsDescriptorSetAllocateInfo, &_graphics.descriptorSet) != VK_SUCCESS) {
-				throw std::runtime_error("Failed to allocate the graphics descriptor set");
+			if (vkAllocateDescriptorSets(_logicalDevice, &graphicsDescriptorSetAllocateInfo, _graphics.descriptorSets.data()) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate the graphics descriptor sets");
 			}
-
-			VkWriteDescriptorSet graphicsWriteDescriptorSet{};
-			graphicsWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			graphicsWriteDescriptorSet.dstSet = _graphics.descriptorSet;
-			graphicsWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			graphicsWriteDescriptorSet.dstBinding = 0;
-			graphicsWriteDescriptorSet.pImageInfo = &descriptorImageInfo;
-			graphicsWriteDescriptorSet.descriptorCount = 1;
-
-			vkUpdateDescriptorSets(_logicalDevice, 1, &graphicsWriteDescriptorSet, 0, nullptr);
 		}
 
 		{
 
 			// TODO cleanup
-			std::vector<VkDescriptorSetLayoutBinding> computeDescriptorSetLayoutBindings{ 5 };
+			std::vector<VkDescriptorSetLayoutBinding> computeDescriptorSetLayoutBindings{ 20 };
 			VkDescriptorSetLayoutBinding computeSkyBoxDescriptorSetLayoutBinding{};
 			computeSkyBoxDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 			computeSkyBoxDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
@@ -657,6 +2185,68 @@ namespace vrt {
 			computePlanesDescriptorSetLayoutBinding.descriptorCount = 1;
 			computeDescriptorSetLayoutBindings[4] = computePlanesDescriptorSetLayoutBinding;
 
+			VkDescriptorSetLayoutBinding computeBvhNodesDescriptorSetLayoutBinding{};
+			computeBvhNodesDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			computeBvhNodesDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			computeBvhNodesDescriptorSetLayoutBinding.binding = 5;
+			computeBvhNodesDescriptorSetLayoutBinding.descriptorCount = 1;
+			computeDescriptorSetLayoutBindings[5] = computeBvhNodesDescriptorSetLayoutBinding;
+
+			VkDescriptorSetLayoutBinding computeBvhIndicesDescriptorSetLayoutBinding{};
+			computeBvhIndicesDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			computeBvhIndicesDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			computeBvhIndicesDescriptorSetLayoutBinding.binding = 6;
+			computeBvhIndicesDescriptorSetLayoutBinding.descriptorCount = 1;
+			computeDescriptorSetLayoutBindings[6] = computeBvhIndicesDescriptorSetLayoutBinding;
+
+			VkDescriptorSetLayoutBinding computeAccumulationDescriptorSetLayoutBinding{};
+			computeAccumulationDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			computeAccumulationDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			computeAccumulationDescriptorSetLayoutBinding.binding = 7;
+			computeAccumulationDescriptorSetLayoutBinding.descriptorCount = 1;
+			computeDescriptorSetLayoutBindings[7] = computeAccumulationDescriptorSetLayoutBinding;
+
+			VkDescriptorSetLayoutBinding computeSpherePositionsDescriptorSetLayoutBinding{};
+			computeSpherePositionsDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			computeSpherePositionsDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			computeSpherePositionsDescriptorSetLayoutBinding.binding = 8;
+			computeSpherePositionsDescriptorSetLayoutBinding.descriptorCount = 1;
+			computeDescriptorSetLayoutBindings[8] = computeSpherePositionsDescriptorSetLayoutBinding;
+
+			VkDescriptorSetLayoutBinding computeAnimationsDescriptorSetLayoutBinding{};
+			computeAnimationsDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			computeAnimationsDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			computeAnimationsDescriptorSetLayoutBinding.binding = 9;
+			computeAnimationsDescriptorSetLayoutBinding.descriptorCount = 1;
+			computeDescriptorSetLayoutBindings[9] = computeAnimationsDescriptorSetLayoutBinding;
+
+			// Paths, hits, queues, counters and radiance of the wavefront kernels, left unwritten by the megakernel
+			for (uint32_t binding = 10; binding < 15; binding++) {
+				VkDescriptorSetLayoutBinding computeWavefrontDescriptorSetLayoutBinding{};
+				computeWavefrontDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				computeWavefrontDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+				computeWavefrontDescriptorSetLayoutBinding.binding = binding;
+				computeWavefrontDescriptorSetLayoutBinding.descriptorCount = 1;
+				computeDescriptorSetLayoutBindings[binding] = computeWavefrontDescriptorSetLayoutBinding;
+			}
+
+			VkDescriptorSetLayoutBinding computeMaterialsDescriptorSetLayoutBinding{};
+			computeMaterialsDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			computeMaterialsDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			computeMaterialsDescriptorSetLayoutBinding.binding = 15;
+			computeMaterialsDescriptorSetLayoutBinding.descriptorCount = 1;
+			computeDescriptorSetLayoutBindings[15] = computeMaterialsDescriptorSetLayoutBinding;
+
+			// Meshes, their vertices, indices and BVH nodes
+			for (uint32_t binding = 16; binding < 20; binding++) {
+				VkDescriptorSetLayoutBinding computeMeshDescriptorSetLayoutBinding{};
+				computeMeshDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				computeMeshDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+				computeMeshDescriptorSetLayoutBinding.binding = binding;
+				computeMeshDescriptorSetLayoutBinding.descriptorCount = 1;
+				computeDescriptorSetLayoutBindings[binding] = computeMeshDescriptorSetLayoutBinding;
+			}
+
 			VkDescriptorSetLayoutCreateInfo computeDescriptorSetLayoutCreateInfo{};
 			computeDescriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 			computeDescriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(computeDescriptorSetLayoutBindings.size());
@@ -666,94 +2256,254 @@ namespace vrt {
 				throw std::runtime_error("Failed to create the compute descriptor set layout");
 			}
 
+			std::vector<VkDescriptorSetLayout> computeDescriptorSetLayouts(frameCount, _compute.descriptorSetLayout);
+			_compute.descriptorSets.resize(frameCount);
+
 			VkDescriptorSetAllocateInfo computeDescriptorSetAllocateInfo{};
 			computeDescriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 			computeDescriptorSetAllocateInfo.descriptorPool = _descriptorPool;
-			computeDescriptorSetAllocateInfo.descriptorSetCount = 1;
-			computeDescriptorSetAllocateInfo.pSetLayouts = &_compute.descriptorSetLayout;
+			computeDescriptorSetAllocateInfo.descriptorSetCount = frameCount;
+			computeDescriptorSetAllocateInfo.pSetLayouts = computeDescriptorSetLayouts.data();
 
-			if (vkAllocateDescriptorSets(_logicalDevice, &computeDescriptorSetAllocateInfo, &_compute.descriptorSet) != VK_SUCCESS) {
-				throw std::runtime_error("Failed to allocate the compute descriptor set");
+			if (vkAllocateDescriptorSets(_logicalDevice, &computeDescriptorSetAllocateInfo, _compute.descriptorSets.data()) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate the compute descriptor sets");
 			}
 
-			VkDescriptorImageInfo skyBoxDescriptorImageInfo{};
-			skyBoxDescriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			skyBoxDescriptorImageInfo.imageView = _skyBox.imageView;
-			skyBoxDescriptorImageInfo.sampler = _sampler;
+			for (uint32_t frame = 0; frame < frameCount; frame++) {
+				VkDescriptorImageInfo skyBoxDescriptorImageInfo{};
+				skyBoxDescriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				skyBoxDescriptorImageInfo.imageView = _skyBox.imageView;
+				skyBoxDescriptorImageInfo.sampler = _sampler;
+
+				// The target and accumulation images are written by writeTargetDescriptorSets
+				// TODO cleanup
+				std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets{ 9 };
+				VkWriteDescriptorSet computeSkyBoxWriteDescriptorSet{};
+				computeSkyBoxWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				computeSkyBoxWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
+				computeSkyBoxWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				computeSkyBoxWriteDescriptorSet.dstBinding = 0;
+				computeSkyBoxWriteDescriptorSet.pImageInfo = &skyBoxDescriptorImageInfo;
+				computeSkyBoxWriteDescriptorSet.descriptorCount = 1;
+				computeWriteDescriptorSets[0] = computeSkyBoxWriteDescriptorSet;
+
+				VkDescriptorBufferInfo cameraDescriptorBufferInfo{};
+				cameraDescriptorBufferInfo.buffer = _scene.settingBuffers[frame];
+				cameraDescriptorBufferInfo.range = VK_WHOLE_SIZE;
+				cameraDescriptorBufferInfo.offset = 0;
+
+				VkWriteDescriptorSet computeCameraWriteDescriptorSet{};
+				computeCameraWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				computeCameraWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
+				computeCameraWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				computeCameraWriteDescriptorSet.dstBinding = 2;
+				computeCameraWriteDescriptorSet.pBufferInfo = &cameraDescriptorBufferInfo;
+				computeCameraWriteDescriptorSet.descriptorCount = 1;
+				computeWriteDescriptorSets[1] = computeCameraWriteDescriptorSet;
+
+				VkDescriptorBufferInfo sphereDescriptorBufferInfo{};
+				sphereDescriptorBufferInfo.buffer = _scene.sphereBuffer;
+				sphereDescriptorBufferInfo.range = VK_WHOLE_SIZE;
+				sphereDescriptorBufferInfo.offset = 0;
+
+				VkWriteDescriptorSet computeSpheresWriteDescriptorSet{};
+				computeSpheresWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				computeSpheresWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
+				computeSpheresWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				computeSpheresWriteDescriptorSet.dstBinding = 3;
+				computeSpheresWriteDescriptorSet.pBufferInfo = &sphereDescriptorBufferInfo;
+				computeSpheresWriteDescriptorSet.descriptorCount = 1;
+				computeWriteDescriptorSets[2] = computeSpheresWriteDescriptorSet;
+
+				VkDescriptorBufferInfo planeDescriptorBufferInfo{};
+				planeDescriptorBufferInfo.buffer = _scene.planeBuffer;
+				planeDescriptorBufferInfo.range = VK_WHOLE_SIZE;
+				planeDescriptorBufferInfo.offset = 0;
+
+				VkWriteDescriptorSet computePlanesWriteDescriptorSet{};
+				computePlanesWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				computePlanesWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
+				computePlanesWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				computePlanesWriteDescriptorSet.dstBinding = 4;
+				computePlanesWriteDescriptorSet.pBufferInfo = &planeDescriptorBufferInfo;
+				computePlanesWriteDescriptorSet.descriptorCount = 1;
+				computeWriteDescriptorSets[3] = computePlanesWriteDescriptorSet;
+
+				VkDescriptorBufferInfo bvhNodeDescriptorBufferInfo{};
+				bvhNodeDescriptorBufferInfo.buffer = _scene.bvhNodeBuffer;
+				bvhNodeDescriptorBufferInfo.range = VK_WHOLE_SIZE;
+				bvhNodeDescriptorBufferInfo.offset = 0;
+
+				VkWriteDescriptorSet computeBvhNodesWriteDescriptorSet{};
+				computeBvhNodesWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				computeBvhNodesWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
+				computeBvhNodesWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				computeBvhNodesWriteDescriptorSet.dstBinding = 5;
+				computeBvhNodesWriteDescriptorSet.pBufferInfo = &bvhNodeDescriptorBufferInfo;
+				computeBvhNodesWriteDescriptorSet.descriptorCount = 1;
+				computeWriteDescriptorSets[4] = computeBvhNodesWriteDescriptorSet;
+
+				VkDescriptorBufferInfo bvhIndexDescriptorBufferInfo{};
+				bvhIndexDescriptorBufferInfo.buffer = _scene.bvhIndexBuffer;
+				bvhIndexDescriptorBufferInfo.range = VK_WHOLE_SIZE;
+				bvhIndexDescriptorBufferInfo.offset = 0;
+
+				VkWriteDescriptorSet computeBvhIndicesWriteDescriptorSet{};
+				computeBvhIndicesWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				computeBvhIndicesWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
+				computeBvhIndicesWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				computeBvhIndicesWriteDescriptorSet.dstBinding = 6;
+				computeBvhIndicesWriteDescriptorSet.pBufferInfo = &bvhIndexDescriptorBufferInfo;
+				computeBvhIndicesWriteDescriptorSet.descriptorCount = 1;
+				computeWriteDescriptorSets[5] = computeBvhIndicesWriteDescriptorSet;
+
+				VkDescriptorBufferInfo spherePositionDescriptorBufferInfo{};
+				spherePositionDescriptorBufferInfo.buffer = _scene.spherePositionBuffer;
+				spherePositionDescriptorBufferInfo.range = VK_WHOLE_SIZE;
+				spherePositionDescriptorBufferInfo.offset = 0;
+
+				VkWriteDescriptorSet computeSpherePositionsWriteDescriptorSet{};
+				computeSpherePositionsWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				computeSpherePositionsWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
+				computeSpherePositionsWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				computeSpherePositionsWriteDescriptorSet.dstBinding = 8;
+				computeSpherePositionsWriteDescriptorSet.pBufferInfo = &spherePositionDescriptorBufferInfo;
+				computeSpherePositionsWriteDescriptorSet.descriptorCount = 1;
+				computeWriteDescriptorSets[6] = computeSpherePositionsWriteDescriptorSet;
+
+				VkDescriptorBufferInfo animationDescriptorBufferInfo{};
+				animationDescriptorBufferInfo.buffer = _scene.animationBuffer;
+				animationDescriptorBufferInfo.range = VK_WHOLE_SIZE;
+				animationDescriptorBufferInfo.offset = 0;
+
+				VkWriteDescriptorSet computeAnimationsWriteDescriptorSet{};
+				computeAnimationsWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				computeAnimationsWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
+				computeAnimationsWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				computeAnimationsWriteDescriptorSet.dstBinding = 9;
+				computeAnimationsWriteDescriptorSet.pBufferInfo = &animationDescriptorBufferInfo;
+				computeAnimationsWriteDescriptorSet.descriptorCount = 1;
+				computeWriteDescriptorSets[7] = computeAnimationsWriteDescriptorSet;
+
+				VkDescriptorBufferInfo materialDescriptorBufferInfo{};
+				materialDescriptorBufferInfo.buffer = _scene.materialBuffer;
+				materialDescriptorBufferInfo.range = VK_WHOLE_SIZE;
+				materialDescriptorBufferInfo.offset = 0;
+
+				VkWriteDescriptorSet computeMaterialsWriteDescriptorSet{};
+				computeMaterialsWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				computeMaterialsWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
+				computeMaterialsWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				computeMaterialsWriteDescriptorSet.dstBinding = 15;
+				computeMaterialsWriteDescriptorSet.pBufferInfo = &materialDescriptorBufferInfo;
+				computeMaterialsWriteDescriptorSet.descriptorCount = 1;
+				computeWriteDescriptorSets[8] = computeMaterialsWriteDescriptorSet;
+
+				std::vector<VkDescriptorBufferInfo> meshDescriptorBufferInfos;
+
+				for (VkBuffer buffer : { _scene.meshBuffer, _scene.meshVertexBuffer, _scene.meshIndexBuffer, _scene.meshNodeBuffer }) {
+					meshDescriptorBufferInfos.push_back({ buffer, 0, VK_WHOLE_SIZE });
+				}
 
-			// TODO cleanup
-			std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets{ 5 };
-			VkWriteDescriptorSet computeSkyBoxWriteDescriptorSet{};
-			computeSkyBoxWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			computeSkyBoxWriteDescriptorSet.dstSet = _compute.descriptorSet;
-			computeSkyBoxWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			computeSkyBoxWriteDescriptorSet.dstBinding = 0;
-			computeSkyBoxWriteDescriptorSet.pImageInfo = &skyBoxDescriptorImageInfo;
-			computeSkyBoxWriteDescriptorSet.descriptorCount = 1;
-			computeWriteDescriptorSets[0] = computeSkyBoxWriteDescriptorSet;
-
-			VkWriteDescriptorSet computeStorageWriteDescriptorSet{};
+				for (uint32_t index = 0; index < meshDescriptorBufferInfos.size(); index++) {
+					VkWriteDescriptorSet computeMeshWriteDescriptorSet{};
+					computeMeshWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					computeMeshWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
+					computeMeshWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+					computeMeshWriteDescriptorSet.dstBinding = 16 + index;
+					computeMeshWriteDescriptorSet.pBufferInfo = &meshDescriptorBufferInfos[index];
+					computeMeshWriteDescriptorSet.descriptorCount = 1;
+
+					computeWriteDescriptorSets.push_back(computeMeshWriteDescriptorSet);
+				}
+
+				vkUpdateDescriptorSets(_logicalDevice, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, nullptr);
+			}
+		}
+
+		writeTargetDescriptorSets();
+	}
+
+	// The images and buffers sized after the swap chain, written again when they are recreated
+	void RayTracer::writeTargetDescriptorSets() {
+		for (uint32_t frame = 0; frame < _options.framesInFlight; frame++) {
+			VkDescriptorImageInfo descriptorImageInfo{};
+			descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			descriptorImageInfo.imageView = _targetTexture.imageViews[frame];
+			descriptorImageInfo.sampler = _sampler;
+
+			VkDescriptorImageInfo accumulationDescriptorImageInfo{};
+			accumulationDescriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			accumulationDescriptorImageInfo.imageView = _accumulation.imageView;
+			accumulationDescriptorImageInfo.sampler = _sampler;
+
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets{ 2 };
+
+			VkWriteDescriptorSet& computeStorageWriteDescriptorSet = writeDescriptorSets[0];
 			computeStorageWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			computeStorageWriteDescriptorSet.dstSet = _compute.descriptorSet;
+			computeStorageWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
 			computeStorageWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
 			computeStorageWriteDescriptorSet.dstBinding = 1;
 			computeStorageWriteDescriptorSet.pImageInfo = &descriptorImageInfo;
 			computeStorageWriteDescriptorSet.descriptorCount = 1;
-			computeWriteDescriptorSets[1] = computeStorageWriteDescriptorSet;
-
-			VkDescriptorBufferInfo cameraDescriptorBufferInfo{};
-			cameraDescriptorBufferInfo.buffer = _scene.settingBuffer;
-			cameraDescriptorBufferInfo.range = VK_WHOLE_SIZE;
-			cameraDescriptorBufferInfo.offset = 0;
-
-			VkWriteDescriptorSet computeCameraWriteDescriptorSet{};
-			computeCameraWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			computeCameraWriteDescriptorSet.dstSet = _compute.descriptorSet;
-			computeCameraWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			computeCameraWriteDescriptorSet.dstBinding = 2;
-			computeCameraWriteDescriptorSet.pBufferInfo = &cameraDescriptorBufferInfo;
-			computeCameraWriteDescriptorSet.descriptorCount = 1;
-			computeWriteDescriptorSets[2] = computeCameraWriteDescriptorSet;
-
-			VkDescriptorBufferInfo sphereDescriptorBufferInfo{};
-			sphereDescriptorBufferInfo.buffer = _scene.sphereBuffer;
-			sphereDescriptorBufferInfo.range = VK_WHOLE_SIZE;
-			sphereDescriptorBufferInfo.offset = 0;
-
-			VkWriteDescriptorSet computeSpheresWriteDescriptorSet{};
-			computeSpheresWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			computeSpheresWriteDescriptorSet.dstSet = _compute.descriptorSet;
-			computeSpheresWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			computeSpheresWriteDescriptorSet.dstBinding = 3;
-			computeSpheresWriteDescriptorSet.pBufferInfo = &sphereDescriptorBufferInfo;
-			computeSpheresWriteDescriptorSet.descriptorCount = 1;
-			computeWriteDescriptorSets[3] = computeSpheresWriteDescriptorSet;
-
-			VkDescriptorBufferInfo planeDescriptorBufferInfo{};
-			planeDescriptorBufferInfo.buffer = _scene.planeBuffer;
-			planeDescriptorBufferInfo.range = VK_WHOLE_SIZE;
-			planeDescriptorBufferInfo.offset = 0;
-
-			VkWriteDescriptorSet computePlanesWriteDescriptorSet{};
-			computePlanesWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			computePlanesWriteDescriptorSet.dstSet = _compute.descriptorSet;
-			computePlanesWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			computePlanesWriteDescriptorSet.dstBinding = 4;
-			computePlanesWriteDescriptorSet.pBufferInfo = &planeDescriptorBufferInfo;
-			computePlanesWriteDescriptorSet.descriptorCount = 1;
-			computeWriteDescriptorSets[4] = computePlanesWriteDescriptorSet;
-
-			vkUpdateDescriptorSets(_logicalDevice, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, nullptr);
+
+			VkWriteDescriptorSet& computeAccumulationWriteDescriptorSet = writeDescriptorSets[1];
+			computeAccumulationWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			computeAccumulationWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
+			computeAccumulationWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			computeAccumulationWriteDescriptorSet.dstBinding = 7;
+			computeAccumulationWriteDescriptorSet.pImageInfo = &accumulationDescriptorImageInfo;
+			computeAccumulationWriteDescriptorSet.descriptorCount = 1;
+
+			std::vector<VkDescriptorBufferInfo> wavefrontDescriptorBufferInfos;
+
+			if (_options.wavefront) {
+				for (VkBuffer buffer : { _wavefront.pathBuffer, _wavefront.hitBuffer, _wavefront.queueBuffer, _wavefront.counterBuffer, _wavefront.radianceBuffer }) {
+					wavefrontDescriptorBufferInfos.push_back({ buffer, 0, VK_WHOLE_SIZE });
+				}
+
+				for (uint32_t index = 0; index < wavefrontDescriptorBufferInfos.size(); index++) {
+					VkWriteDescriptorSet computeWavefrontWriteDescriptorSet{};
+					computeWavefrontWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					computeWavefrontWriteDescriptorSet.dstSet = _compute.descriptorSets[frame];
+					computeWavefrontWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+					computeWavefrontWriteDescriptorSet.dstBinding = 10 + index;
+					computeWavefrontWriteDescriptorSet.pBufferInfo = &wavefrontDescriptorBufferInfos[index];
+					computeWavefrontWriteDescriptorSet.descriptorCount = 1;
+
+					writeDescriptorSets.push_back(computeWavefrontWriteDescriptorSet);
+				}
+			}
+
+			if (!isHeadless()) {
+				VkWriteDescriptorSet graphicsWriteDescriptorSet{};
+				graphicsWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				graphicsWriteDescriptorSet.dstSet = _graphics.descriptorSets[frame];
+				graphicsWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				graphicsWriteDescriptorSet.dstBinding = 0;
+				graphicsWriteDescriptorSet.pImageInfo = &descriptorImageInfo;
+				graphicsWriteDescriptorSet.descriptorCount = 1;
+
+				writeDescriptorSets.push_back(graphicsWriteDescriptorSet);
+			}
+
+			vkUpdateDescriptorSets(_logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 		}
 	}
 
 	void RayTracer::createGraphicsPipeline() {
+		// Extent of the part of the target texture traced by the frame
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(VkExtent2D);
+
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = 1;
 		pipelineLayoutInfo.pSetLayouts = &_graphics.descriptorSetLayout;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
 		if (vkCreatePipelineLayout(_logicalDevice, &pipelineLayoutInfo, nullptr, &_graphics.pipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create the pipeline layout");
@@ -777,6 +2527,21 @@ namespace vrt {
 		fragmentShaderStageInfo.module = shaderFragment;
 		fragmentShaderStageInfo.pName = "main";
 
+		uint32_t upscalingFilter = static_cast<uint32_t>(_options.upscalingFilter);
+
+		VkSpecializationMapEntry fragmentSpecializationMapEntry{};
+		fragmentSpecializationMapEntry.constantID = 0;
+		fragmentSpecializationMapEntry.offset = 0;
+		fragmentSpecializationMapEntry.size = sizeof(uint32_t);
+
+		VkSpecializationInfo fragmentSpecializationInfo{};
+		fragmentSpecializationInfo.mapEntryCount = 1;
+		fragmentSpecializationInfo.pMapEntries = &fragmentSpecializationMapEntry;
+		fragmentSpecializationInfo.dataSize = sizeof(uint32_t);
+		fragmentSpecializationInfo.pData = &upscalingFilter;
+
+		fragmentShaderStageInfo.pSpecializationInfo = &fragmentSpecializationInfo;
+
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderStageInfo, fragmentShaderStageInfo };
 
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
@@ -791,24 +2556,20 @@ namespace vrt {
 		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)_swapChain.extent.width;
-		viewport.height = (float)_swapChain.extent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
+		// Set when recording, so the pipeline outlives the swap chain when the window is resized
+		VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 
-		VkRect2D scissor{};
-		scissor.offset = { 0, 0 };
-		scissor.extent = _swapChain.extent;
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = 2;
+		dynamicState.pDynamicStates = dynamicStates;
 
 		VkPipelineViewportStateCreateInfo viewportState{};
 		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
+		viewportState.pViewports = nullptr;
 		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
+		viewportState.pScissors = nullptr;
 
 		VkPipelineRasterizationStateCreateInfo rasterizer{};
 		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -864,14 +2625,14 @@ namespace vrt {
 		graphicsPipelineInfo.pMultisampleState = &multisampling;
 		graphicsPipelineInfo.pDepthStencilState = nullptr;
 		graphicsPipelineInfo.pColorBlendState = &colorBlending;
-		graphicsPipelineInfo.pDynamicState = nullptr;
+		graphicsPipelineInfo.pDynamicState = &dynamicState;
 		graphicsPipelineInfo.layout = _graphics.pipelineLayout;
 		graphicsPipelineInfo.renderPass = _swapChain.renderPass;
 		graphicsPipelineInfo.subpass = 0;
 		graphicsPipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 		graphicsPipelineInfo.basePipelineIndex = -1;
 
-		if (vkCreateGraphicsPipelines(_logicalDevice, VK_NULL_HANDLE, 1, &graphicsPipelineInfo, nullptr, &_graphics.pipeline) != VK_SUCCESS) {
+		if (vkCreateGraphicsPipelines(_logicalDevice, _pipelineCache.cache, 1, &graphicsPipelineInfo, nullptr, &_graphics.pipeline) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create the graphics pipeline");
 		}
 
@@ -880,181 +2641,722 @@ namespace vrt {
 	}
 
 	void RayTracer::createComputePipeline() {
+		// Extent of the part of the target texture traced, it follows the render scale without a new pipeline
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(ComputePushConstants);
+
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = 1;
 		pipelineLayoutInfo.pSetLayouts = &_compute.descriptorSetLayout;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
 		if (vkCreatePipelineLayout(_logicalDevice, &pipelineLayoutInfo, nullptr, &_compute.pipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create the pipeline layout");
 		}
 
-		VkShaderModule shaderCompute{};
-		loadShaderModule(SHADER_COMPUTE_PATH, shaderCompute);
+		bool hasWorkgroupSize = _options.workgroupSize.width > 0 && _options.workgroupSize.height > 0;
+		_compute.workgroupSize = hasWorkgroupSize ? _options.workgroupSize : loadWorkgroupSize();
+
+		if (!isWorkgroupSizeSupported(_compute.workgroupSize)) {
+			throw std::runtime_error("The workgroup size exceeds the limits of the device");
+		}
+
+		if (_options.wavefront) {
+			_compute.pipeline = VK_NULL_HANDLE;
+			createWavefrontPipelines();
+		} else {
+			VkShaderModule shaderCompute{};
+			loadShaderModule(SHADER_COMPUTE_PATH, shaderCompute);
+			createRayTracingPipeline(shaderCompute, _compute.workgroupSize, _compute.pipeline);
+			vkDestroyShaderModule(_logicalDevice, shaderCompute, nullptr);
+		}
+
+		VkShaderModule shaderAnimation{};
+		loadShaderModule(SHADER_ANIMATION_PATH, shaderAnimation);
+
+		VkPipelineShaderStageCreateInfo animationStageInfo{};
+		animationStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		animationStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		animationStageInfo.module = shaderAnimation;
+		animationStageInfo.pName = "main";
+
+		VkComputePipelineCreateInfo animationPipelineCreateInfo{};
+		animationPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		animationPipelineCreateInfo.layout = _compute.pipelineLayout;
+		animationPipelineCreateInfo.flags = 0;
+		animationPipelineCreateInfo.stage = animationStageInfo;
+
+		if (vkCreateComputePipelines(_logicalDevice, _pipelineCache.cache, 1, &animationPipelineCreateInfo, nullptr, &_compute.animationPipeline) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create the animation pipeline");
+		}
+
+		vkDestroyShaderModule(_logicalDevice, shaderAnimation, nullptr);
+	}
+
+	void RayTracer::createRayTracingPipeline(VkShaderModule shaderModule, VkExtent2D workgroupSize, VkPipeline& pipeline) {
+		ComputeSpecialization specialization{};
+		specialization.samplesPerPixel = _options.samplesPerPixel;
+		specialization.maxBounces = _options.maxBounces;
+		specialization.workgroupWidth = workgroupSize.width;
+		specialization.workgroupHeight = workgroupSize.height;
+
+		VkSpecializationMapEntry specializationMapEntries[4];
 
-		VkPipelineShaderStageCreateInfo vertexComputeStageInfo{};
-		vertexComputeStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertexComputeStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-		vertexComputeStageInfo.module = shaderCompute;
-		vertexComputeStageInfo.pName = "main";
+		for (uint32_t index = 0; index < 4; index++) {
+			specializationMapEntries[index].constantID = index;
+			specializationMapEntries[index].offset = index * sizeof(uint32_t);
+			specializationMapEntries[index].size = sizeof(uint32_t);
+		}
+
+		VkSpecializationInfo specializationInfo{};
+		specializationInfo.mapEntryCount = 4;
+		specializationInfo.pMapEntries = specializationMapEntries;
+		specializationInfo.dataSize = sizeof(ComputeSpecialization);
+		specializationInfo.pData = &specialization;
+
+		VkPipelineShaderStageCreateInfo computeStageInfo{};
+		computeStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		computeStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		computeStageInfo.module = shaderModule;
+		computeStageInfo.pName = "main";
+		computeStageInfo.pSpecializationInfo = &specializationInfo;
 
 		VkComputePipelineCreateInfo computePipelineCreateInfo{};
 		computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
 		computePipelineCreateInfo.layout = _compute.pipelineLayout;
 		computePipelineCreateInfo.flags = 0;
-		computePipelineCreateInfo.stage = vertexComputeStageInfo;
+		computePipelineCreateInfo.stage = computeStageInfo;
 
-		if (vkCreateComputePipelines(_logicalDevice, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &_compute.pipeline) != VK_SUCCESS) {
+		if (vkCreateComputePipelines(_logicalDevice, _pipelineCache.cache, 1, &computePipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create the compute pipeline");
 		}
+	}
 
-		vkDestroyShaderModule(_logicalDevice, shaderCompute, nullptr);
+	// The kernels take the same specialization constants as the megakernel, the workgroup shape only applies to the
+	// generation and the resolve, which run per pixel.
+	void RayTracer::createWavefrontPipelines() {
+		const std::pair<const char*, VkPipeline*> kernels[] = {
+			{ SHADER_WAVEFRONT_GENERATE_PATH, &_wavefront.generatePipeline },
+			{ SHADER_WAVEFRONT_EXTEND_PATH, &_wavefront.extendPipeline },
+			{ SHADER_WAVEFRONT_SHADE_PATH, &_wavefront.shadePipeline },
+			{ SHADER_WAVEFRONT_SHADOW_PATH, &_wavefront.shadowPipeline },
+			{ SHADER_WAVEFRONT_RESOLVE_PATH, &_wavefront.resolvePipeline }
+		};
+
+		for (const auto& kernel : kernels) {
+			VkShaderModule shaderModule{};
+			loadShaderModule(kernel.first, shaderModule);
+			createRayTracingPipeline(shaderModule, _compute.workgroupSize, *kernel.second);
+			vkDestroyShaderModule(_logicalDevice, shaderModule, nullptr);
+		}
 	}
 
 	void RayTracer::createDrawCommandBuffers() {
-		_graphics.drawCommandBuffers.resize(_swapChain.imageCount);
-		createCommandBuffers(_graphics.commandPool, _graphics.drawCommandBuffers.data(), _swapChain.imageCount);
+		_graphics.drawCommandBuffers.resize(_options.framesInFlight);
+
+		// Recorded every frame by recordDrawCommandBuffer, as the swap chain image is only known after the acquisition
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferAllocateInfo.commandPool = _graphics.commandPool;
+		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferAllocateInfo.commandBufferCount = _options.framesInFlight;
+
+		if (vkAllocateCommandBuffers(_logicalDevice, &commandBufferAllocateInfo, _graphics.drawCommandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate the draw command buffers");
+		}
+	}
+
+	void RayTracer::recordDrawCommandBuffer(uint32_t frameIndex, uint32_t imageIndex) {
+		VkCommandBuffer commandBuffer = _graphics.drawCommandBuffers[frameIndex];
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		VkCommandBufferBeginInfo commandBufferBeginInfo{};
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin the recording of the draw command buffer");
+		}
 
 		VkClearValue clearValues[2];
 		clearValues[0].color = { 0.1f, 0.1f, 0.1f, 1.0f };
 		clearValues[1].depthStencil = { 1.0f, 0 };
 
-		for (uint32_t i = 0; i < _swapChain.imageCount; i++) {
+		VkImageMemoryBarrier imageMemoryBarrier = {};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.image = _targetTexture.images[frameIndex];
+		imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		if (_queueFamilyIndices.graphics != _queueFamilyIndices.compute) {
+			imageMemoryBarrier.srcAccessMask = 0;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageMemoryBarrier.srcQueueFamilyIndex = _queueFamilyIndices.compute;
+			imageMemoryBarrier.dstQueueFamilyIndex = _queueFamilyIndices.graphics;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		} else {
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+
+		if (_timestamps.enabled) {
+			vkCmdResetQueryPool(commandBuffer, _timestamps.queryPool, frameIndex * TIMESTAMPS_PER_FRAME + 2, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _timestamps.queryPool, frameIndex * TIMESTAMPS_PER_FRAME + 2);
+		}
+
+		VkRenderPassBeginInfo renderPassBeginInfo{};
+		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassBeginInfo.renderPass = _swapChain.renderPass;
+		renderPassBeginInfo.renderArea.offset = { 0, 0 };
+		renderPassBeginInfo.renderArea.extent = _swapChain.extent;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = _swapChain.frameBuffers[imageIndex];
+
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)_swapChain.extent.width;
+		viewport.height = (float)_swapChain.extent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+
+		VkRect2D scissor{};
+		scissor.offset = { 0, 0 };
+		scissor.extent = _swapChain.extent;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphics.pipeline);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphics.pipelineLayout, 0, 1, &_graphics.descriptorSets[frameIndex], 0, nullptr);
+
+		// The part of the target texture the compute command buffer of the frame was recorded for
+		vkCmdPushConstants(commandBuffer, _graphics.pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(VkExtent2D), &_resolution.frameExtents[frameIndex]);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		vkCmdEndRenderPass(commandBuffer);
+
+		if (_timestamps.enabled) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _timestamps.queryPool, frameIndex * TIMESTAMPS_PER_FRAME + 3);
+		}
+
+		// Copied on the graphics queue, which owns the target texture until the release below
+		if (_capture.callback && _capture.extents[frameIndex].width > 0) {
+			recordReadback(commandBuffer, frameIndex, _capture.buffers[frameIndex], _capture.extents[frameIndex]);
+		}
+
+		if (_queueFamilyIndices.graphics != _queueFamilyIndices.compute) {
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			imageMemoryBarrier.dstAccessMask = 0;
+			imageMemoryBarrier.srcQueueFamilyIndex = _queueFamilyIndices.graphics;
+			imageMemoryBarrier.dstQueueFamilyIndex = _queueFamilyIndices.compute;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record the command buffer!");
+		}
+	}
+
+	// Recorded again by drawFrame whenever the traced extent changes
+	void RayTracer::createComputeCommandBuffers() {
+		_compute.commandBuffers.resize(_options.framesInFlight);
+		_resolution.frameExtents.assign(_options.framesInFlight, VkExtent2D{ 0, 0 });
+
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferAllocateInfo.commandPool = _compute.commandPool;
+		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferAllocateInfo.commandBufferCount = _options.framesInFlight;
+
+		if (vkAllocateCommandBuffers(_logicalDevice, &commandBufferAllocateInfo, _compute.commandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate the compute command buffers");
+		}
+
+		for (uint32_t frame = 0; frame < _options.framesInFlight; frame++) {
+			recordComputeCommandBuffer(frame);
+		}
+	}
+
+	void RayTracer::recordComputeCommandBuffer(uint32_t frameIndex) {
+		TraceRegion region{ _resolution.extent, { 0, 0 }, _resolution.extent };
+		recordComputeCommandBuffer(frameIndex, region);
+
+		_resolution.frameExtents[frameIndex] = _resolution.extent;
+	}
+
+	void RayTracer::recordComputeCommandBuffer(uint32_t frameIndex, const TraceRegion& region) {
+		VkCommandBuffer commandBuffer = _compute.commandBuffers[frameIndex];
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		VkCommandBufferBeginInfo commandBufferBeginInfo{};
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+		if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin the recording of the compute command buffer");
+		}
+
+		if (_queueFamilyIndices.graphics != _queueFamilyIndices.compute) {
 			VkImageMemoryBarrier imageMemoryBarrier = {};
 			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
 			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-			imageMemoryBarrier.image = _targetTexture.image;
+			imageMemoryBarrier.image = _targetTexture.images[frameIndex];
 			imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			imageMemoryBarrier.srcAccessMask = 0;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			imageMemoryBarrier.srcQueueFamilyIndex = _queueFamilyIndices.graphics;
+			imageMemoryBarrier.dstQueueFamilyIndex = _queueFamilyIndices.compute;
 
-			if (_queueFamilyIndices.graphics != _queueFamilyIndices.compute) {
-				imageMemoryBarrier.srcAccessMask = 0;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-				imageMemoryBarrier.srcQueueFamilyIndex = _queueFamilyIndices.compute;
-				imageMemoryBarrier.dstQueueFamilyIndex = _queueFamilyIndices.graphics;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
 
-				vkCmdPipelineBarrier(_graphics.drawCommandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			} else {
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-				imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-				imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		if (_timestamps.enabled) {
+			vkCmdResetQueryPool(commandBuffer, _timestamps.queryPool, frameIndex * TIMESTAMPS_PER_FRAME, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _timestamps.queryPool, frameIndex * TIMESTAMPS_PER_FRAME);
+		}
 
-				vkCmdPipelineBarrier(_graphics.drawCommandBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		// The previous frame may still be tracing against the positions which are about to be overwritten
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		// Evaluates the motion of every sphere once, so the tracer only reads static positions
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _compute.animationPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _compute.pipelineLayout, 0, 1, &_compute.descriptorSets[frameIndex], 0, 0);
+		vkCmdDispatch(commandBuffer, (_scene.sphereCount + ANIMATION_WORKGROUP_SIZE - 1) / ANIMATION_WORKGROUP_SIZE, 1, 1);
+
+		VkMemoryBarrier positionMemoryBarrier = {};
+		positionMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		positionMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		positionMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		// The previous dispatch may also still be writing the accumulation image this one reads
+		VkImageMemoryBarrier accumulationMemoryBarrier = {};
+		accumulationMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		accumulationMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		accumulationMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		accumulationMemoryBarrier.image = _accumulation.image;
+		accumulationMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		accumulationMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		accumulationMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		accumulationMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		accumulationMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &positionMemoryBarrier, 0, nullptr, 1, &accumulationMemoryBarrier);
+
+		// All the pipelines share the layout, the descriptor set stays bound
+		if (_options.wavefront) {
+			recordWavefrontDispatches(commandBuffer, region);
+		} else {
+			ComputePushConstants pushConstants{ region.extent, 0, 0, region.offset, region.frameExtent };
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _compute.pipeline);
+			vkCmdPushConstants(commandBuffer, _compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer,
+				(region.extent.width + _compute.workgroupSize.width - 1) / _compute.workgroupSize.width,
+				(region.extent.height + _compute.workgroupSize.height - 1) / _compute.workgroupSize.height, 1);
+		}
+
+		if (_timestamps.enabled) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, _timestamps.queryPool, frameIndex * TIMESTAMPS_PER_FRAME + 1);
+		}
+
+		if (_queueFamilyIndices.graphics != _queueFamilyIndices.compute) {
+			VkImageMemoryBarrier imageMemoryBarrier = {};
+			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageMemoryBarrier.image = _targetTexture.images[frameIndex];
+			imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			imageMemoryBarrier.dstAccessMask = 0;
+			imageMemoryBarrier.srcQueueFamilyIndex = _queueFamilyIndices.compute;
+			imageMemoryBarrier.dstQueueFamilyIndex = _queueFamilyIndices.graphics;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to end the recording of the compute command buffer");
+		}
+	}
+
+	// Traces the samples one after the other. Every pixel starts a path, then each bounce finds the closest hits of
+	// the rays left, shades them, and casts the shadow rays of the lit ones. Past the generation, the kernels are
+	// dispatched indirectly over the queue the previous kernel appended to, so they only run live rays.
+	void RayTracer::recordWavefrontDispatches(VkCommandBuffer commandBuffer, const TraceRegion& region) {
+		VkExtent2D groupCount = {
+			(region.extent.width + _compute.workgroupSize.width - 1) / _compute.workgroupSize.width,
+			(region.extent.height + _compute.workgroupSize.height - 1) / _compute.workgroupSize.height
+		};
+
+		// The previous frame may still be reading the counters, the queues and the paths
+		VkMemoryBarrier resetMemoryBarrier{};
+		resetMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		resetMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		resetMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &resetMemoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Recorded into the command buffer, every queue starts empty with a dispatch of zero workgroups
+		std::vector<QueueCounter> counters(2 * _options.samplesPerPixel * _options.maxBounces, QueueCounter{ 0, 1, 1, 0 });
+		vkCmdUpdateBuffer(commandBuffer, _wavefront.counterBuffer, 0, counters.size() * sizeof(QueueCounter), counters.data());
+
+		VkMemoryBarrier counterMemoryBarrier{};
+		counterMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		counterMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		counterMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &counterMemoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Between two kernels: the queues, their counters and the path state written by one are read by the next
+		VkMemoryBarrier queueMemoryBarrier{};
+		queueMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		queueMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		queueMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+		ComputePushConstants pushConstants{ region.extent, 0, 0, region.offset, region.frameExtent };
+
+		for (uint32_t sample = 0; sample < _options.samplesPerPixel; sample++) {
+			pushConstants.sampleIndex = sample;
+			pushConstants.bounceIndex = 0;
+			vkCmdPushConstants(commandBuffer, _compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pushConstants);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _wavefront.generatePipeline);
+			vkCmdDispatch(commandBuffer, groupCount.width, groupCount.height, 1);
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &queueMemoryBarrier, 0, nullptr, 0, nullptr);
+
+			for (uint32_t bounce = 0; bounce < _options.maxBounces; bounce++) {
+				pushConstants.bounceIndex = bounce;
+				vkCmdPushConstants(commandBuffer, _compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pushConstants);
+
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _wavefront.extendPipeline);
+				vkCmdDispatchIndirect(commandBuffer, _wavefront.counterBuffer, getWavefrontCounterOffset(sample, bounce, false));
+
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &queueMemoryBarrier, 0, nullptr, 0, nullptr);
+
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _wavefront.shadePipeline);
+				vkCmdDispatchIndirect(commandBuffer, _wavefront.counterBuffer, getWavefrontCounterOffset(sample, bounce, false));
+
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &queueMemoryBarrier, 0, nullptr, 0, nullptr);
+
+				// Not separated from the closest hits of the next bounce, neither writes what the other reads
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _wavefront.shadowPipeline);
+				vkCmdDispatchIndirect(commandBuffer, _wavefront.counterBuffer, getWavefrontCounterOffset(sample, bounce, true));
 			}
 
-			VkRenderPassBeginInfo renderPassBeginInfo{};
-			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassBeginInfo.renderPass = _swapChain.renderPass;
-			renderPassBeginInfo.renderArea.offset = { 0, 0 };
-			renderPassBeginInfo.renderArea.extent = _swapChain.extent;
-			renderPassBeginInfo.clearValueCount = 2;
-			renderPassBeginInfo.pClearValues = clearValues;
-			renderPassBeginInfo.framebuffer = _swapChain.frameBuffers[i];
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &queueMemoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _wavefront.resolvePipeline);
+		vkCmdDispatch(commandBuffer, groupCount.width, groupCount.height, 1);
+	}
+
+	// The copy waits for the dispatch which traced the target texture, or for the draw which sampled it when the
+	// window is presented, the extent is taken from its top left corner
+	void RayTracer::recordReadback(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkBuffer buffer, VkExtent2D extent) {
+		VkPipelineStageFlags sourceStage = isHeadless() ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+		VkImageMemoryBarrier imageMemoryBarrier{};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.image = _targetTexture.images[frameIndex];
+		imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		vkCmdPipelineBarrier(commandBuffer, sourceStage, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+		VkBufferImageCopy bufferImageCopy{};
+		bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		bufferImageCopy.imageSubresource.mipLevel = 0;
+		bufferImageCopy.imageSubresource.baseArrayLayer = 0;
+		bufferImageCopy.imageSubresource.layerCount = 1;
+		bufferImageCopy.imageOffset = { 0, 0, 0 };
+		bufferImageCopy.imageExtent = { extent.width, extent.height, 1 };
+
+		vkCmdCopyImageToBuffer(commandBuffer, _targetTexture.images[frameIndex], VK_IMAGE_LAYOUT_GENERAL, buffer, 1, &bufferImageCopy);
+
+		// The fence alone does not make the copy visible to the host
+		VkMemoryBarrier hostMemoryBarrier{};
+		hostMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		hostMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		hostMemoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostMemoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	// A ray and a shadow counter per sample and bounce, in the order of getRayCounter and getShadowCounter in wavefront.glsl
+	VkDeviceSize RayTracer::getWavefrontCounterOffset(uint32_t sample, uint32_t bounce, bool isShadow) const {
+		uint32_t index = ((isShadow ? _options.samplesPerPixel : 0) + sample) * _options.maxBounces + bounce;
+
+		return index * sizeof(QueueCounter);
+	}
+
+	void RayTracer::createSemaphoresAndFences() {
+		_sync.frameComplete.resize(_options.framesInFlight);
+
+		if (!isHeadless()) {
+			_sync.computeComplete.resize(_options.framesInFlight);
+			_sync.presentComplete.resize(_options.framesInFlight);
+
+			VkSemaphoreCreateInfo semaphoreCreateInfo{};
+			semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+			for (uint32_t frame = 0; frame < _options.framesInFlight; frame++) {
+				if (vkCreateSemaphore(_logicalDevice, &semaphoreCreateInfo, nullptr, &_sync.computeComplete[frame]) != VK_SUCCESS ||
+					vkCreateSemaphore(_logicalDevice, &semaphoreCreateInfo, nullptr, &_sync.presentComplete[frame]) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create the semaphores");
+				}
+			}
 
-			vkCmdBeginRenderPass(_graphics.drawCommandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdBindPipeline(_graphics.drawCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _graphics.pipeline);
-			vkCmdBindDescriptorSets(_graphics.drawCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _graphics.pipelineLayout, 0, 1, &_graphics.descriptorSet, 0, nullptr);
-			vkCmdDraw(_graphics.drawCommandBuffers[i], 3, 1, 0, 0);
-			vkCmdEndRenderPass(_graphics.drawCommandBuffers[i]);
+			createRenderSemaphores();
+		}
 
-			if (_queueFamilyIndices.graphics != _queueFamilyIndices.compute) {
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = 0;
-				imageMemoryBarrier.srcQueueFamilyIndex = _queueFamilyIndices.graphics;
-				imageMemoryBarrier.dstQueueFamilyIndex = _queueFamilyIndices.compute;
+		// Created signaled so the first use of each frame does not block
+		VkFenceCreateInfo fenceCreateInfo{};
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-				vkCmdPipelineBarrier(_graphics.drawCommandBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		for (uint32_t frame = 0; frame < _options.framesInFlight; frame++) {
+			if (vkCreateFence(_logicalDevice, &fenceCreateInfo, nullptr, &_sync.frameComplete[frame]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create the frame fence");
 			}
+		}
+
+		releaseTargetTexturesToCompute();
+	}
+
+	// Signaled by the render submission and waited by the presentation of a given image
+	void RayTracer::createRenderSemaphores() {
+		_sync.renderComplete.resize(_swapChain.imageCount);
+
+		VkSemaphoreCreateInfo semaphoreCreateInfo{};
+		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-			if (vkEndCommandBuffer(_graphics.drawCommandBuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("Failed to record the command buffer!");
+		for (uint32_t i = 0; i < _swapChain.imageCount; i++) {
+			if (vkCreateSemaphore(_logicalDevice, &semaphoreCreateInfo, nullptr, &_sync.renderComplete[i]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create the semaphores");
 			}
 		}
 	}
 
-	void RayTracer::createComputeCommandBuffer() {
-		createCommandBuffers(_compute.commandPool, &_compute.commandBuffer);
+	// The compute command buffers start by acquiring their target texture from the graphics queue, which has to
+	// have released it once before the first frame
+	void RayTracer::releaseTargetTexturesToCompute() {
+		if (_queueFamilyIndices.graphics == _queueFamilyIndices.compute) {
+			return;
+		}
 
-		if (_queueFamilyIndices.graphics != _queueFamilyIndices.compute) {
-			VkImageMemoryBarrier imageMemoryBarrier = {};
+		VkCommandBuffer commandBuffer;
+		createCommandBuffers(_graphics.commandPool, &commandBuffer);
+
+		std::vector<VkImageMemoryBarrier> imageMemoryBarriers{ _options.framesInFlight };
+
+		for (uint32_t frame = 0; frame < _options.framesInFlight; frame++) {
+			VkImageMemoryBarrier& imageMemoryBarrier = imageMemoryBarriers[frame];
 			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
 			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-			imageMemoryBarrier.image = _targetTexture.image;
+			imageMemoryBarrier.image = _targetTexture.images[frame];
 			imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-			imageMemoryBarrier.srcAccessMask = 0;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			imageMemoryBarrier.dstAccessMask = 0;
 			imageMemoryBarrier.srcQueueFamilyIndex = _queueFamilyIndices.graphics;
 			imageMemoryBarrier.dstQueueFamilyIndex = _queueFamilyIndices.compute;
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(imageMemoryBarriers.size()), imageMemoryBarriers.data());
+		submitCommandBuffers(_graphics.commandPool, _graphics.queue, &commandBuffer);
+	}
+
+	void RayTracer::readTimestamps(uint32_t frameIndex) {
+		if (!_timestamps.enabled || !_timestamps.written[frameIndex]) {
+			return;
+		}
+
+		// The fence of the frame has been waited on, so the results are available and this never stalls
+		uint64_t timestamps[4];
+		uint32_t timestampCount = isHeadless() ? 2 : 4;
+
+		if (vkGetQueryPoolResults(_logicalDevice, _timestamps.queryPool, frameIndex * TIMESTAMPS_PER_FRAME, timestampCount, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+			return;
+		}
+
+		double millisecondsPerTick = _timestamps.period / 1e6;
+		double computeTime = getElapsedTicks(timestamps[0], timestamps[1], _timestamps.computeMask) * millisecondsPerTick;
+		_statistics.computeTime.add(computeTime);
+
+		if (!isHeadless()) {
+			double renderTime = getElapsedTicks(timestamps[2], timestamps[3], _timestamps.graphicsMask) * millisecondsPerTick;
+			_statistics.renderTime.add(renderTime);
+
+			updateRenderScale(frameIndex, computeTime, renderTime);
+		}
+	}
+
+	// The ray tracing time grows with the traced pixels while the fullscreen pass runs at the output resolution
+	// whatever the scale. Both are smoothed, then the scale is set so their sum fits in the budget. The measures
+	// come from the frame which used the slot last, so they are normalized by the extent it was traced at.
+	void RayTracer::updateRenderScale(uint32_t frameIndex, double computeTime, double renderTime) {
+		VkExtent2D frameExtent = _resolution.frameExtents[frameIndex];
+
+		// The accumulation needs the same pixels from one frame to the next, the scale holds while it is enabled
+		if (_options.frameTimeBudget <= 0.0f || _accumulation.enabled || frameExtent.width == 0) {
+			return;
+		}
+
+		double computeTimePerPixel = computeTime / (static_cast<double>(frameExtent.width) * frameExtent.height);
+
+		if (_resolution.computeTimePerPixel == 0.0) {
+			_resolution.computeTimePerPixel = computeTimePerPixel;
+			_resolution.renderTime = renderTime;
+		} else {
+			_resolution.computeTimePerPixel += (computeTimePerPixel - _resolution.computeTimePerPixel) * RENDER_SCALE_SMOOTHING;
+			_resolution.renderTime += (renderTime - _resolution.renderTime) * RENDER_SCALE_SMOOTHING;
+		}
+
+		double outputPixelCount = static_cast<double>(_swapChain.extent.width) * _swapChain.extent.height;
+		double computeBudget = _options.frameTimeBudget * RENDER_SCALE_HEADROOM - _resolution.renderTime;
+		double scale = computeBudget > 0.0 ? std::sqrt(computeBudget / (_resolution.computeTimePerPixel * outputPixelCount)) : 0.0;
+		scale = std::clamp(scale, static_cast<double>(_options.minRenderScale), static_cast<double>(_options.renderScale));
+
+		bool isBound = scale == _options.minRenderScale || scale == _options.renderScale;
+
+		if (std::abs(scale - _resolution.scale) < RENDER_SCALE_STEP && !isBound) {
+			return;
+		}
+
+		_resolution.scale = static_cast<float>(scale);
+		_resolution.extent = getScaledExtent(_resolution.scale);
+	}
+
+	void RayTracer::recordFrameTimes(std::chrono::steady_clock::time_point frameStart) {
+		auto now = std::chrono::steady_clock::now();
+		_statistics.submitTime.add(std::chrono::duration<double, std::milli>(now - frameStart).count());
+
+		if (_statistics.hasPresented) {
+			_statistics.presentInterval.add(std::chrono::duration<double, std::milli>(now - _statistics.lastPresent).count());
+		}
+
+		_statistics.hasPresented = true;
+		_statistics.lastPresent = now;
+	}
+
+	void RayTracer::createUploadRing() {
+		_upload.segmentSize = _options.uploadRingSize / _options.framesInFlight;
+		_upload.segmentUsed = 0;
+		_upload.segmentAcquired = false;
+
+		createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _upload.segmentSize * _options.framesInFlight, _upload.buffer, _upload.memory);
+
+		_upload.handle = static_cast<uint8_t*>(_upload.memory.handle);
+
+		// Recorded by recordUploadCommandBuffer on the frames which have pending updates
+		_upload.commandBuffers.resize(_options.framesInFlight);
+
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferAllocateInfo.commandPool = _compute.commandPool;
+		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferAllocateInfo.commandBufferCount = _options.framesInFlight;
+
+		if (vkAllocateCommandBuffers(_logicalDevice, &commandBufferAllocateInfo, _upload.commandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate the upload command buffers");
+		}
+	}
 
-			vkCmdPipelineBarrier(_compute.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	void RayTracer::recordUploadCommandBuffer(uint32_t frameIndex) {
+		VkCommandBuffer commandBuffer = _upload.commandBuffers[frameIndex];
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		VkCommandBufferBeginInfo commandBufferBeginInfo{};
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin the recording of the upload command buffer");
 		}
 
-		vkCmdBindPipeline(_compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _compute.pipeline);
-		vkCmdBindDescriptorSets(_compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _compute.pipelineLayout, 0, 1, &_compute.descriptorSet, 0, 0);
-		vkCmdDispatch(_compute.commandBuffer, _swapChain.extent.width / 16, _swapChain.extent.height / 16, 1);
+		// The dispatches of the frames still in flight read the buffers which are about to be overwritten
+		VkMemoryBarrier memoryBarrier{};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = 0;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
-		if (_queueFamilyIndices.graphics != _queueFamilyIndices.compute) {
-			VkImageMemoryBarrier imageMemoryBarrier = {};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-			imageMemoryBarrier.image = _targetTexture.image;
-			imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = 0;
-			imageMemoryBarrier.srcQueueFamilyIndex = _queueFamilyIndices.compute;
-			imageMemoryBarrier.dstQueueFamilyIndex = _queueFamilyIndices.graphics;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
-			vkCmdPipelineBarrier(_compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
+		recordBufferCopies(commandBuffer, _scene.sphereBuffer, _upload.sphereRegions);
+		recordBufferCopies(commandBuffer, _scene.planeBuffer, _upload.planeRegions);
+		recordBufferCopies(commandBuffer, _scene.materialBuffer, _upload.materialRegions);
 
-		if (vkEndCommandBuffer(_compute.commandBuffer) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to end the recording of the compute command buffer");
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record the upload command buffer");
 		}
 	}
 
-	void RayTracer::createSemaphoresAndFences() {
-		VkSemaphoreCreateInfo semaphoreCreateInfo{};
-		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	void RayTracer::recordBufferCopies(VkCommandBuffer commandBuffer, VkBuffer buffer, std::vector<VkBufferCopy>& regions) {
+		if (regions.empty()) {
+			return;
+		}
+
+		std::vector<VkBufferCopy> sortedRegions = regions;
+		std::stable_sort(sortedRegions.begin(), sortedRegions.end(), [](const VkBufferCopy& left, const VkBufferCopy& right) {
+			return left.dstOffset < right.dstOffset;
+		});
+
+		bool overlapping = false;
 
-		if (vkCreateSemaphore(_logicalDevice, &semaphoreCreateInfo, nullptr, &_sync.presentComplete) != VK_SUCCESS ||
-			vkCreateSemaphore(_logicalDevice, &semaphoreCreateInfo, nullptr, &_sync.renderComplete) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create the semaphores");
+		for (size_t index = 1; index < sortedRegions.size(); index++) {
+			overlapping |= sortedRegions[index - 1].dstOffset + sortedRegions[index - 1].size > sortedRegions[index].dstOffset;
 		}
 
-		VkFenceCreateInfo fenceCreateInfo{};
-		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		if (!overlapping) {
+			vkCmdCopyBuffer(commandBuffer, _upload.buffer, buffer, static_cast<uint32_t>(sortedRegions.size()), sortedRegions.data());
 
-		if (vkCreateFence(_logicalDevice, &fenceCreateInfo, nullptr, &_sync.computeComplete) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create the compute shader fence");
+			return;
 		}
 
-		if (_queueFamilyIndices.graphics != _queueFamilyIndices.compute) {
-			VkCommandBuffer commandBuffer;
-			createCommandBuffers(_graphics.commandPool, &commandBuffer);
+		// The regions of a single copy must not overlap, so objects updated several times in the same frame are
+		// copied one region at a time, in the order of the calls
+		VkMemoryBarrier memoryBarrier{};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
-			VkImageMemoryBarrier imageMemoryBarrier = {};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-			imageMemoryBarrier.image = _targetTexture.image;
-			imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = 0;
-			imageMemoryBarrier.srcQueueFamilyIndex = _queueFamilyIndices.graphics;
-			imageMemoryBarrier.dstQueueFamilyIndex = _queueFamilyIndices.compute;
-			
-			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			submitCommandBuffers(_graphics.commandPool, _graphics.queue, &commandBuffer);
+		for (size_t index = 0; index < regions.size(); index++) {
+			if (index > 0) {
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+
+			vkCmdCopyBuffer(commandBuffer, _upload.buffer, buffer, 1, &regions[index]);
 		}
+	}
+
+	void RayTracer::createReadbackBuffer() {
+		VkDeviceSize size = static_cast<VkDeviceSize>(_targetTexture.extent.width) * _targetTexture.extent.height * 4;
 
-		vkWaitForFences(_logicalDevice, 1, &_sync.computeComplete, VK_TRUE, UINT64_MAX);
-		vkResetFences(_logicalDevice, 1, &_sync.computeComplete);
+		createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size, _readback.buffer, _readback.memory);
+		_readback.handle = _readback.memory.handle;
 	}
 
 	uint8_t RayTracer::getPhysicalDeviceQuality(VkPhysicalDevice physicalDevice) {
@@ -1066,7 +3368,7 @@ namespace vrt {
 
 		bool hasRequiredExtensions = true;
 
-		for (const auto& requiredExtensionProperty : REQUIRED_EXTENSION_PROPERTIES) {
+		for (const auto& requiredExtensionProperty : getRequiredDeviceExtensions()) {
 			bool hasExtension = false;
 
 			for (const auto& extensionProperty : extensionProperties) {
@@ -1088,18 +3390,28 @@ namespace vrt {
 			return UINT8_MAX;
 		}
 
-		uint32_t surfaceFormatCount;
-		vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, _surface, &surfaceFormatCount, nullptr);
+		// Timeline semaphores are core since Vulkan 1.2
+		VkPhysicalDeviceProperties physicalDeviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
 
-		if (surfaceFormatCount == 0) {
+		if (physicalDeviceProperties.apiVersion < VK_API_VERSION_1_2) {
 			return UINT8_MAX;
 		}
 
-		uint32_t presentModeCount;
-		vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, _surface, &presentModeCount, nullptr);
+		if (!isHeadless()) {
+			uint32_t surfaceFormatCount;
+			vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, _surface, &surfaceFormatCount, nullptr);
 
-		if (presentModeCount == 0) {
-			return UINT8_MAX;
+			if (surfaceFormatCount == 0) {
+				return UINT8_MAX;
+			}
+
+			uint32_t presentModeCount;
+			vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, _surface, &presentModeCount, nullptr);
+
+			if (presentModeCount == 0) {
+				return UINT8_MAX;
+			}
 		}
 
 		uint32_t queueFamilyPropertyCount;
@@ -1137,9 +3449,6 @@ namespace vrt {
 			quality += 1;
 		}
 
-		VkPhysicalDeviceProperties physicalDeviceProperties;
-		vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
-
 		switch (physicalDeviceProperties.deviceType) {
 		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return quality;
 		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return quality + 0x10;
@@ -1241,7 +3550,7 @@ namespace vrt {
 		if (_swapChain.extent.width == std::numeric_limits<uint32_t>::max()) {
 			int width, height;
 
-			_window.getFrameBufferSize(&width, &height);
+			_surfaceProvider->getFrameBufferSize(&width, &height);
 
 			_swapChain.extent.width = static_cast<uint32_t>(width);
 			_swapChain.extent.height = static_cast<uint32_t>(height);
@@ -1262,17 +3571,20 @@ namespace vrt {
 		return surfaceCapabilities;
 	}
 
-	uint32_t RayTracer::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-		VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
-		vkGetPhysicalDeviceMemoryProperties(_physicalDevice, &physicalDeviceMemoryProperties);
+	VkExtent2D RayTracer::getScaledExtent(float scale) const {
+		VkExtent2D extent;
+		extent.width = std::max(1u, static_cast<uint32_t>(std::lround(_swapChain.extent.width * scale)));
+		extent.height = std::max(1u, static_cast<uint32_t>(std::lround(_swapChain.extent.height * scale)));
 
-		for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; i++) {
-			if ((typeFilter & (1 << i)) && (physicalDeviceMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
-			}
+		return extent;
+	}
+
+	std::vector<const char*> RayTracer::getRequiredDeviceExtensions() {
+		if (isHeadless()) {
+			return {};
 		}
 
-		throw std::runtime_error("Could not find a matching memory type");
+		return REQUIRED_EXTENSION_PROPERTIES;
 	}
 
 	void RayTracer::createCommandBuffers(VkCommandPool commandPool, VkCommandBuffer* commandBuffers, uint32_t commandBufferCount) {
@@ -1326,7 +3638,7 @@ namespace vrt {
 		vkFreeCommandBuffers(_logicalDevice, commandPool, commandBufferCount, commandBuffers);
 	}
 
-	void RayTracer::createBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& memory) {
+	void RayTracer::createBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceSize size, VkBuffer& buffer, Allocation& memory) {
 		VkBufferCreateInfo bufferCreateInfo{};
 		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferCreateInfo.size = size;
@@ -1340,27 +3652,18 @@ namespace vrt {
 		VkMemoryRequirements memoryRequirements;
 		vkGetBufferMemoryRequirements(_logicalDevice, buffer, &memoryRequirements);
 
-		VkMemoryAllocateInfo memoryAllocateInfo{};
-		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memoryAllocateInfo.allocationSize = memoryRequirements.size;
-		memoryAllocateInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(_logicalDevice, &memoryAllocateInfo, nullptr, &memory) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate the buffer memory");
-		}
+		memory = _allocator.allocate(memoryRequirements, properties, true);
 
-		if (vkBindBufferMemory(_logicalDevice, buffer, memory, 0) != VK_SUCCESS) {
+		if (vkBindBufferMemory(_logicalDevice, buffer, memory.memory, memory.offset) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to bind the buffer memory");
 		}
 	}
 
-	void RayTracer::createImageAndView(VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& memory, VkImageView& view, uint32_t width, uint32_t height) {
-		VkDeviceSize size = width * height * 4;
-
+	void RayTracer::createImageAndView(VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkFormat format, VkImage& image, Allocation& memory, VkImageView& view, uint32_t width, uint32_t height) {
 		VkImageCreateInfo imageCreateInfo{};
 		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = _swapChain.format;
+		imageCreateInfo.format = format;
 		imageCreateInfo.extent = { width, height, 1 };
 		imageCreateInfo.mipLevels = 1;
 		imageCreateInfo.arrayLayers = 1;
@@ -1378,23 +3681,16 @@ namespace vrt {
 		VkMemoryRequirements memoryRequirements;
 		vkGetImageMemoryRequirements(_logicalDevice, image, &memoryRequirements);
 
-		VkMemoryAllocateInfo memoryAllocateInfo{};
-		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memoryAllocateInfo.allocationSize = memoryRequirements.size;
-		memoryAllocateInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, properties);
+		memory = _allocator.allocate(memoryRequirements, properties, false);
 
-		if (vkAllocateMemory(_logicalDevice, &memoryAllocateInfo, nullptr, &memory) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate the image memory");
-		}
-
-		if (vkBindImageMemory(_logicalDevice, image, memory, 0) != VK_SUCCESS) {
+		if (vkBindImageMemory(_logicalDevice, image, memory.memory, memory.offset) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to bind the image memory");
 		}
 
 		VkImageViewCreateInfo imageViewCreateInfo{};
 		imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		imageViewCreateInfo.format = _swapChain.format;
+		imageViewCreateInfo.format = format;
 		imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
 		imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
 		imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -1407,13 +3703,13 @@ namespace vrt {
 		}
 	}
 
-	void RayTracer::createCubeMap(VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& memory, VkImageView& view, uint32_t width, uint32_t height) {
+	void RayTracer::createCubeMap(VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkFormat format, VkImage& image, Allocation& memory, VkImageView& view, uint32_t size, uint32_t mipLevels) {
 		VkImageCreateInfo imageCreateInfo{};
 		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-		imageCreateInfo.extent = { width, height, 1 };
-		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.format = format;
+		imageCreateInfo.extent = { size, size, 1 };
+		imageCreateInfo.mipLevels = mipLevels;
 		imageCreateInfo.arrayLayers = 6;
 		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -1429,29 +3725,21 @@ namespace vrt {
 		VkMemoryRequirements memoryRequirements{};
 		vkGetImageMemoryRequirements(_logicalDevice, image, &memoryRequirements);
 
-		VkMemoryAllocateInfo memoryAllocateInfo{};
-		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memoryAllocateInfo.allocationSize = memoryRequirements.size;
-		memoryAllocateInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, properties);
+		memory = _allocator.allocate(memoryRequirements, properties, false);
 
-		if (vkAllocateMemory(_logicalDevice, &memoryAllocateInfo, nullptr, &memory) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate sky box image memory!");
-		}
-
-		if (vkBindImageMemory(_logicalDevice, image, memory, 0) != VK_SUCCESS) {
+		if (vkBindImageMemory(_logicalDevice, image, memory.memory, memory.offset) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to bind the sky box image memory");
 		}
 
 		VkImageViewCreateInfo imageViewCreateInfo{};
 		imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-		imageViewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		imageViewCreateInfo.format = format;
 		imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
 		imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
 		imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
 		imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-		imageViewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-		imageViewCreateInfo.subresourceRange.layerCount = 6;
+		imageViewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 6 };
 		imageViewCreateInfo.image = image;
 
 		if (vkCreateImageView(_logicalDevice, &imageViewCreateInfo, nullptr, &view) != VK_SUCCESS) {
@@ -1479,45 +3767,529 @@ namespace vrt {
 		submitCommandBuffers(_graphics.commandPool, _graphics.queue, &layoutCommandBuffer);
 	}
 
-	void RayTracer::createStorageBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& bufferMemory, void* data) {
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-
-		createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size, stagingBuffer, stagingBufferMemory);
+	RayTracer::UploadHandle RayTracer::createStorageBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceSize size, VkBuffer& buffer, Allocation& bufferMemory, const void* data) {
 		createBuffer(usage, properties, size, buffer, bufferMemory);
 
-		void* dataPointer;
-		vkMapMemory(_logicalDevice, stagingBufferMemory, 0, size, 0, &dataPointer);
-		memcpy(dataPointer, data, (size_t)size);
-		vkUnmapMemory(_logicalDevice, stagingBufferMemory);
+		return uploadBuffer(buffer, data, size);
+	}
 
-		VkCommandBuffer copyCommandBuffer;
-		createCommandBuffers(_graphics.commandPool, &copyCommandBuffer);
+	RayTracer::UploadHandle RayTracer::uploadBuffer(VkBuffer buffer, const void* data, VkDeviceSize size, VkDeviceSize bufferOffset, uint64_t handoverValue) {
+		UploadHandle upload{ _transfer.submittedValue };
+
+		// Chunks take successive regions of the arena, so several copies are queued back to back
+		for (VkDeviceSize offset = 0; offset < size; offset += STAGING_CHUNK_SIZE) {
+			VkDeviceSize chunkSize = std::min(STAGING_CHUNK_SIZE, size - offset);
+
+			StagingRegion staging = acquireStagingRegion(chunkSize);
+			memcpy(staging.handle, static_cast<const char*>(data) + offset, static_cast<size_t>(chunkSize));
 
-		VkBufferCopy bufferCopy{};
-		bufferCopy.size = size;
+			VkCommandBuffer copyCommandBuffer;
+			createCommandBuffers(_transfer.commandPool, &copyCommandBuffer);
 
-		vkCmdCopyBuffer(copyCommandBuffer, stagingBuffer, buffer, 1, &bufferCopy);
-		submitCommandBuffers(_graphics.commandPool, _graphics.queue, &copyCommandBuffer);
+			// Only the first chunk waits for the handover, the following ones are submitted after it on the same queue
+			if (offset == 0 && handoverValue > 0) {
+				acquireBuffer(copyCommandBuffer, buffer);
+			}
+
+			VkBufferCopy bufferCopy{};
+			bufferCopy.srcOffset = staging.offset;
+			bufferCopy.dstOffset = bufferOffset + offset;
+			bufferCopy.size = chunkSize;
+
+			vkCmdCopyBuffer(copyCommandBuffer, _transfer.stagingBuffer, buffer, 1, &bufferCopy);
+
+			// The release covers the previous chunks as well, they were submitted earlier on the same queue
+			if (offset + chunkSize == size) {
+				releaseBuffer(copyCommandBuffer, buffer);
+			}
+
+			upload = submitTransfer(copyCommandBuffer, staging, offset == 0 ? handoverValue : 0);
+		}
 
-		vkFreeMemory(_logicalDevice, stagingBufferMemory, nullptr);
-		vkDestroyBuffer(_logicalDevice, stagingBuffer, nullptr);
+		return upload;
 	}
 
-	void RayTracer::loadShaderModule(const char* path, VkShaderModule& shaderModule) {
-		std::ifstream file(path, std::ios::ate | std::ios::binary);
+	RayTracer::UploadHandle RayTracer::streamBuffer(VkBuffer buffer, VkDeviceSize bufferOffset, const void* data, VkDeviceSize size) {
+		if (size == 0) {
+			return { _transfer.submittedValue };
+		}
 
-		if (!file.is_open()) {
-			throw std::runtime_error("Failed to read the shader file");
+		// The history was traced with the previous objects
+		resetAccumulation();
+
+		return uploadBuffer(buffer, data, size, bufferOffset, handOverBuffer(buffer));
+	}
+
+	// The compute queue owns the scene buffers once the frames acquired them. An empty submission on it signals the
+	// handover timeline after the frames submitted so far, so the copy cannot overwrite what they still read. With
+	// two families, it also releases the buffer to the transfer queue, after acquiring it first when an upload
+	// released it and no frame was submitted since.
+	uint64_t RayTracer::handOverBuffer(VkBuffer buffer) {
+		uint64_t value = _transfer.handoverValue + 1;
+		uint64_t transferValue = _transfer.submittedValue;
+		bool waitsForTransfer = false;
+
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+		if (_queueFamilyIndices.transfer != _queueFamilyIndices.compute) {
+			createCommandBuffers(_compute.commandPool, &commandBuffer);
+
+			auto acquire = std::find_if(_transfer.bufferAcquires.begin(), _transfer.bufferAcquires.end(), [&](const VkBufferMemoryBarrier& barrier) {
+				return barrier.buffer == buffer;
+			});
+
+			if (acquire != _transfer.bufferAcquires.end()) {
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &*acquire, 0, nullptr);
+
+				_transfer.bufferAcquires.erase(acquire);
+				waitsForTransfer = true;
+			}
+
+			// The frames read the buffer in their dispatches, and write it with the copies of the object updates
+			VkBufferMemoryBarrier bufferMemoryBarrier{};
+			bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferMemoryBarrier.dstAccessMask = 0;
+			bufferMemoryBarrier.srcQueueFamilyIndex = _queueFamilyIndices.compute;
+			bufferMemoryBarrier.dstQueueFamilyIndex = _queueFamilyIndices.transfer;
+			bufferMemoryBarrier.buffer = buffer;
+			bufferMemoryBarrier.offset = 0;
+			bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to record the handover command buffer");
+			}
+		}
+
+		VkPipelineStageFlags transferWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineSubmitInfo.waitSemaphoreValueCount = waitsForTransfer ? 1 : 0;
+		timelineSubmitInfo.pWaitSemaphoreValues = &transferValue;
+		timelineSubmitInfo.signalSemaphoreValueCount = 1;
+		timelineSubmitInfo.pSignalSemaphoreValues = &value;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineSubmitInfo;
+		submitInfo.commandBufferCount = commandBuffer != VK_NULL_HANDLE ? 1 : 0;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &_transfer.handoverTimeline;
+
+		if (waitsForTransfer) {
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &_transfer.timeline;
+			submitInfo.pWaitDstStageMask = &transferWaitStage;
+		}
+
+		if (vkQueueSubmit(_compute.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit the buffer handover");
+		}
+
+		_transfer.handoverValue = value;
+
+		if (commandBuffer != VK_NULL_HANDLE) {
+			_transfer.handovers.push_back({ value, commandBuffer });
+		}
+
+		return value;
+	}
+
+	RayTracer::StagingRegion RayTracer::acquireStagingRegion(VkDeviceSize size) {
+		if (size > STAGING_ARENA_SIZE) {
+			throw std::runtime_error("The upload does not fit in the staging arena");
+		}
+
+		collectUploads();
+
+		StagingRegion staging{};
+		staging.size = size;
+
+		while (!reserveStagingRegion(size, staging.offset)) {
+			waitForUpload({ _transfer.pending.front().value });
+		}
+
+		staging.handle = static_cast<uint8_t*>(_transfer.stagingMemory.handle) + staging.offset;
+
+		return staging;
+	}
+
+	// The regions are released in submission order, so the arena is a ring going from the region of the oldest
+	// pending upload to the head. Head and tail only meet when the ring is full.
+	bool RayTracer::reserveStagingRegion(VkDeviceSize size, VkDeviceSize& offset) {
+		VkDeviceSize head = _transfer.stagingHead;
+
+		if (_transfer.pending.empty()) {
+			offset = 0;
+		} else {
+			VkDeviceSize tail = _transfer.pending.front().staging.offset;
+
+			if (head > tail && head + size <= STAGING_ARENA_SIZE) {
+				offset = head;
+			} else if (head > tail && size < tail) {
+				offset = 0;
+			} else if (head < tail && head + size < tail) {
+				offset = head;
+			} else {
+				return false;
+			}
+		}
+
+		_transfer.stagingHead = (offset + size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+
+		return true;
+	}
+
+	RayTracer::UploadHandle RayTracer::submitTransfer(VkCommandBuffer commandBuffer, const StagingRegion& staging, uint64_t handoverValue) {
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record the transfer command buffer");
+		}
+
+		uint64_t value = _transfer.submittedValue + 1;
+		VkPipelineStageFlags handoverWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+		VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineSubmitInfo.waitSemaphoreValueCount = handoverValue > 0 ? 1 : 0;
+		timelineSubmitInfo.pWaitSemaphoreValues = &handoverValue;
+		timelineSubmitInfo.signalSemaphoreValueCount = 1;
+		timelineSubmitInfo.pSignalSemaphoreValues = &value;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineSubmitInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &_transfer.timeline;
+
+		if (handoverValue > 0) {
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &_transfer.handoverTimeline;
+			submitInfo.pWaitDstStageMask = &handoverWaitStage;
+		}
+
+		if (vkQueueSubmit(_transfer.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit the transfer job");
+		}
+
+		_transfer.submittedValue = value;
+		_transfer.pending.push_back({ value, commandBuffer, staging });
+
+		return { value };
+	}
+
+	// Counterpart of the release of handOverBuffer. With a single family, it only orders the copy after the previous
+	// uploads to the buffer, submitted earlier on the transfer queue.
+	void RayTracer::acquireBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer) {
+		bool isSameFamily = _queueFamilyIndices.transfer == _queueFamilyIndices.compute;
+
+		VkBufferMemoryBarrier bufferMemoryBarrier{};
+		bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		bufferMemoryBarrier.srcAccessMask = isSameFamily ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+		bufferMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferMemoryBarrier.srcQueueFamilyIndex = isSameFamily ? VK_QUEUE_FAMILY_IGNORED : _queueFamilyIndices.compute;
+		bufferMemoryBarrier.dstQueueFamilyIndex = isSameFamily ? VK_QUEUE_FAMILY_IGNORED : _queueFamilyIndices.transfer;
+		bufferMemoryBarrier.buffer = buffer;
+		bufferMemoryBarrier.offset = 0;
+		bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+	}
+
+	// When the transfer family differs from the compute one, the copy queue releases the resource and the matching
+	// acquire barrier is recorded on the compute queue by the next frame, after its wait on the timeline
+	void RayTracer::releaseBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer) {
+		if (_queueFamilyIndices.transfer == _queueFamilyIndices.compute) {
+			return;
+		}
+
+		VkBufferMemoryBarrier bufferMemoryBarrier{};
+		bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferMemoryBarrier.dstAccessMask = 0;
+		bufferMemoryBarrier.srcQueueFamilyIndex = _queueFamilyIndices.transfer;
+		bufferMemoryBarrier.dstQueueFamilyIndex = _queueFamilyIndices.compute;
+		bufferMemoryBarrier.buffer = buffer;
+		bufferMemoryBarrier.offset = 0;
+		bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+
+		// The storage buffers are read by the dispatches and overwritten by the object updates
+		bufferMemoryBarrier.srcAccessMask = 0;
+		bufferMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		_transfer.bufferAcquires.push_back(bufferMemoryBarrier);
+	}
+
+	// The layout transition is part of the release, a single family only needs the transition itself
+	void RayTracer::releaseImage(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t levelCount, uint32_t layerCount) {
+		bool isSameFamily = _queueFamilyIndices.transfer == _queueFamilyIndices.compute;
+
+		VkImageMemoryBarrier imageMemoryBarrier{};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.oldLayout = oldLayout;
+		imageMemoryBarrier.newLayout = newLayout;
+		imageMemoryBarrier.srcQueueFamilyIndex = isSameFamily ? VK_QUEUE_FAMILY_IGNORED : _queueFamilyIndices.transfer;
+		imageMemoryBarrier.dstQueueFamilyIndex = isSameFamily ? VK_QUEUE_FAMILY_IGNORED : _queueFamilyIndices.compute;
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, layerCount };
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = 0;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+		if (!isSameFamily) {
+			imageMemoryBarrier.srcAccessMask = 0;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			_transfer.imageAcquires.push_back(imageMemoryBarrier);
+		}
+	}
+
+	void RayTracer::recordAcquireCommandBuffer(uint32_t frameIndex) {
+		VkCommandBuffer commandBuffer = _transfer.acquireCommandBuffers[frameIndex];
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		VkCommandBufferBeginInfo commandBufferBeginInfo{};
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin the recording of the acquire command buffer");
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			0, nullptr,
+			static_cast<uint32_t>(_transfer.bufferAcquires.size()), _transfer.bufferAcquires.data(),
+			static_cast<uint32_t>(_transfer.imageAcquires.size()), _transfer.imageAcquires.data());
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record the acquire command buffer");
+		}
+	}
+
+	bool RayTracer::isUploadComplete(UploadHandle upload) const {
+		uint64_t completedValue;
+		vkGetSemaphoreCounterValue(_logicalDevice, _transfer.timeline, &completedValue);
+
+		return completedValue >= upload.value;
+	}
+
+	void RayTracer::waitForUpload(UploadHandle upload) {
+		VkSemaphoreWaitInfo semaphoreWaitInfo{};
+		semaphoreWaitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		semaphoreWaitInfo.semaphoreCount = 1;
+		semaphoreWaitInfo.pSemaphores = &_transfer.timeline;
+		semaphoreWaitInfo.pValues = &upload.value;
+
+		if (vkWaitSemaphores(_logicalDevice, &semaphoreWaitInfo, UINT64_MAX) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to wait for the transfer timeline");
+		}
+
+		collectUploads();
+	}
+
+	void RayTracer::collectUploads() {
+		uint64_t completedValue;
+		vkGetSemaphoreCounterValue(_logicalDevice, _transfer.timeline, &completedValue);
+
+		auto completed = _transfer.pending.begin();
+
+		for (; completed != _transfer.pending.end() && completed->value <= completedValue; completed++) {
+			vkFreeCommandBuffers(_logicalDevice, _transfer.commandPool, 1, &completed->commandBuffer);
+		}
+
+		_transfer.pending.erase(_transfer.pending.begin(), completed);
+
+		uint64_t handedOverValue;
+		vkGetSemaphoreCounterValue(_logicalDevice, _transfer.handoverTimeline, &handedOverValue);
+
+		auto handedOver = _transfer.handovers.begin();
+
+		for (; handedOver != _transfer.handovers.end() && handedOver->value <= handedOverValue; handedOver++) {
+			vkFreeCommandBuffers(_logicalDevice, _compute.commandPool, 1, &handedOver->commandBuffer);
+		}
+
+		_transfer.handovers.erase(_transfer.handovers.begin(), handedOver);
+	}
+
+	// Any mismatch or read error leaves the cache empty, the pipelines are then compiled from scratch and the file is rewritten
+	void RayTracer::createPipelineCache() {
+		_pipelineCache.loadedSize = 0;
+		_pipelineCache.path.clear();
+
+		std::vector<char> data;
+
+		if (_options.cacheDirectory != nullptr) {
+			PipelineCacheFileHeader expected = createPipelineCacheHeader(_physicalDevice);
+
+			// One file per device, so the nodes with several GPUs do not overwrite each other
+			char fileName[64];
+			snprintf(fileName, sizeof(fileName), "pipeline_cache_%04x_%04x.bin", expected.vendorID, expected.deviceID);
+			_pipelineCache.path = (std::filesystem::path(_options.cacheDirectory) / fileName).string();
+
+			std::ifstream file(_pipelineCache.path, std::ios::binary);
+			PipelineCacheFileHeader header{};
+
+			if (file.read(reinterpret_cast<char*>(&header), sizeof(PipelineCacheFileHeader)) && header.dataSize < (1ull << 32)) {
+				expected.dataSize = header.dataSize;
+
+				if (memcmp(&header, &expected, sizeof(PipelineCacheFileHeader)) == 0) {
+					data.resize(static_cast<size_t>(header.dataSize));
+
+					if (!file.read(data.data(), static_cast<std::streamsize>(data.size()))) {
+						data.clear();
+					}
+				}
+			}
+		}
+
+		VkPipelineCacheCreateInfo pipelineCacheCreateInfo{};
+		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		pipelineCacheCreateInfo.initialDataSize = data.size();
+		pipelineCacheCreateInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+		// The driver validates its own header too, a rejected blob is retried with an empty cache
+		if (vkCreatePipelineCache(_logicalDevice, &pipelineCacheCreateInfo, nullptr, &_pipelineCache.cache) == VK_SUCCESS) {
+			_pipelineCache.loadedSize = data.size();
+
+			return;
+		}
+
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = nullptr;
+
+		if (vkCreatePipelineCache(_logicalDevice, &pipelineCacheCreateInfo, nullptr, &_pipelineCache.cache) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create the pipeline cache");
+		}
+	}
+
+	// Written to a file of its own next to the final one then renamed, so concurrent processes never read or write
+	// a partial cache
+	void RayTracer::savePipelineCache() {
+		if (_pipelineCache.path.empty()) {
+			return;
+		}
+
+		size_t dataSize;
+		vkGetPipelineCacheData(_logicalDevice, _pipelineCache.cache, &dataSize, nullptr);
+
+		if (dataSize == 0 || dataSize == _pipelineCache.loadedSize) {
+			return;
+		}
+
+		std::vector<char> data(dataSize);
+
+		if (vkGetPipelineCacheData(_logicalDevice, _pipelineCache.cache, &dataSize, data.data()) != VK_SUCCESS) {
+			return;
+		}
+
+		PipelineCacheFileHeader header = createPipelineCacheHeader(_physicalDevice);
+		header.dataSize = dataSize;
+
+		// A cache which cannot be written only costs the compilation time of the next start
+		std::error_code error;
+		std::filesystem::create_directories(_options.cacheDirectory, error);
+
+		std::string temporaryPath = getTemporaryPath(_pipelineCache.path);
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(PipelineCacheFileHeader));
+		file.write(data.data(), static_cast<std::streamsize>(dataSize));
+		file.close();
+
+		if (file.good()) {
+			std::filesystem::rename(temporaryPath, _pipelineCache.path, error);
+		}
+
+		if (!file.good() || error) {
+			std::filesystem::remove(temporaryPath, error);
+		}
+	}
+
+	bool RayTracer::isWorkgroupSizeSupported(VkExtent2D workgroupSize) const {
+		VkPhysicalDeviceProperties physicalDeviceProperties;
+		vkGetPhysicalDeviceProperties(_physicalDevice, &physicalDeviceProperties);
+
+		const VkPhysicalDeviceLimits& limits = physicalDeviceProperties.limits;
+
+		return workgroupSize.width > 0 && workgroupSize.height > 0 &&
+			workgroupSize.width <= limits.maxComputeWorkGroupSize[0] &&
+			workgroupSize.height <= limits.maxComputeWorkGroupSize[1] &&
+			workgroupSize.width * workgroupSize.height <= limits.maxComputeWorkGroupInvocations;
+	}
+
+	// One file per device, like the pipeline cache, empty when the cache is disabled
+	std::string RayTracer::getWorkgroupSizeCachePath() const {
+		if (_options.cacheDirectory == nullptr) {
+			return {};
+		}
+
+		PipelineCacheFileHeader header = createPipelineCacheHeader(_physicalDevice);
+
+		char fileName[64];
+		snprintf(fileName, sizeof(fileName), "workgroup_size_%04x_%04x.txt", header.vendorID, header.deviceID);
+
+		return (std::filesystem::path(_options.cacheDirectory) / fileName).string();
+	}
+
+	// A missing file, or a shape the device does not support, gives the default shape
+	VkExtent2D RayTracer::loadWorkgroupSize() const {
+		std::string path = getWorkgroupSizeCachePath();
+
+		if (!path.empty()) {
+			std::ifstream file(path);
+			VkExtent2D workgroupSize{};
+
+			if (file >> workgroupSize.width >> workgroupSize.height && isWorkgroupSizeSupported(workgroupSize)) {
+				return workgroupSize;
+			}
 		}
 
-		size_t fileSize = (size_t)file.tellg();
-		std::vector<char> shaderCode(fileSize);
+		return DEFAULT_WORKGROUP_SIZE;
+	}
+
+	void RayTracer::saveWorkgroupSize() const {
+		std::string path = getWorkgroupSizeCachePath();
+
+		if (path.empty()) {
+			return;
+		}
 
-		file.seekg(0);
-		file.read(shaderCode.data(), fileSize);
+		std::error_code error;
+		std::filesystem::create_directories(_options.cacheDirectory, error);
+
+		std::string temporaryPath = getTemporaryPath(path);
+		std::ofstream file(temporaryPath, std::ios::trunc);
+
+		file << _compute.workgroupSize.width << " " << _compute.workgroupSize.height << "\n";
 		file.close();
 
+		if (file.good()) {
+			std::filesystem::rename(temporaryPath, path, error);
+		}
+
+		if (!file.good() || error) {
+			std::filesystem::remove(temporaryPath, error);
+		}
+	}
+
+	// Uses the code read by the asset loading tasks when there is one
+	void RayTracer::loadShaderModule(const char* path, VkShaderModule& shaderModule) {
+		std::vector<char> shaderCode;
+		auto prefetched = _assets.shaderCodes.find(path);
+
+		if (prefetched != _assets.shaderCodes.end() && !prefetched->second.empty()) {
+			shaderCode = std::move(prefetched->second);
+			_assets.shaderCodes.erase(prefetched);
+		} else if (!readBinaryFile(path, shaderCode)) {
+			throw std::runtime_error("Failed to read the shader file");
+		}
+
 		VkShaderModuleCreateInfo shaderModuleCreateInfo{};
 		shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 		shaderModuleCreateInfo.codeSize = shaderCode.size();
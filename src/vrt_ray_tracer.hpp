@@ -1,38 +1,128 @@
 #ifndef __VULKAN_RAY_TRACING_RAY_TRACER_HPP__
 #define __VULKAN_RAY_TRACING_RAY_TRACER_HPP__
 
-#include "vrt_window.hpp"
-
-#include <glm/glm.hpp>
-
+#include "vrt_surface_provider.hpp"
+#include "vrt_memory.hpp"
+#include "vrt_scene.hpp"
+#include "vrt_scene_file.hpp"
+#include "vrt_sky_box.hpp"
+#include "vrt_statistics.hpp"
+#include "vrt_thread_pool.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace vrt {
-	struct Settings {
-		alignas(16) glm::mat4 projection;
-		alignas(16) glm::mat4 transform;
-		alignas(16) glm::vec4 directionalLight;
+	// GPU time of one ray tracing dispatch with a given workgroup shape, as measured by tuneWorkgroupSize
+	struct WorkgroupTiming {
+		VkExtent2D size;
+		double time;
+	};
+
+	// Filter rendering.frag applies when the target texture is smaller than the swap chain
+	enum class UpscalingFilter : uint32_t {
+		Bilinear = 0,
+
+		// Lanczos 2 whose taps are weighted down when their luminance differs from the bilinear estimate, so the
+		// edges are not blurred across, then clamped to the four nearest texels to remove the ringing
+		EdgeAware = 1
+	};
+
+	struct Options {
+		// Number of frames the CPU may record and submit ahead of the GPU, each one owns its target
+		// texture, settings buffer, command buffers and synchronization primitives.
+		uint32_t framesInFlight = 2;
+
+		// Anti-aliasing samples traced per pixel, baked into the compute pipeline as a specialization constant
+		uint32_t samplesPerPixel = 2;
+
+		// Reflections traced per sample, also a specialization constant
+		uint32_t maxBounces = 5;
+
+		// Shape of the ray tracing workgroups. Zero picks the shape tuned for the device when the cache holds one,
+		// 16x16 otherwise.
+		VkExtent2D workgroupSize = { 0, 0 };
+
+		// Traces with separate kernels connected by ray queues instead of the ray_tracing.comp megakernel: the
+		// camera rays are generated, then each bounce finds the closest hits, shades them and casts the shadow
+		// rays, every kernel running only the rays still alive. Requires subgroup ballots in compute shaders.
+		bool wavefront = false;
+
+		// Ratio between the resolution the rays are traced at and the swap chain extent, in (0, 1]. The target
+		// texture is upscaled when presenting. Ignored in headless mode, where the given extent is traced as is.
+		float renderScale = 1.0f;
+		UpscalingFilter upscalingFilter = UpscalingFilter::EdgeAware;
+
+		// GPU time budget of a frame in milliseconds, zero disables the dynamic resolution. When set, the part of
+		// the target texture traced is resized after every frame, between minRenderScale and renderScale, so the
+		// ray tracing and the fullscreen pass fit in it. Requires timestamp support, ignored in headless mode.
+		float frameTimeBudget = 0.0f;
+		float minRenderScale = 0.5f;
+
+		// Size of the persistently mapped ring holding the object updates, split evenly between the frames in flight
+		VkDeviceSize uploadRingSize = 8 * 1024 * 1024;
+
+		// Directory the compiled pipelines and the converted sky box are cached in between runs, created when
+		// missing. Null disables both caches.
+		const char* cacheDirectory = "cache";
+	};
+
+	struct TiledRenderOptions {
+		// Extent of the whole frame, which may exceed the target texture
+		uint32_t width = 0;
+		uint32_t height = 0;
 
-		alignas(16) float angle;
+		// Side of the square tiles, clamped to the target texture. Each pass of a tile is a submission of its own,
+		// so smaller tiles bound the time the GPU spends on one.
+		uint32_t tileSize = 256;
+
+		// Frames accumulated on every tile before it is read back
+		uint32_t passCount = 1;
+
+		// Part of the frame rendered, the whole frame when its extent is zero
+		VkRect2D region = { { 0, 0 }, { 0, 0 } };
 	};
 
-	struct Sphere {
-		glm::vec3 position;
-		float radius;
-		glm::vec3 albedo;
-		alignas(16) glm::vec3 specular;
+	// Part of the frame handed to the callback of RayTracer::renderTiled, at its position in the frame
+	struct RenderedTile {
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+
+		// Tightly packed RGBA8 rows, only valid during the callback
+		const uint8_t* pixels;
 	};
 
-	struct Plane {
-		alignas(16) glm::vec3 position;
-		alignas(16) glm::vec3 normal;
-		alignas(16) glm::vec3 albedo;
-		alignas(16) glm::vec3 specular;
+	// Frame copied back by the capture, handed to the callback of RayTracer::setFrameCapture
+	struct CapturedFrame {
+		// Counts the frames captured since the capture started
+		uint64_t index;
+		uint32_t width;
+		uint32_t height;
+
+		// Tightly packed RGBA8 rows, only valid during the callback
+		const uint8_t* pixels;
 	};
 
 	class RayTracer {
 	public:
-		RayTracer(Window& window);
+		// Value the transfer timeline reaches once a group of copies has completed
+		struct UploadHandle {
+			uint64_t value;
+		};
+
+	public:
+		RayTracer(SurfaceProvider& surfaceProvider, const Scene& scene, const Options& options = {});
+		RayTracer(uint32_t width, uint32_t height, const Scene& scene, const Options& options = {});
+
+		// The arrays of the file are streamed from its mapping to the GPU, the file can be closed afterwards.
+		RayTracer(SurfaceProvider& surfaceProvider, const SceneFile& sceneFile, const Options& options = {});
+		RayTracer(uint32_t width, uint32_t height, const SceneFile& sceneFile, const Options& options = {});
 		~RayTracer();
 
 		RayTracer(RayTracer&) = delete;
@@ -41,20 +131,172 @@ namespace vrt {
 		void drawFrame();
 		void updateSettings(Settings& settings);
 
+		// Replace a range of objects. The values are staged in the upload ring and copied at the start of the next
+		// frame, then stay visible to the following ones. The BVH is not refitted, the spheres have to stay within
+		// the bounds it was built with, or Settings::useBvh has to be disabled. The materials the objects reference
+		// have to exist, the table keeps the size it was created with. The accumulated history is discarded.
+		void updateSpheres(uint32_t first, const Sphere* spheres, uint32_t count);
+		void updatePlanes(uint32_t first, const Plane* planes, uint32_t count);
+		void updateMaterials(uint32_t first, const Material* materials, uint32_t count);
+
+		// Same as the updates, but copied on the transfer queue instead of in the next frame, for large batches
+		// streamed while rendering. The copy waits on the GPU for the frames already submitted to stop reading the
+		// buffer, and the next frame waits for the copy, so the CPU never blocks. The updates queued for the next
+		// frame are applied after it. The values are staged before returning, the handle only has to be waited on
+		// to know the scene buffer holds them.
+		UploadHandle uploadSpheres(uint32_t first, const Sphere* spheres, uint32_t count);
+		UploadHandle uploadPlanes(uint32_t first, const Plane* planes, uint32_t count);
+		UploadHandle uploadMaterials(uint32_t first, const Material* materials, uint32_t count);
+
+		bool isUploadComplete(UploadHandle upload) const;
+		void waitForUpload(UploadHandle upload);
+
+		// When enabled, frames are averaged with the previous ones as long as the camera, the light and the scene
+		// do not move. The history is discarded automatically when the settings change, or by calling resetAccumulation.
+		void setAccumulationEnabled(bool enabled);
+		void resetAccumulation();
+		bool isAccumulationEnabled() const { return _accumulation.enabled; }
+		uint32_t getAccumulatedFrameCount() const { return _accumulation.frameCount; }
+
+		// Times the ray tracing dispatch with every candidate workgroup shape the device supports, using the
+		// current settings, then switches to the fastest one and caches it for the device. Waits for the GPU to
+		// go idle and resets the accumulation. The uploads and object updates pending are applied first, so the shapes
+		// are timed on the current scene. Requires timestamp support, and the megakernel.
+		std::vector<WorkgroupTiming> tuneWorkgroupSize();
+		VkExtent2D getWorkgroupSize() const { return _compute.workgroupSize; }
+
+		// Headless only: waits for the last submitted frame and copies it as tightly packed RGBA8 rows.
+		void readFrame(std::vector<uint8_t>& pixels);
+
+		// Headless only: traces a frame of any extent tile by tile, through the frame slots, and hands every tile to
+		// the callback in order as soon as its last pass completed, while the following ones are traced. The
+		// accumulation is reset afterwards.
+		void renderTiled(const TiledRenderOptions& tiledOptions, const std::function<void(const RenderedTile&)>& onTile);
+
+		// Copies every frame drawn from then on to a host visible buffer of its frame slot, in the same submission as
+		// the frame. The copy is handed to the callback when the slot comes around again, after the fence drawFrame
+		// waits on anyway, so the capture never stalls the render loop. The callback should only copy the pixels and
+		// leave the encoding to a FrameWriter. An empty callback stops the capture, the frames in flight are handed
+		// out first.
+		void setFrameCapture(std::function<void(const CapturedFrame&)> callback);
+
+		// Waits for the frames captured and still in flight, and hands them to the callback
+		void flushCapture();
+
+		// Time spent in each step of the construction, and until the first frame was submitted
+		const StartupStatistics& getStartupStatistics() const { return _startup.statistics; }
+
+		// Blocks allocated from the device and the bytes bound to resources out of them
+		MemoryStatistics getMemoryStatistics() const { return _allocator.getStatistics(); }
+
+		// Rolling timings of the last frames: GPU time of the compute dispatch and of the fullscreen pass,
+		// CPU time spent in drawFrame once the frame slot is free, and interval between two presentations.
+		FrameStatistics getFrameStatistics() const;
+
+		bool isHeadless() const { return _surfaceProvider == nullptr; }
+		const char* getDeviceName() const { return _deviceName; }
+
+		// Resolution the rays are traced at, and the one frames are presented at, equal in headless mode
+		VkExtent2D getExtent() const { return _resolution.extent; }
+		VkExtent2D getOutputExtent() const { return isHeadless() ? _targetTexture.extent : _swapChain.extent; }
+
+		// Fraction of the output traced, follows the frame time budget when one is set
+		float getRenderScale() const { return _resolution.scale; }
+
 	private:
+		// Source of a copy in the staging arena, recycled once the transfer timeline reaches the value of its upload
+		struct StagingRegion {
+			VkDeviceSize offset;
+			VkDeviceSize size;
+			void* handle;
+		};
+
+		struct PendingUpload {
+			uint64_t value;
+			VkCommandBuffer commandBuffer;
+			StagingRegion staging;
+		};
+
+		// Compute command buffer which released a buffer to the transfer queue, freed once the handover timeline
+		// reaches its value
+		struct PendingHandover {
+			uint64_t value;
+			VkCommandBuffer commandBuffer;
+		};
+
+		// Part of the target texture a compute command buffer traces, in its top left corner, and where it lies in
+		// the frame the camera covers
+		struct TraceRegion {
+			VkExtent2D extent;
+			VkOffset2D offset;
+			VkExtent2D frameExtent;
+		};
+
+	private:
+		void initialize(const Scene& scene);
+		void initialize(const SceneData& scene);
+
+		void startAssetLoading();
+		void joinAssetLoading();
+		void recordStartupStage(const char* name);
+		double getStartupTime() const;
+
 		void createInstance();
 		void createDevice();
 		void createCommandPools();
-		void createSwapChain();
+		void createTransferResources();
+		void createQueryPool();
+		void createSwapChain(VkSwapchainKHR oldSwapChain);
+		void createRenderPass();
+		void createFrameBuffers();
+		void createSampler();
 		void createTargetTexture();
 		void createSkyBox();
-		void createStorageBuffers();
+		void createStorageBuffers(const SceneData& scene);
 		void createDescriptorSets();
 		void createGraphicsPipeline();
 		void createComputePipeline();
+		void createRayTracingPipeline(VkShaderModule shaderModule, VkExtent2D workgroupSize, VkPipeline& pipeline);
+		void createWavefrontPipelines();
+		void createWavefrontBuffers();
+		void destroyWavefrontBuffers();
 		void createDrawCommandBuffers();
-		void createComputeCommandBuffer();
+		void createComputeCommandBuffers();
 		void createSemaphoresAndFences();
+		void createRenderSemaphores();
+		void createReadbackBuffer();
+		void createUploadRing();
+
+		// Rebuilds what depends on the size of the window once the device is idle. Returns false while the window
+		// is minimized, the swap chain stays out of date until then.
+		bool recreateSwapChain();
+		void destroySwapChainResources();
+		void destroyTargetTexture();
+		void writeTargetDescriptorSets();
+		void releaseTargetTexturesToCompute();
+
+		VkExtent2D getScaledExtent(float scale) const;
+		void updateRenderScale(uint32_t frameIndex, double computeTime, double renderTime);
+
+		void updateAccumulation();
+		void checkSpheres(uint32_t first, const Sphere* spheres, uint32_t count) const;
+		void checkPlanes(uint32_t first, const Plane* planes, uint32_t count) const;
+		void checkMaterials(uint32_t first, uint32_t count) const;
+		void* reserveUpload(std::vector<VkBufferCopy>& regions, VkDeviceSize offset, VkDeviceSize size);
+		void recordUploadCommandBuffer(uint32_t frameIndex);
+		void recordBufferCopies(VkCommandBuffer commandBuffer, VkBuffer buffer, std::vector<VkBufferCopy>& regions);
+		void recordAcquireCommandBuffer(uint32_t frameIndex);
+		void recordComputeCommandBuffer(uint32_t frameIndex);
+		void recordComputeCommandBuffer(uint32_t frameIndex, const TraceRegion& region);
+		void recordWavefrontDispatches(VkCommandBuffer commandBuffer, const TraceRegion& region);
+		void recordReadback(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkBuffer buffer, VkExtent2D extent);
+		void submitComputeFrame(uint32_t frameIndex, VkCommandBuffer readbackCommandBuffer);
+		void prepareCapture(uint32_t frameIndex);
+		void deliverCapture(uint32_t frameIndex);
+		VkDeviceSize getWavefrontCounterOffset(uint32_t sample, uint32_t bounce, bool isShadow) const;
+		void recordDrawCommandBuffer(uint32_t frameIndex, uint32_t imageIndex);
+		void readTimestamps(uint32_t frameIndex);
+		void recordFrameTimes(std::chrono::steady_clock::time_point frameStart);
 
 		uint8_t getPhysicalDeviceQuality(VkPhysicalDevice physicalDevice);
 
@@ -66,17 +308,39 @@ namespace vrt {
 		VkPresentModeKHR selectPresentMode();
 		VkSurfaceCapabilitiesKHR getSurfaceCapabilities();
 
-		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		std::vector<const char*> getRequiredDeviceExtensions();
 
 		void createCommandBuffers(VkCommandPool commandPool, VkCommandBuffer* commandBuffers, uint32_t commandBufferCount = 1);
 		void submitCommandBuffers(VkCommandPool commandPool, VkQueue queue, VkCommandBuffer* commandBuffers, uint32_t commandBufferCount = 1);
 
-		void createBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& memory);
-		void createImageAndView(VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& memory, VkImageView& view, uint32_t width, uint32_t height);
-		void createCubeMap(VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& memory, VkImageView& view, uint32_t width, uint32_t height);
+		void createBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceSize size, VkBuffer& buffer, Allocation& memory);
+		void createImageAndView(VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkFormat format, VkImage& image, Allocation& memory, VkImageView& view, uint32_t width, uint32_t height);
+		void createCubeMap(VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkFormat format, VkImage& image, Allocation& memory, VkImageView& view, uint32_t size, uint32_t mipLevels);
 		void changeImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout, VkImage image, VkAccessFlags srcAccessMask = 0, VkAccessFlags dstAccessMask = 0, uint32_t layerCount = 1);
 
-		void createStorageBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& bufferMemory, void* data);
+		UploadHandle createStorageBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceSize size, VkBuffer& buffer, Allocation& bufferMemory, const void* data);
+
+		// Copies run on the transfer queue without blocking, the next compute submission waits for them on the GPU
+		// and acquires the resources they wrote. A buffer the frames already use has to be handed over first, the
+		// copy then waits for the handover value.
+		UploadHandle uploadBuffer(VkBuffer buffer, const void* data, VkDeviceSize size, VkDeviceSize bufferOffset = 0, uint64_t handoverValue = 0);
+		UploadHandle streamBuffer(VkBuffer buffer, VkDeviceSize bufferOffset, const void* data, VkDeviceSize size);
+		uint64_t handOverBuffer(VkBuffer buffer);
+		StagingRegion acquireStagingRegion(VkDeviceSize size);
+		bool reserveStagingRegion(VkDeviceSize size, VkDeviceSize& offset);
+		UploadHandle submitTransfer(VkCommandBuffer commandBuffer, const StagingRegion& staging, uint64_t handoverValue = 0);
+		void acquireBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer);
+		void releaseBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer);
+		void releaseImage(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t levelCount, uint32_t layerCount);
+		void collectUploads();
+
+		void createPipelineCache();
+		void savePipelineCache();
+
+		bool isWorkgroupSizeSupported(VkExtent2D workgroupSize) const;
+		std::string getWorkgroupSizeCachePath() const;
+		VkExtent2D loadWorkgroupSize() const;
+		void saveWorkgroupSize() const;
 
 		void loadShaderModule(const char* path, VkShaderModule& shaderModule);
 
@@ -92,16 +356,110 @@ namespace vrt {
 		static const char* SHADER_VERTEX_PATH;
 		static const char* SHADER_FRAGMENT_PATH;
 		static const char* SHADER_COMPUTE_PATH;
+		static const char* SHADER_ANIMATION_PATH;
+		static const char* SHADER_WAVEFRONT_GENERATE_PATH;
+		static const char* SHADER_WAVEFRONT_EXTEND_PATH;
+		static const char* SHADER_WAVEFRONT_SHADE_PATH;
+		static const char* SHADER_WAVEFRONT_SHADOW_PATH;
+		static const char* SHADER_WAVEFRONT_RESOLVE_PATH;
+
+		static const VkFormat TARGET_TEXTURE_FORMAT;
+		static const VkFormat ACCUMULATION_TEXTURE_FORMAT;
+
+		// Past this count the running mean keeps its weights, the image stops converging but still follows the new samples
+		static const uint32_t MAX_ACCUMULATED_FRAMES;
+
+		// Persistently mapped ring every upload is staged in, a full arena waits for the oldest uploads
+		static const VkDeviceSize STAGING_ARENA_SIZE;
+
+		// Largest copy staged at once, bigger buffers are copied in several chunks
+		static const VkDeviceSize STAGING_CHUNK_SIZE;
+
+		// Offset alignment of the staging regions, enough for any optimalBufferCopyOffsetAlignment in practice
+		static const VkDeviceSize STAGING_ALIGNMENT;
+
+		// Must match local_size_x in animate.comp
+		static const uint32_t ANIMATION_WORKGROUP_SIZE;
+
+		// Must match WAVEFRONT_WORKGROUP_SIZE in wavefront.glsl
+		static const uint32_t WAVEFRONT_WORKGROUP_SIZE;
+
+		static const VkExtent2D DEFAULT_WORKGROUP_SIZE;
+
+		// Shapes tried by tuneWorkgroupSize, the ones beyond the limits of the device are skipped
+		static const std::vector<VkExtent2D> WORKGROUP_SIZE_CANDIDATES;
+
+		// Dispatches timed per shape, interleaved between the shapes, the median is kept
+		static const uint32_t WORKGROUP_TUNING_ROUNDS;
+
+		// Timestamp queries written by each frame: compute begin and end, then render begin and end
+		static const uint32_t TIMESTAMPS_PER_FRAME;
 
-		static const char* SKY_BOX_TEXTURE_PATHS[6];
+		// Weight of the last frame in the smoothed timings the render scale follows
+		static const double RENDER_SCALE_SMOOTHING;
+
+		// Fraction of the frame time budget aimed for, the rest absorbs the noise of the timings
+		static const double RENDER_SCALE_HEADROOM;
+
+		// Smallest change of the render scale applied, the resolution would otherwise change on every frame
+		static const double RENDER_SCALE_STEP;
 
 	private:
-		Window& _window;
+		SurfaceProvider* _surfaceProvider;
+		Options _options;
+
+		uint32_t _currentFrame;
+		uint32_t _lastSubmittedFrame;
 
 		VkInstance _instance;
 		VkSurfaceKHR _surface;
 		VkDevice _logicalDevice;
 		VkPhysicalDevice _physicalDevice;
+		char _deviceName[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE];
+
+		// Every buffer and image is bound to a range of its blocks
+		MemoryAllocator _allocator;
+
+		// Filled by the worker threads started with the construction, joined before the sky box upload
+		struct {
+			// Read from the cache when it matches the source images, assembled from the converted faces otherwise
+			SkyBoxImage skyBox;
+			SkyBoxSources skyBoxSources;
+			bool hasSkyBoxSources;
+			bool isSkyBoxCached;
+
+			// Empty when the cache is disabled
+			std::string skyBoxCachePath;
+
+			// Mip chain of each face, empty when the image could not be decoded
+			std::vector<std::vector<uint8_t>> skyBoxFaces[6];
+			uint32_t skyBoxFaceSizes[6];
+
+			// Keyed by path, empty when the file could not be read
+			std::unordered_map<std::string, std::vector<char>> shaderCodes;
+
+			std::vector<std::chrono::steady_clock::time_point> taskEnds;
+
+			// Declared last so the pool, which drains its tasks, is destroyed before the data they write to
+			std::unique_ptr<ThreadPool> pool;
+		} _assets;
+
+		struct {
+			std::chrono::steady_clock::time_point start;
+			std::chrono::steady_clock::time_point stageStart;
+
+			StartupStatistics statistics;
+		} _startup;
+
+		struct {
+			VkPipelineCache cache;
+
+			// Empty when the cache is disabled
+			std::string path;
+
+			// The file is only rewritten when the pipelines added data to what it held
+			size_t loadedSize;
+		} _pipelineCache;
 
 		VkDescriptorPool _descriptorPool;
 		VkSampler _sampler;
@@ -124,11 +482,18 @@ namespace vrt {
 			VkRenderPass renderPass;
 
 			uint32_t imageCount;
+
+			// Size of the frame buffer the swap chain was created for, a resize is detected when it changes
+			int frameBufferWidth;
+			int frameBufferHeight;
+
+			// Set when the presentation reported it, or when the window was resized
+			bool isOutdated;
 		} _swapChain;
 
 		struct {
 			VkDescriptorSetLayout descriptorSetLayout;
-			VkDescriptorSet descriptorSet;
+			std::vector<VkDescriptorSet> descriptorSets;
 			
 			VkCommandPool commandPool;
 			VkQueue queue;
@@ -141,46 +506,234 @@ namespace vrt {
 
 		struct {
 			VkDescriptorSetLayout descriptorSetLayout;
-			VkDescriptorSet descriptorSet;
+			std::vector<VkDescriptorSet> descriptorSets;
 
 			VkCommandPool commandPool;
 			VkQueue queue;
 
+			// Megakernel, null in wavefront mode
 			VkPipeline pipeline;
 			VkPipelineLayout pipelineLayout;
 
-			VkCommandBuffer commandBuffer;
+			// Runs before the ray tracing dispatch, with the same layout and descriptor sets
+			VkPipeline animationPipeline;
+
+			// Baked into the ray tracing pipeline, the dispatch is rounded up to whole workgroups
+			VkExtent2D workgroupSize;
+
+			std::vector<VkCommandBuffer> commandBuffers;
 		} _compute;
 
 		struct {
+			VkCommandPool commandPool;
+			VkQueue queue;
+
+			// Signaled by every transfer submission with an increasing value
+			VkSemaphore timeline;
+			uint64_t submittedValue;
+
+			// Last value a compute submission waited for, along with the ownership acquisitions up to it
+			uint64_t acquiredValue;
+			std::vector<VkBufferMemoryBarrier> bufferAcquires;
+			std::vector<VkImageMemoryBarrier> imageAcquires;
+			std::vector<VkCommandBuffer> acquireCommandBuffers;
+
+			// Ordered by value, released by collectUploads once completed
+			std::vector<PendingUpload> pending;
+
+			// Signaled by the compute queue when it hands a buffer back for an upload, see handOverBuffer
+			VkSemaphore handoverTimeline;
+			uint64_t handoverValue;
+			std::vector<PendingHandover> handovers;
+
+			VkBuffer stagingBuffer;
+			Allocation stagingMemory;
+			VkDeviceSize stagingHead;
+		} _transfer;
+
+		struct {
+			std::vector<VkImage> images;
+			std::vector<VkImageView> imageViews;
+			std::vector<Allocation> imageDeviceMemories;
+
+			// Allocated for the largest render scale, the frames only trace the top left corner given by _resolution
+			VkExtent2D extent;
+		} _targetTexture;
+
+		struct {
+			// Fraction of the swap chain extent traced, and the resulting extent, always 1 in headless mode
+			float scale;
+			VkExtent2D extent;
+
+			// Extent the compute command buffer of each frame was recorded for, recorded again when it differs.
+			// Zero once the buffer is outdated.
+			std::vector<VkExtent2D> frameExtents;
+
+			// Smoothed GPU time of the ray tracing per pixel and of the fullscreen pass, in milliseconds
+			double computeTimePerPixel;
+			double renderTime;
+		} _resolution;
+
+		// Only created in wavefront mode, with the same layout and descriptor sets as the megakernel
+		struct {
+			VkPipeline generatePipeline;
+			VkPipeline extendPipeline;
+			VkPipeline shadePipeline;
+			VkPipeline shadowPipeline;
+			VkPipeline resolvePipeline;
+
+			// A path per pixel of the target texture, shared by the frames in flight like the accumulation image
+			VkBuffer pathBuffer;
+			Allocation pathMemory;
+
+			VkBuffer hitBuffer;
+			Allocation hitMemory;
+
+			VkBuffer queueBuffer;
+			Allocation queueMemory;
+
+			VkBuffer radianceBuffer;
+			Allocation radianceMemory;
+
+			// Indirect dispatch of the kernel reading each queue, followed by the count of the queue
+			VkBuffer counterBuffer;
+			Allocation counterMemory;
+		} _wavefront;
+
+		struct {
+			bool enabled;
+			uint32_t frameCount;
+			Settings lastSettings;
+
+			// Shared by all the frames in flight, the compute submissions are ordered on a single queue
 			VkImage image;
 			VkImageView imageView;
-			VkDeviceMemory imageDeviceMemory;
-		} _targetTexture;
+			Allocation imageDeviceMemory;
+		} _accumulation;
 
 		struct {
 			VkImage image;
 			VkImageView imageView;
-			VkDeviceMemory imageDeviceMemory;
+			Allocation imageDeviceMemory;
+
+			// Set when the device samples BC1 with linear filtering, the sky box is decompressed otherwise
+			bool isCompressed;
 		} _skyBox;
 
 		struct {
 			VkBuffer sphereBuffer;
-			VkDeviceMemory sphereMemory;
+			Allocation sphereMemory;
+			uint32_t sphereCount;
 
 			VkBuffer planeBuffer;
-			VkDeviceMemory planeMemory;
+			Allocation planeMemory;
+			uint32_t planeCount;
+
+			VkBuffer materialBuffer;
+			Allocation materialMemory;
+			uint32_t materialCount;
+
+			VkBuffer bvhNodeBuffer;
+			Allocation bvhNodeMemory;
+
+			VkBuffer bvhIndexBuffer;
+			Allocation bvhIndexMemory;
+
+			VkBuffer animationBuffer;
+			Allocation animationMemory;
+
+			VkBuffer meshBuffer;
+			Allocation meshMemory;
+
+			VkBuffer meshVertexBuffer;
+			Allocation meshVertexMemory;
+
+			VkBuffer meshIndexBuffer;
+			Allocation meshIndexMemory;
+
+			VkBuffer meshNodeBuffer;
+			Allocation meshNodeMemory;
+
+			// Center and radius of every sphere at the time of the frame, written by the animation pass
+			VkBuffer spherePositionBuffer;
+			Allocation spherePositionMemory;
 
 			Settings settings;
-			VkBuffer settingBuffer;
-			VkDeviceMemory settingMemory;
-			void* settingHandle;
+			std::vector<VkBuffer> settingBuffers;
+			std::vector<Allocation> settingMemories;
+			std::vector<void*> settingHandles;
 		} _scene;
 
 		struct {
-			VkFence computeComplete;
-			VkSemaphore presentComplete;
-			VkSemaphore renderComplete;
+			VkBuffer buffer;
+			Allocation memory;
+			void* handle;
+		} _readback;
+
+		// One buffer per frame slot, grown to the target texture when it gets larger. The extent of a slot is zero
+		// when no frame captured from it is waiting for the callback.
+		struct {
+			std::function<void(const CapturedFrame&)> callback;
+			uint64_t frameCount;
+
+			std::vector<VkBuffer> buffers;
+			std::vector<Allocation> memories;
+			std::vector<VkDeviceSize> sizes;
+			std::vector<VkExtent2D> extents;
+			std::vector<uint64_t> frameIndices;
+
+			// Headless only, the copy is part of the draw command buffer otherwise
+			std::vector<VkCommandBuffer> commandBuffers;
+		} _capture;
+
+		struct {
+			VkBuffer buffer;
+			Allocation memory;
+			uint8_t* handle;
+
+			// Each frame slot owns a segment of the ring, which is only written once the fence of the slot is signaled
+			VkDeviceSize segmentSize;
+			VkDeviceSize segmentUsed;
+			bool segmentAcquired;
+
+			std::vector<VkBufferCopy> sphereRegions;
+			std::vector<VkBufferCopy> planeRegions;
+			std::vector<VkBufferCopy> materialRegions;
+
+			std::vector<VkCommandBuffer> commandBuffers;
+		} _upload;
+
+		struct {
+			bool enabled;
+			float period;
+
+			// Valid bits of the timestamps written on each queue, disabled when either has none
+			uint64_t graphicsMask;
+			uint64_t computeMask;
+
+			VkQueryPool queryPool;
+
+			// Set once a frame slot has written its queries, they are read back when the slot is reused
+			std::vector<bool> written;
+		} _timestamps;
+
+		struct {
+			RollingStatistics computeTime;
+			RollingStatistics renderTime;
+			RollingStatistics submitTime;
+			RollingStatistics presentInterval;
+
+			bool hasPresented;
+			std::chrono::steady_clock::time_point lastPresent;
+		} _statistics;
+
+		struct {
+			std::vector<VkSemaphore> computeComplete;
+			std::vector<VkSemaphore> presentComplete;
+			std::vector<VkFence> frameComplete;
+
+			// Waited on by the presentation engine, so indexed by swap chain image rather than by frame
+			std::vector<VkSemaphore> renderComplete;
 		} _sync;
 	};
 }
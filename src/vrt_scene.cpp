@@ -0,0 +1,151 @@
+#include "vrt_scene.hpp"
+
+#include <array>
+#include <cmath>
+#include <map>
+#include <random>
+
+namespace vrt {
+	const char* SKY_BOX_TEXTURE_PATHS[6] = {
+		"../data/skybox/back.jpg",
+		"../data/skybox/front.jpg",
+		"../data/skybox/top.jpg",
+		"../data/skybox/bottom.jpg",
+		"../data/skybox/right.jpg",
+		"../data/skybox/left.jpg"
+	};
+
+	Scene createGridScene(uint32_t sphereCount, uint32_t seed) {
+		Scene scene{};
+		scene.spheres.reserve(sphereCount);
+		scene.animations.reserve(sphereCount);
+
+		std::mt19937 generator{ seed };
+		std::uniform_real_distribution<float> distribution{ 0.0f, 1.0f };
+
+		uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(sphereCount))));
+
+		for (uint32_t index = 0; index < sphereCount; index++) {
+			Sphere sphere{};
+			sphere.radius = 2.0f;
+			sphere.position = { (index / side) * 7.0f, 1.0f, (index % side) * 7.0f };
+
+			glm::vec3 color = {
+				distribution(generator),
+				distribution(generator),
+				distribution(generator)
+			};
+
+			// Eight levels per channel, so the spheres share at most 1024 materials
+			color = glm::floor(color * 8.0f) / 7.0f;
+
+			Material material{};
+
+			if (distribution(generator) < 0.5f) {
+				material.albedo = color;
+				material.specular = { 0.1f, 0.1f, 0.1f };
+			} else {
+				material.albedo = { 0.0f, 0.0f, 0.0f };
+				material.specular = color;
+			}
+
+			sphere.material = static_cast<uint32_t>(scene.materials.size());
+			scene.materials.push_back(material);
+			scene.spheres.push_back(sphere);
+
+			// Bobs between 0 and 2 above its rest position, out of phase with its neighbours
+			SphereAnimation animation{};
+			animation.offset = { 0.0f, 1.0f, 0.0f };
+			animation.frequency = 1.0f;
+			animation.amplitude = { 0.0f, 1.0f, 0.0f };
+			animation.phase = static_cast<float>(index);
+
+			scene.animations.push_back(animation);
+		}
+
+		scene.planes = {
+			createPlane({ 0.0f, -1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, static_cast<uint32_t>(scene.materials.size()))
+		};
+
+		scene.materials.push_back({ { 1.0f, 1.0f, 1.0f }, { 0.1f, 0.1f, 0.1f } });
+		deduplicateMaterials(scene);
+
+		return scene;
+	}
+
+	Scene createDefaultScene() {
+		return createGridScene(25, 0);
+	}
+
+	Plane createPlane(const glm::vec3& point, const glm::vec3& normal, uint32_t material) {
+		return { normal, glm::dot(normal, point), material };
+	}
+
+	void deduplicateMaterials(Scene& scene) {
+		std::map<std::array<float, 6>, uint32_t> indices;
+		std::vector<Material> materials;
+		std::vector<uint32_t> remap(scene.materials.size());
+
+		for (size_t index = 0; index < scene.materials.size(); index++) {
+			const Material& material = scene.materials[index];
+			std::array<float, 6> key{ material.albedo.x, material.albedo.y, material.albedo.z, material.specular.x, material.specular.y, material.specular.z };
+
+			auto result = indices.emplace(key, static_cast<uint32_t>(materials.size()));
+
+			if (result.second) {
+				materials.push_back(material);
+			}
+
+			remap[index] = result.first->second;
+		}
+
+		for (Sphere& sphere : scene.spheres) {
+			sphere.material = remap[sphere.material];
+		}
+
+		for (Plane& plane : scene.planes) {
+			plane.material = remap[plane.material];
+		}
+
+		for (Mesh& mesh : scene.meshes) {
+			mesh.material = remap[mesh.material];
+		}
+
+		scene.materials = std::move(materials);
+	}
+
+	glm::vec3 getAnimatedPosition(const Sphere& sphere, const SphereAnimation& animation, float time) {
+		return sphere.position + animation.offset + animation.amplitude * std::sin(animation.frequency * time + animation.phase);
+	}
+
+	glm::mat4 createInverseProjectionMatrix(float fov, float aspect) {
+		const float tanHalfFOV = tan(glm::radians(fov) / 2.0f);
+		float far = 10.0f;
+		float near = 0.1f;
+
+		glm::mat4 projection{ 0.0f };
+		projection[0][0] = 1.0f / (aspect * tanHalfFOV);
+		projection[1][1] = 1.0f / tanHalfFOV;
+		projection[2][2] = far / (far - near);
+		projection[2][3] = 1.0f;
+		projection[3][2] = -(far * near) / (far - near);
+
+		return glm::inverse(projection);
+	}
+
+	glm::mat4 createCameraTransform(const glm::vec3& position, const glm::vec3& rotation) {
+		const float c3 = glm::cos(rotation.z);
+		const float s3 = glm::sin(rotation.z);
+		const float c2 = glm::cos(rotation.x);
+		const float s2 = glm::sin(rotation.x);
+		const float c1 = glm::cos(rotation.y);
+		const float s1 = glm::sin(rotation.y);
+
+		return glm::mat4{
+			{ (c1 * c3 + s1 * s2 * s3), (c2 * s3), (c1 * s2 * s3 - c3 * s1), 0.0f },
+			{ (c3 * s1 * s2 - c1 * s3), (c2 * c3), (c1 * c3 * s2 + s1 * s3), 0.0f },
+			{ (c2 * s1), (-s2), (c1 * c2), 0.0f },
+			{ position.x, position.y, position.z, 1.0f }
+		};
+	}
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#ifndef __VULKAN_RAY_TRACING_SCENE_HPP__
+#define __VULKAN_RAY_TRACING_SCENE_HPP__
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace vrt {
+	struct Settings {
+		alignas(16) glm::mat4 projection;
+		alignas(16) glm::mat4 transform;
+		alignas(16) glm::vec4 directionalLight;
+
+		// Time of the sphere animations
+		alignas(16) float angle;
+		uint32_t useBvh;
+
+		// Index of the frame since the accumulation was last reset, written by RayTracer::drawFrame
+		uint32_t frameIndex;
+	};
+
+	// Shared by the objects referencing it by index, laid out to match the std430 Material struct of ray_tracing.glsl
+	struct Material {
+		glm::vec3 albedo;
+		alignas(16) glm::vec3 specular;
+	};
+
+	// Rest position of the sphere, animate.comp writes the center and radius at the time of the frame
+	struct alignas(16) Sphere {
+		glm::vec3 position;
+		float radius;
+		uint32_t material;
+	};
+
+	// Parametric motion of a sphere, its center at time t is position + offset + amplitude * sin(frequency * t + phase).
+	// Laid out to match the std430 SphereAnimation struct of animate.comp.
+	struct SphereAnimation {
+		glm::vec3 offset;
+		float frequency;
+		glm::vec3 amplitude;
+		float phase;
+	};
+
+	// Points p with dot(normal, p) == distance, the normal is unit length and the planes are only hit from its side
+	struct alignas(16) Plane {
+		glm::vec3 normal;
+		float distance;
+		uint32_t material;
+	};
+
+	// Laid out to match the std430 BvhNode struct of ray_tracing.glsl. Interior nodes have a count of
+	// zero and store the index of their left child, the right child always directly follows it. Leaves
+	// store the first entry of their range in the index buffer.
+	struct BvhNode {
+		glm::vec3 min;
+		uint32_t leftOrFirst;
+		glm::vec3 max;
+		uint32_t count;
+	};
+
+	// Position quantized to 16 bits per axis over the bounds of its mesh
+	struct MeshVertex {
+		uint16_t x;
+		uint16_t y;
+		uint16_t z;
+		uint16_t padding;
+	};
+
+	// Triangle mesh with its own BVH, the vertex quantized to q is at origin + q * scale. The node, triangle and vertex
+	// indices stored in the mesh arrays are relative to its first ones. Laid out to match the std430 Mesh struct of
+	// ray_tracing.glsl.
+	struct alignas(16) Mesh {
+		glm::vec3 origin;
+		uint32_t firstNode;
+		glm::vec3 scale;
+		uint32_t firstTriangle;
+		uint32_t firstVertex;
+		uint32_t triangleCount;
+		uint32_t material;
+		uint32_t nodeCount;
+	};
+
+	struct Scene {
+		std::vector<Sphere> spheres;
+		std::vector<Plane> planes;
+		std::vector<Material> materials;
+
+		// Either one per sphere or empty, in which case the spheres do not move
+		std::vector<SphereAnimation> animations;
+
+		// Filled by addMesh, three indices per triangle and the triangles of a mesh sorted along the leaves of its BVH
+		std::vector<Mesh> meshes;
+		std::vector<MeshVertex> meshVertices;
+		std::vector<uint32_t> meshIndices;
+		std::vector<BvhNode> meshNodes;
+	};
+
+	extern const char* SKY_BOX_TEXTURE_PATHS[6];
+
+	// Spheres laid out on a square grid with their colors and materials drawn from a seeded generator,
+	// so a given count and seed always produce the same scene.
+	Scene createGridScene(uint32_t sphereCount, uint32_t seed);
+	Scene createDefaultScene();
+
+	Plane createPlane(const glm::vec3& point, const glm::vec3& normal, uint32_t material);
+
+	// Merges the equal materials of the scene and updates the indices of the objects
+	void deduplicateMaterials(Scene& scene);
+
+	glm::vec3 getAnimatedPosition(const Sphere& sphere, const SphereAnimation& animation, float time);
+
+	glm::mat4 createInverseProjectionMatrix(float fov, float aspect);
+	glm::mat4 createCameraTransform(const glm::vec3& position, const glm::vec3& rotation);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,281 @@
+#include "vrt_scene_file.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vrt {
+	const char SceneFile::MAGIC[4] = { 'V', 'R', 'T', 'S' };
+	const uint32_t SceneFile::VERSION = 4;
+
+	namespace {
+		const uint64_t ARRAY_ALIGNMENT = 16;
+
+		uint64_t alignOffset(uint64_t offset) {
+			return (offset + ARRAY_ALIGNMENT - 1) & ~(ARRAY_ALIGNMENT - 1);
+		}
+
+		void writeArray(std::ofstream& file, uint64_t offset, const void* data, size_t size) {
+			file.seekp(static_cast<std::streamoff>(offset));
+			file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		}
+
+		// Empty arrays may point at the padding after the last one, which is never written
+		bool isArrayInFile(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize) {
+			return offset % ARRAY_ALIGNMENT == 0 && (count == 0 || (offset <= fileSize && count <= (fileSize - offset) / elementSize));
+		}
+	}
+
+	SceneData createSceneData(const Scene& scene, const Bvh& bvh, std::vector<SphereAnimation>& staticAnimations) {
+		for (const Sphere& sphere : scene.spheres) {
+			if (sphere.material >= scene.materials.size()) {
+				throw std::runtime_error("A sphere references a missing material");
+			}
+		}
+
+		for (const Plane& plane : scene.planes) {
+			if (plane.material >= scene.materials.size()) {
+				throw std::runtime_error("A plane references a missing material");
+			}
+		}
+
+		for (const Mesh& mesh : scene.meshes) {
+			if (mesh.material >= scene.materials.size()) {
+				throw std::runtime_error("A mesh references a missing material");
+			}
+		}
+
+		SceneData data{};
+		data.spheres = scene.spheres.data();
+		data.sphereCount = static_cast<uint32_t>(scene.spheres.size());
+		data.planes = scene.planes.data();
+		data.planeCount = static_cast<uint32_t>(scene.planes.size());
+		data.materials = scene.materials.data();
+		data.materialCount = static_cast<uint32_t>(scene.materials.size());
+		data.bvhNodes = bvh.nodes.data();
+		data.bvhNodeCount = static_cast<uint32_t>(bvh.nodes.size());
+		data.bvhIndices = bvh.indices.data();
+		data.bvhIndexCount = static_cast<uint32_t>(bvh.indices.size());
+		data.meshes = scene.meshes.data();
+		data.meshCount = static_cast<uint32_t>(scene.meshes.size());
+		data.meshVertices = scene.meshVertices.data();
+		data.meshVertexCount = static_cast<uint32_t>(scene.meshVertices.size());
+		data.meshIndices = scene.meshIndices.data();
+		data.meshIndexCount = static_cast<uint32_t>(scene.meshIndices.size());
+		data.meshNodes = scene.meshNodes.data();
+		data.meshNodeCount = static_cast<uint32_t>(scene.meshNodes.size());
+
+		if (scene.animations.empty()) {
+			staticAnimations.assign(scene.spheres.size(), SphereAnimation{});
+
+			data.animations = staticAnimations.data();
+			data.animationCount = static_cast<uint32_t>(staticAnimations.size());
+		} else {
+			data.animations = scene.animations.data();
+			data.animationCount = static_cast<uint32_t>(scene.animations.size());
+		}
+
+		return data;
+	}
+
+	void writeSceneFile(const char* path, const Scene& scene) {
+		Bvh bvh = buildBvh(scene.spheres, scene.animations);
+
+		std::vector<SphereAnimation> staticAnimations;
+		SceneData data = createSceneData(scene, bvh, staticAnimations);
+
+		SceneFileHeader header{};
+		memcpy(header.magic, SceneFile::MAGIC, sizeof(header.magic));
+		header.version = SceneFile::VERSION;
+		header.sphereCount = data.sphereCount;
+		header.planeCount = data.planeCount;
+		header.materialCount = data.materialCount;
+		header.bvhNodeCount = data.bvhNodeCount;
+		header.bvhIndexCount = data.bvhIndexCount;
+		header.animationCount = data.animationCount;
+		header.meshCount = data.meshCount;
+		header.meshVertexCount = data.meshVertexCount;
+		header.meshIndexCount = data.meshIndexCount;
+		header.meshNodeCount = data.meshNodeCount;
+
+		header.sphereOffset = alignOffset(sizeof(SceneFileHeader));
+		header.planeOffset = alignOffset(header.sphereOffset + data.sphereCount * sizeof(Sphere));
+		header.materialOffset = alignOffset(header.planeOffset + data.planeCount * sizeof(Plane));
+		header.bvhNodeOffset = alignOffset(header.materialOffset + data.materialCount * sizeof(Material));
+		header.bvhIndexOffset = alignOffset(header.bvhNodeOffset + data.bvhNodeCount * sizeof(BvhNode));
+		header.animationOffset = alignOffset(header.bvhIndexOffset + data.bvhIndexCount * sizeof(uint32_t));
+		header.meshOffset = alignOffset(header.animationOffset + data.animationCount * sizeof(SphereAnimation));
+		header.meshVertexOffset = alignOffset(header.meshOffset + data.meshCount * sizeof(Mesh));
+		header.meshIndexOffset = alignOffset(header.meshVertexOffset + data.meshVertexCount * sizeof(MeshVertex));
+		header.meshNodeOffset = alignOffset(header.meshIndexOffset + data.meshIndexCount * sizeof(uint32_t));
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open()) {
+			throw std::runtime_error(std::string("Failed to create the scene file ") + path);
+		}
+
+		writeArray(file, 0, &header, sizeof(SceneFileHeader));
+		writeArray(file, header.sphereOffset, data.spheres, data.sphereCount * sizeof(Sphere));
+		writeArray(file, header.planeOffset, data.planes, data.planeCount * sizeof(Plane));
+		writeArray(file, header.materialOffset, data.materials, data.materialCount * sizeof(Material));
+		writeArray(file, header.bvhNodeOffset, data.bvhNodes, data.bvhNodeCount * sizeof(BvhNode));
+		writeArray(file, header.bvhIndexOffset, data.bvhIndices, data.bvhIndexCount * sizeof(uint32_t));
+		writeArray(file, header.animationOffset, data.animations, data.animationCount * sizeof(SphereAnimation));
+		writeArray(file, header.meshOffset, data.meshes, data.meshCount * sizeof(Mesh));
+		writeArray(file, header.meshVertexOffset, data.meshVertices, data.meshVertexCount * sizeof(MeshVertex));
+		writeArray(file, header.meshIndexOffset, data.meshIndices, data.meshIndexCount * sizeof(uint32_t));
+		writeArray(file, header.meshNodeOffset, data.meshNodes, data.meshNodeCount * sizeof(BvhNode));
+
+		if (!file.good()) {
+			throw std::runtime_error(std::string("Failed to write the scene file ") + path);
+		}
+	}
+
+	SceneFile::SceneFile(const char* path) : _mapping{ nullptr }, _size{ 0 }, _data{} {
+#ifdef _WIN32
+		_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+		if (_file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error(std::string("Failed to open the scene file ") + path);
+		}
+
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(_file, &fileSize);
+		_size = static_cast<size_t>(fileSize.QuadPart);
+
+		_fileMapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		_mapping = _fileMapping != nullptr ? static_cast<const uint8_t*>(MapViewOfFile(_fileMapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+
+		if (_mapping == nullptr) {
+			if (_fileMapping != nullptr) {
+				CloseHandle(_fileMapping);
+			}
+
+			CloseHandle(_file);
+
+			throw std::runtime_error(std::string("Failed to map the scene file ") + path);
+		}
+#else
+		int file = open(path, O_RDONLY);
+
+		if (file < 0) {
+			throw std::runtime_error(std::string("Failed to open the scene file ") + path);
+		}
+
+		struct stat fileStatus;
+
+		if (fstat(file, &fileStatus) != 0 || fileStatus.st_size == 0) {
+			close(file);
+
+			throw std::runtime_error(std::string("Failed to read the size of the scene file ") + path);
+		}
+
+		_size = static_cast<size_t>(fileStatus.st_size);
+
+		// The mapping keeps its own reference on the file
+		void* mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+
+		if (mapping == MAP_FAILED) {
+			throw std::runtime_error(std::string("Failed to map the scene file ") + path);
+		}
+
+		// The arrays are read once, front to back, while being copied to the staging buffer
+		madvise(mapping, _size, MADV_SEQUENTIAL);
+		_mapping = static_cast<const uint8_t*>(mapping);
+#endif
+
+		try {
+			validate();
+		} catch (...) {
+			unmap();
+			throw;
+		}
+	}
+
+	SceneFile::~SceneFile() {
+		unmap();
+	}
+
+	void SceneFile::unmap() {
+#ifdef _WIN32
+		UnmapViewOfFile(_mapping);
+		CloseHandle(_fileMapping);
+		CloseHandle(_file);
+#else
+		munmap(const_cast<uint8_t*>(_mapping), _size);
+#endif
+	}
+
+	// Only the header is checked, the node, sphere, material and vertex indices of the arrays are trusted as written by writeSceneFile
+	void SceneFile::validate() {
+		if (_size < sizeof(SceneFileHeader)) {
+			throw std::runtime_error("The scene file is too small to hold its header");
+		}
+
+		SceneFileHeader header;
+		memcpy(&header, _mapping, sizeof(SceneFileHeader));
+
+		if (memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0) {
+			throw std::runtime_error("The file is not a scene file");
+		}
+
+		if (header.version != VERSION) {
+			throw std::runtime_error("Unsupported scene file version " + std::to_string(header.version));
+		}
+
+		if (header.sphereCount == 0 || header.planeCount == 0 || header.materialCount == 0 || header.bvhNodeCount == 0 || header.bvhIndexCount != header.sphereCount || header.animationCount != header.sphereCount) {
+			throw std::runtime_error("The scene file has inconsistent primitive counts");
+		}
+
+		if (header.meshIndexCount % 3 != 0 || (header.meshCount == 0) != (header.meshIndexCount == 0) || (header.meshCount == 0) != (header.meshNodeCount == 0)) {
+			throw std::runtime_error("The scene file has inconsistent mesh counts");
+		}
+
+		if (!isArrayInFile(header.sphereOffset, header.sphereCount, sizeof(Sphere), _size) ||
+			!isArrayInFile(header.planeOffset, header.planeCount, sizeof(Plane), _size) ||
+			!isArrayInFile(header.materialOffset, header.materialCount, sizeof(Material), _size) ||
+			!isArrayInFile(header.bvhNodeOffset, header.bvhNodeCount, sizeof(BvhNode), _size) ||
+			!isArrayInFile(header.bvhIndexOffset, header.bvhIndexCount, sizeof(uint32_t), _size) ||
+			!isArrayInFile(header.animationOffset, header.animationCount, sizeof(SphereAnimation), _size) ||
+			!isArrayInFile(header.meshOffset, header.meshCount, sizeof(Mesh), _size) ||
+			!isArrayInFile(header.meshVertexOffset, header.meshVertexCount, sizeof(MeshVertex), _size) ||
+			!isArrayInFile(header.meshIndexOffset, header.meshIndexCount, sizeof(uint32_t), _size) ||
+			!isArrayInFile(header.meshNodeOffset, header.meshNodeCount, sizeof(BvhNode), _size)) {
+			throw std::runtime_error("The scene file is truncated or its offsets are invalid");
+		}
+
+		_data.spheres = reinterpret_cast<const Sphere*>(_mapping + header.sphereOffset);
+		_data.sphereCount = header.sphereCount;
+		_data.planes = reinterpret_cast<const Plane*>(_mapping + header.planeOffset);
+		_data.planeCount = header.planeCount;
+		_data.materials = reinterpret_cast<const Material*>(_mapping + header.materialOffset);
+		_data.materialCount = header.materialCount;
+		_data.bvhNodes = reinterpret_cast<const BvhNode*>(_mapping + header.bvhNodeOffset);
+		_data.bvhNodeCount = header.bvhNodeCount;
+		_data.bvhIndices = reinterpret_cast<const uint32_t*>(_mapping + header.bvhIndexOffset);
+		_data.bvhIndexCount = header.bvhIndexCount;
+		_data.animations = reinterpret_cast<const SphereAnimation*>(_mapping + header.animationOffset);
+		_data.animationCount = header.animationCount;
+		_data.meshes = reinterpret_cast<const Mesh*>(_mapping + header.meshOffset);
+		_data.meshCount = header.meshCount;
+		_data.meshVertices = reinterpret_cast<const MeshVertex*>(_mapping + header.meshVertexOffset);
+		_data.meshVertexCount = header.meshVertexCount;
+		_data.meshIndices = reinterpret_cast<const uint32_t*>(_mapping + header.meshIndexOffset);
+		_data.meshIndexCount = header.meshIndexCount;
+		_data.meshNodes = reinterpret_cast<const BvhNode*>(_mapping + header.meshNodeOffset);
+		_data.meshNodeCount = header.meshNodeCount;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#ifndef __VULKAN_RAY_TRACING_SCENE_FILE_HPP__
+#define __VULKAN_RAY_TRACING_SCENE_FILE_HPP__
+
+#include "vrt_scene.hpp"
+#include "vrt_bvh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vrt {
+	// Header of a .vrts file. Each array starts at its offset, aligned on 16 bytes, and is stored exactly as
+	// the matching shader buffer expects it, so the file can be copied to the GPU without being parsed.
+	struct SceneFileHeader {
+		char magic[4];
+		uint32_t version;
+
+		uint32_t sphereCount;
+		uint32_t planeCount;
+		uint32_t materialCount;
+		uint32_t bvhNodeCount;
+		uint32_t bvhIndexCount;
+		uint32_t animationCount;
+		uint32_t meshCount;
+		uint32_t meshVertexCount;
+		uint32_t meshIndexCount;
+		uint32_t meshNodeCount;
+
+		uint64_t sphereOffset;
+		uint64_t planeOffset;
+		uint64_t materialOffset;
+		uint64_t bvhNodeOffset;
+		uint64_t bvhIndexOffset;
+		uint64_t animationOffset;
+		uint64_t meshOffset;
+		uint64_t meshVertexOffset;
+		uint64_t meshIndexOffset;
+		uint64_t meshNodeOffset;
+	};
+
+	// Non owning view over the buffers uploaded by the ray tracer, the BVH is built over the spheres.
+	struct SceneData {
+		const Sphere* spheres;
+		uint32_t sphereCount;
+
+		const Plane* planes;
+		uint32_t planeCount;
+
+		// Referenced by index from the spheres, the planes and the meshes
+		const Material* materials;
+		uint32_t materialCount;
+
+		const BvhNode* bvhNodes;
+		uint32_t bvhNodeCount;
+
+		const uint32_t* bvhIndices;
+		uint32_t bvhIndexCount;
+
+		// One per sphere
+		const SphereAnimation* animations;
+		uint32_t animationCount;
+
+		// Empty when the scene has no mesh, each mesh brings its own BVH
+		const Mesh* meshes;
+		uint32_t meshCount;
+
+		const MeshVertex* meshVertices;
+		uint32_t meshVertexCount;
+
+		const uint32_t* meshIndices;
+		uint32_t meshIndexCount;
+
+		const BvhNode* meshNodes;
+		uint32_t meshNodeCount;
+	};
+
+	// The animations of a static scene are filled with motions which leave the spheres in place. Throws when an
+	// object references a missing material.
+	SceneData createSceneData(const Scene& scene, const Bvh& bvh, std::vector<SphereAnimation>& staticAnimations);
+
+	// Builds the BVH of the scene and writes everything in the binary scene format.
+	void writeSceneFile(const char* path, const Scene& scene);
+
+	// Read-only memory mapping of a scene file, the header is validated when the file is opened and the
+	// arrays are only paged in when they are copied.
+	class SceneFile {
+	public:
+		SceneFile(const char* path);
+		~SceneFile();
+
+		SceneFile(SceneFile&) = delete;
+		SceneFile& operator=(SceneFile&) = delete;
+
+		const SceneData& getData() const { return _data; }
+		size_t getSize() const { return _size; }
+
+	public:
+		static const char MAGIC[4];
+		static const uint32_t VERSION;
+
+	private:
+		void validate();
+		void unmap();
+
+	private:
+		const uint8_t* _mapping;
+		size_t _size;
+
+#ifdef _WIN32
+		void* _file;
+		void* _fileMapping;
+#endif
+
+		SceneData _data;
+	};
+}
+
+#endif
\ No newline at end of file
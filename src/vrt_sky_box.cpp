@@ -0,0 +1,450 @@
+#include "vrt_sky_box.hpp"
+#include "vrt_scene.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace vrt {
+	namespace {
+		const char CACHE_MAGIC[4] = { 'V', 'R', 'T', 'C' };
+		const uint32_t CACHE_VERSION = 1;
+
+		// Faces bigger than this are refused when reading a cache, they would not fit in the staging arena anyway
+		const uint32_t MAX_FACE_SIZE = 16384;
+
+		// Header of a sky box cache file, directly followed by SkyBoxImage::data
+		struct SkyBoxCacheHeader {
+			char magic[4];
+			uint32_t version;
+
+			uint32_t format;
+			uint32_t size;
+			uint32_t mipLevelCount;
+			uint32_t reserved;
+
+			SkyBoxSources sources;
+			uint64_t dataSize;
+		};
+
+		uint16_t packRgb565(const int color[3]) {
+			int red = (color[0] * 31 + 127) / 255;
+			int green = (color[1] * 63 + 127) / 255;
+			int blue = (color[2] * 31 + 127) / 255;
+
+			return static_cast<uint16_t>((red << 11) | (green << 5) | blue);
+		}
+
+		void unpackRgb565(uint16_t packed, int color[3]) {
+			int red = (packed >> 11) & 31;
+			int green = (packed >> 5) & 63;
+			int blue = packed & 31;
+
+			color[0] = (red << 3) | (red >> 2);
+			color[1] = (green << 2) | (green >> 4);
+			color[2] = (blue << 3) | (blue >> 2);
+		}
+
+		// The end points followed by the two interpolated colors, or by their midpoint and black when the
+		// end points are in the reverse order
+		void getBc1Palette(uint16_t color0, uint16_t color1, int palette[4][3]) {
+			unpackRgb565(color0, palette[0]);
+			unpackRgb565(color1, palette[1]);
+
+			for (int channel = 0; channel < 3; channel++) {
+				if (color0 > color1) {
+					palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+					palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+				} else {
+					palette[2][channel] = (palette[0][channel] + palette[1][channel]) / 2;
+					palette[3][channel] = 0;
+				}
+			}
+		}
+
+		// End points taken on the diagonal of the bounding box of the colors, the one which follows the sign of
+		// their covariance with red, then moved inwards since the extremes are mostly noise.
+		void encodeBc1Block(const uint8_t texels[16][4], uint8_t* block) {
+			int minimum[3] = { 255, 255, 255 };
+			int maximum[3] = { 0, 0, 0 };
+			int sum[3] = { 0, 0, 0 };
+
+			for (int texel = 0; texel < 16; texel++) {
+				for (int channel = 0; channel < 3; channel++) {
+					minimum[channel] = std::min<int>(minimum[channel], texels[texel][channel]);
+					maximum[channel] = std::max<int>(maximum[channel], texels[texel][channel]);
+					sum[channel] += texels[texel][channel];
+				}
+			}
+
+			int covariance[3] = { 0, 0, 0 };
+
+			for (int texel = 0; texel < 16; texel++) {
+				int red = texels[texel][0] * 16 - sum[0];
+
+				for (int channel = 1; channel < 3; channel++) {
+					covariance[channel] += red * (texels[texel][channel] * 16 - sum[channel]);
+				}
+			}
+
+			for (int channel = 1; channel < 3; channel++) {
+				if (covariance[channel] < 0) {
+					std::swap(minimum[channel], maximum[channel]);
+				}
+			}
+
+			for (int channel = 0; channel < 3; channel++) {
+				int inset = (maximum[channel] - minimum[channel]) / 16;
+
+				minimum[channel] += inset;
+				maximum[channel] -= inset;
+			}
+
+			uint16_t color0 = packRgb565(maximum);
+			uint16_t color1 = packRgb565(minimum);
+
+			// Four color mode, which has no transparent entry
+			if (color0 < color1) {
+				std::swap(color0, color1);
+			}
+
+			int palette[4][3];
+			getBc1Palette(color0, color1, palette);
+
+			uint32_t indices = 0;
+
+			if (color0 != color1) {
+				for (int texel = 0; texel < 16; texel++) {
+					uint32_t bestIndex = 0;
+					int bestDistance = INT32_MAX;
+
+					for (uint32_t index = 0; index < 4; index++) {
+						int distance = 0;
+
+						for (int channel = 0; channel < 3; channel++) {
+							int difference = texels[texel][channel] - palette[index][channel];
+							distance += difference * difference;
+						}
+
+						if (distance < bestDistance) {
+							bestDistance = distance;
+							bestIndex = index;
+						}
+					}
+
+					indices |= bestIndex << (2 * texel);
+				}
+			}
+
+			block[0] = static_cast<uint8_t>(color0 & 0xff);
+			block[1] = static_cast<uint8_t>(color0 >> 8);
+			block[2] = static_cast<uint8_t>(color1 & 0xff);
+			block[3] = static_cast<uint8_t>(color1 >> 8);
+
+			for (int byte = 0; byte < 4; byte++) {
+				block[4 + byte] = static_cast<uint8_t>(indices >> (8 * byte));
+			}
+		}
+
+		// The blocks which overhang the small levels repeat their last row and column
+		std::vector<uint8_t> encodeBc1Level(const std::vector<uint8_t>& pixels, uint32_t size) {
+			uint32_t blockCount = (size + 3) / 4;
+			std::vector<uint8_t> blocks(static_cast<size_t>(blockCount) * blockCount * 8);
+
+			for (uint32_t blockY = 0; blockY < blockCount; blockY++) {
+				for (uint32_t blockX = 0; blockX < blockCount; blockX++) {
+					uint8_t texels[16][4];
+
+					for (uint32_t texel = 0; texel < 16; texel++) {
+						uint32_t x = std::min(blockX * 4 + texel % 4, size - 1);
+						uint32_t y = std::min(blockY * 4 + texel / 4, size - 1);
+
+						memcpy(texels[texel], pixels.data() + (static_cast<size_t>(y) * size + x) * 4, 4);
+					}
+
+					encodeBc1Block(texels, blocks.data() + (static_cast<size_t>(blockY) * blockCount + blockX) * 8);
+				}
+			}
+
+			return blocks;
+		}
+
+		void decodeBc1Level(const uint8_t* blocks, uint32_t size, uint8_t* pixels) {
+			uint32_t blockCount = (size + 3) / 4;
+
+			for (uint32_t blockY = 0; blockY < blockCount; blockY++) {
+				for (uint32_t blockX = 0; blockX < blockCount; blockX++) {
+					const uint8_t* block = blocks + (static_cast<size_t>(blockY) * blockCount + blockX) * 8;
+
+					uint16_t color0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+					uint16_t color1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+					uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+
+					int palette[4][3];
+					getBc1Palette(color0, color1, palette);
+
+					for (uint32_t texel = 0; texel < 16; texel++) {
+						uint32_t x = blockX * 4 + texel % 4;
+						uint32_t y = blockY * 4 + texel / 4;
+
+						if (x >= size || y >= size) {
+							continue;
+						}
+
+						const int* color = palette[(indices >> (2 * texel)) & 3];
+						uint8_t* pixel = pixels + (static_cast<size_t>(y) * size + x) * 4;
+
+						pixel[0] = static_cast<uint8_t>(color[0]);
+						pixel[1] = static_cast<uint8_t>(color[1]);
+						pixel[2] = static_cast<uint8_t>(color[2]);
+						pixel[3] = 255;
+					}
+				}
+			}
+		}
+
+		// Box filter, odd sizes drop their last row and column
+		std::vector<uint8_t> downsample(const std::vector<uint8_t>& pixels, uint32_t size) {
+			uint32_t halfSize = std::max(1u, size / 2);
+			std::vector<uint8_t> result(static_cast<size_t>(halfSize) * halfSize * 4);
+
+			for (uint32_t y = 0; y < halfSize; y++) {
+				for (uint32_t x = 0; x < halfSize; x++) {
+					for (uint32_t channel = 0; channel < 4; channel++) {
+						uint32_t sum = 0;
+
+						for (uint32_t offset = 0; offset < 4; offset++) {
+							uint32_t sourceX = std::min(2 * x + offset % 2, size - 1);
+							uint32_t sourceY = std::min(2 * y + offset / 2, size - 1);
+
+							sum += pixels[(static_cast<size_t>(sourceY) * size + sourceX) * 4 + channel];
+						}
+
+						result[(static_cast<size_t>(y) * halfSize + x) * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+					}
+				}
+			}
+
+			return result;
+		}
+
+		// Unique per writer, every local worker converts the sky box on a first run and saves it at the same time
+		std::string getTemporaryPath(const std::string& path) {
+			std::random_device device;
+
+			char suffix[32];
+			snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", device(), device());
+
+			return path + suffix;
+		}
+	}
+
+	uint32_t getSkyBoxMipLevelCount(uint32_t size) {
+		uint32_t levelCount = 1;
+
+		while (size > 1) {
+			size /= 2;
+			levelCount++;
+		}
+
+		return levelCount;
+	}
+
+	size_t getSkyBoxFaceSize(SkyBoxFormat format, uint32_t size, uint32_t level) {
+		size_t levelSize = std::max(1u, size >> level);
+
+		if (format == SkyBoxFormat::Bc1) {
+			size_t blockCount = (levelSize + 3) / 4;
+
+			return blockCount * blockCount * 8;
+		}
+
+		return levelSize * levelSize * 4;
+	}
+
+	size_t getSkyBoxLevelOffset(SkyBoxFormat format, uint32_t size, uint32_t level) {
+		size_t offset = 0;
+
+		for (uint32_t previous = 0; previous < level; previous++) {
+			offset += 6 * getSkyBoxFaceSize(format, size, previous);
+		}
+
+		return offset;
+	}
+
+	std::vector<std::vector<uint8_t>> convertSkyBoxFace(const uint8_t* pixels, uint32_t size, SkyBoxFormat format) {
+		std::vector<std::vector<uint8_t>> levels(getSkyBoxMipLevelCount(size));
+		levels[0].assign(pixels, pixels + static_cast<size_t>(size) * size * 4);
+
+		for (uint32_t level = 1; level < levels.size(); level++) {
+			levels[level] = downsample(levels[level - 1], std::max(1u, size >> (level - 1)));
+		}
+
+		if (format == SkyBoxFormat::Bc1) {
+			for (uint32_t level = 0; level < levels.size(); level++) {
+				levels[level] = encodeBc1Level(levels[level], std::max(1u, size >> level));
+			}
+		}
+
+		return levels;
+	}
+
+	SkyBoxImage assembleSkyBox(SkyBoxFormat format, uint32_t size, const std::vector<std::vector<uint8_t>> (&faces)[6]) {
+		SkyBoxImage image{};
+		image.format = format;
+		image.size = size;
+		image.mipLevelCount = getSkyBoxMipLevelCount(size);
+		image.data.resize(getSkyBoxLevelOffset(format, size, image.mipLevelCount));
+
+		for (uint32_t level = 0; level < image.mipLevelCount; level++) {
+			size_t faceSize = getSkyBoxFaceSize(format, size, level);
+			size_t levelOffset = getSkyBoxLevelOffset(format, size, level);
+
+			for (uint32_t face = 0; face < 6; face++) {
+				if (faces[face].size() != image.mipLevelCount || faces[face][level].size() != faceSize) {
+					throw std::runtime_error("The sky box faces do not have the same size");
+				}
+
+				memcpy(image.data.data() + levelOffset + face * faceSize, faces[face][level].data(), faceSize);
+			}
+		}
+
+		return image;
+	}
+
+	SkyBoxImage decompressSkyBox(const SkyBoxImage& image) {
+		if (image.format == SkyBoxFormat::Rgba8) {
+			return image;
+		}
+
+		SkyBoxImage result{};
+		result.format = SkyBoxFormat::Rgba8;
+		result.size = image.size;
+		result.mipLevelCount = image.mipLevelCount;
+		result.data.resize(getSkyBoxLevelOffset(SkyBoxFormat::Rgba8, image.size, image.mipLevelCount));
+
+		for (uint32_t level = 0; level < image.mipLevelCount; level++) {
+			size_t sourceFaceSize = getSkyBoxFaceSize(image.format, image.size, level);
+			size_t sourceOffset = getSkyBoxLevelOffset(image.format, image.size, level);
+			size_t faceSize = getSkyBoxFaceSize(SkyBoxFormat::Rgba8, image.size, level);
+			size_t offset = getSkyBoxLevelOffset(SkyBoxFormat::Rgba8, image.size, level);
+
+			for (uint32_t face = 0; face < 6; face++) {
+				decodeBc1Level(image.data.data() + sourceOffset + face * sourceFaceSize, std::max(1u, image.size >> level), result.data.data() + offset + face * faceSize);
+			}
+		}
+
+		return result;
+	}
+
+	bool getSkyBoxSources(SkyBoxSources& sources) {
+		std::error_code error;
+
+		for (uint32_t face = 0; face < 6; face++) {
+			auto timestamp = std::filesystem::last_write_time(SKY_BOX_TEXTURE_PATHS[face], error);
+
+			if (error) {
+				return false;
+			}
+
+			uintmax_t size = std::filesystem::file_size(SKY_BOX_TEXTURE_PATHS[face], error);
+
+			if (error) {
+				return false;
+			}
+
+			sources.timestamps[face] = static_cast<int64_t>(timestamp.time_since_epoch().count());
+			sources.sizes[face] = static_cast<uint64_t>(size);
+		}
+
+		return true;
+	}
+
+	bool readSkyBoxCache(const char* path, const SkyBoxSources& sources, SkyBoxImage& image) {
+		std::ifstream file(path, std::ios::binary);
+		SkyBoxCacheHeader header{};
+
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(SkyBoxCacheHeader))) {
+			return false;
+		}
+
+		if (memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != CACHE_VERSION) {
+			return false;
+		}
+
+		if (memcmp(&header.sources, &sources, sizeof(SkyBoxSources)) != 0) {
+			return false;
+		}
+
+		if (header.format > static_cast<uint32_t>(SkyBoxFormat::Bc1) || header.size == 0 || header.size > MAX_FACE_SIZE) {
+			return false;
+		}
+
+		SkyBoxFormat format = static_cast<SkyBoxFormat>(header.format);
+
+		if (header.mipLevelCount != getSkyBoxMipLevelCount(header.size) || header.dataSize != getSkyBoxLevelOffset(format, header.size, header.mipLevelCount)) {
+			return false;
+		}
+
+		image.format = format;
+		image.size = header.size;
+		image.mipLevelCount = header.mipLevelCount;
+		image.data.resize(static_cast<size_t>(header.dataSize));
+
+		if (!file.read(reinterpret_cast<char*>(image.data.data()), static_cast<std::streamsize>(image.data.size()))) {
+			image.data.clear();
+
+			return false;
+		}
+
+		return true;
+	}
+
+	// Written next to the final file then renamed, like the pipeline cache
+	bool writeSkyBoxCache(const char* path, const SkyBoxSources& sources, const SkyBoxImage& image) {
+		SkyBoxCacheHeader header{};
+		memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+		header.version = CACHE_VERSION;
+		header.format = static_cast<uint32_t>(image.format);
+		header.size = image.size;
+		header.mipLevelCount = image.mipLevelCount;
+		header.sources = sources;
+		header.dataSize = image.data.size();
+
+		std::error_code error;
+		std::filesystem::path filePath(path);
+
+		if (filePath.has_parent_path()) {
+			std::filesystem::create_directories(filePath.parent_path(), error);
+		}
+
+		std::string temporaryPath = getTemporaryPath(filePath.string());
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(SkyBoxCacheHeader));
+		file.write(reinterpret_cast<const char*>(image.data.data()), static_cast<std::streamsize>(image.data.size()));
+		file.close();
+
+		if (!file.good()) {
+			std::filesystem::remove(temporaryPath, error);
+
+			return false;
+		}
+
+		std::filesystem::rename(temporaryPath, filePath, error);
+
+		if (error) {
+			std::filesystem::remove(temporaryPath, error);
+
+			return false;
+		}
+
+		return true;
+	}
+}
\ No newline at end of file
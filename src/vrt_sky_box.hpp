@@ -0,0 +1,57 @@
+#ifndef __VULKAN_RAY_TRACING_SKY_BOX_HPP__
+#define __VULKAN_RAY_TRACING_SKY_BOX_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vrt {
+	enum class SkyBoxFormat : uint32_t {
+		// Uncompressed, 4 bytes per texel
+		Rgba8 = 0,
+
+		// Blocks of 4x4 texels in 8 bytes: two RGB565 end points and a 2 bit index per texel, without alpha
+		Bc1 = 1
+	};
+
+	// Cube map with its full mip chain, stored in the order of the copies: the levels follow each other from the
+	// largest one, and each level holds the six faces in the order of SKY_BOX_TEXTURE_PATHS.
+	struct SkyBoxImage {
+		SkyBoxFormat format;
+
+		// Width and height of the faces at level 0
+		uint32_t size;
+		uint32_t mipLevelCount;
+
+		std::vector<uint8_t> data;
+	};
+
+	// Modification time and size of the source images, the cache is rebuilt as soon as one of them changes
+	struct SkyBoxSources {
+		int64_t timestamps[6];
+		uint64_t sizes[6];
+	};
+
+	// The faces are squares, so the chain goes down to 1x1.
+	uint32_t getSkyBoxMipLevelCount(uint32_t size);
+
+	size_t getSkyBoxFaceSize(SkyBoxFormat format, uint32_t size, uint32_t level);
+	size_t getSkyBoxLevelOffset(SkyBoxFormat format, uint32_t size, uint32_t level);
+
+	// Filters the mip chain of a decoded RGBA8 face, then encodes every level in the requested format.
+	std::vector<std::vector<uint8_t>> convertSkyBoxFace(const uint8_t* pixels, uint32_t size, SkyBoxFormat format);
+
+	// Interleaves the levels of the six converted faces.
+	SkyBoxImage assembleSkyBox(SkyBoxFormat format, uint32_t size, const std::vector<std::vector<uint8_t>> (&faces)[6]);
+
+	// Fallback for the devices without BC support.
+	SkyBoxImage decompressSkyBox(const SkyBoxImage& image);
+
+	bool getSkyBoxSources(SkyBoxSources& sources);
+
+	// Returns false when the file is missing, corrupted or was built from other source images
+	bool readSkyBoxCache(const char* path, const SkyBoxSources& sources, SkyBoxImage& image);
+	bool writeSkyBoxCache(const char* path, const SkyBoxSources& sources, const SkyBoxImage& image);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "vrt_statistics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vrt {
+	RollingStatistics::RollingStatistics(uint32_t capacity) : _capacity{ std::max(capacity, 1u) }, _next{ 0 } {
+		_samples.reserve(_capacity);
+	}
+
+	void RollingStatistics::add(double sample) {
+		if (_samples.size() < _capacity) {
+			_samples.push_back(sample);
+		} else {
+			_samples[_next] = sample;
+		}
+
+		_next = (_next + 1) % _capacity;
+	}
+
+	void RollingStatistics::clear() {
+		_samples.clear();
+		_next = 0;
+	}
+
+	StatisticsSummary RollingStatistics::getSummary() const {
+		StatisticsSummary summary{};
+		summary.count = static_cast<uint32_t>(_samples.size());
+
+		if (_samples.empty()) {
+			return summary;
+		}
+
+		std::vector<double> sorted = _samples;
+		std::sort(sorted.begin(), sorted.end());
+
+		double sum = 0.0;
+
+		for (double sample : sorted) {
+			sum += sample;
+		}
+
+		// Nearest rank percentiles
+		auto getPercentile = [&](double percentile) {
+			size_t rank = static_cast<size_t>(std::ceil(percentile * sorted.size()));
+			return sorted[std::min(std::max(rank, size_t{ 1 }), sorted.size()) - 1];
+		};
+
+		summary.last = _samples[(_next + _capacity - 1) % _capacity];
+		summary.min = sorted.front();
+		summary.mean = sum / sorted.size();
+		summary.p95 = getPercentile(0.95);
+		summary.p99 = getPercentile(0.99);
+
+		return summary;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef __VULKAN_RAY_TRACING_STATISTICS_HPP__
+#define __VULKAN_RAY_TRACING_STATISTICS_HPP__
+
+#include <cstdint>
+#include <vector>
+
+namespace vrt {
+	struct StatisticsSummary {
+		uint32_t count;
+
+		double last;
+		double min;
+		double mean;
+		double p95;
+		double p99;
+	};
+
+	// Keeps the last samples in a fixed size ring, so the summary follows the recent behaviour
+	// instead of averaging over the whole run.
+	class RollingStatistics {
+	public:
+		RollingStatistics(uint32_t capacity = 512);
+
+		void add(double sample);
+		void clear();
+
+		StatisticsSummary getSummary() const;
+
+	private:
+		std::vector<double> _samples;
+
+		uint32_t _capacity;
+		uint32_t _next;
+	};
+
+	// Durations in milliseconds, the GPU stages are empty when the device has no timestamp support.
+	struct FrameStatistics {
+		StatisticsSummary computeTime;
+		StatisticsSummary renderTime;
+		StatisticsSummary submitTime;
+		StatisticsSummary presentInterval;
+	};
+
+	struct StartupStage {
+		const char* name;
+		double time;
+	};
+
+	// Durations in milliseconds. The stages run in order on the main thread, while the assets are loaded on
+	// worker threads from the start of the construction.
+	struct StartupStatistics {
+		std::vector<StartupStage> stages;
+
+		// From the start of the construction until the last asset was loaded
+		double assetLoading;
+
+		// From the start of the construction until it returned, and until the first frame was submitted
+		double total;
+		double firstFrame;
+	};
+}
+
+#endif // __VULKAN_RAY_TRACING_STATISTICS_HPP__
\ No newline at end of file
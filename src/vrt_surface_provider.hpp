@@ -0,0 +1,21 @@
+#ifndef __VULKAN_RAY_TRACING_SURFACE_PROVIDER_HPP__
+#define __VULKAN_RAY_TRACING_SURFACE_PROVIDER_HPP__
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace vrt {
+	// Anything the ray tracer can present to. Keeps the core free of any windowing library.
+	class SurfaceProvider {
+	public:
+		virtual ~SurfaceProvider() = default;
+
+		virtual std::vector<const char*> getRequiredInstanceExtensions() = 0;
+
+		virtual void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface) = 0;
+		virtual void getFrameBufferSize(int* width, int* height) = 0;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "vrt_thread_pool.hpp"
+
+#include <algorithm>
+
+namespace vrt {
+	namespace {
+		thread_local const ThreadPool* currentPool = nullptr;
+		thread_local uint32_t currentWorkerIndex = 0;
+	}
+
+	ThreadPool::ThreadPool(uint32_t threadCount) : _queuedTaskCount{ 0 }, _pendingTaskCount{ 0 }, _stopping{ false }, _nextWorker{ 0 } {
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		for (uint32_t index = 0; index < threadCount; index++) {
+			_workers.push_back(std::make_unique<Worker>());
+		}
+
+		for (uint32_t index = 0; index < threadCount; index++) {
+			_threads.emplace_back(&ThreadPool::run, this, index);
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_stopping = true;
+		}
+
+		_taskAvailable.notify_all();
+
+		for (auto& thread : _threads) {
+			thread.join();
+		}
+	}
+
+	void ThreadPool::submit(std::function<void()> task) {
+		// Tasks spawned from a worker stay on its own queue, which keeps related work on the same core.
+		uint32_t workerIndex = currentPool == this ? currentWorkerIndex : _nextWorker++ % getThreadCount();
+
+		{
+			std::lock_guard<std::mutex> lock{ _workers[workerIndex]->mutex };
+			_workers[workerIndex]->tasks.push_back(std::move(task));
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_queuedTaskCount++;
+			_pendingTaskCount++;
+		}
+
+		_taskAvailable.notify_one();
+	}
+
+	void ThreadPool::wait() {
+		std::unique_lock<std::mutex> lock{ _mutex };
+		_idle.wait(lock, [this] { return _pendingTaskCount == 0; });
+
+		if (_exception) {
+			std::exception_ptr exception = _exception;
+			_exception = nullptr;
+
+			std::rethrow_exception(exception);
+		}
+	}
+
+	void ThreadPool::run(uint32_t workerIndex) {
+		currentPool = this;
+		currentWorkerIndex = workerIndex;
+
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock{ _mutex };
+				_taskAvailable.wait(lock, [this] { return _stopping || _queuedTaskCount > 0; });
+
+				if (_queuedTaskCount == 0) {
+					return;
+				}
+
+				// Reserves one of the queued tasks, tasks are always pushed before being counted so
+				// the reserved one is guaranteed to be found in one of the queues
+				_queuedTaskCount--;
+			}
+
+			std::function<void()> task;
+
+			while (!popTask(workerIndex, task)) {
+				std::this_thread::yield();
+			}
+
+			try {
+				task();
+			} catch (...) {
+				std::lock_guard<std::mutex> lock{ _mutex };
+
+				if (!_exception) {
+					_exception = std::current_exception();
+				}
+			}
+
+			std::lock_guard<std::mutex> lock{ _mutex };
+
+			if (--_pendingTaskCount == 0) {
+				_idle.notify_all();
+			}
+		}
+	}
+
+	bool ThreadPool::popTask(uint32_t workerIndex, std::function<void()>& task) {
+		{
+			Worker& worker = *_workers[workerIndex];
+			std::lock_guard<std::mutex> lock{ worker.mutex };
+
+			if (!worker.tasks.empty()) {
+				task = std::move(worker.tasks.back());
+				worker.tasks.pop_back();
+
+				return true;
+			}
+		}
+
+		for (uint32_t offset = 1; offset < getThreadCount(); offset++) {
+			Worker& victim = *_workers[(workerIndex + offset) % getThreadCount()];
+			std::lock_guard<std::mutex> lock{ victim.mutex };
+
+			if (!victim.tasks.empty()) {
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef __VULKAN_RAY_TRACING_THREAD_POOL_HPP__
+#define __VULKAN_RAY_TRACING_THREAD_POOL_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vrt {
+	// Fixed size pool where every worker owns a task queue. Workers pop their own queue from the back
+	// and steal from the front of the other queues once theirs is empty.
+	class ThreadPool {
+	public:
+		ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&) = delete;
+
+		void submit(std::function<void()> task);
+
+		// Blocks until every submitted task has completed, rethrows the first exception thrown by a task.
+		void wait();
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(_threads.size()); }
+
+	private:
+		struct Worker {
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		void run(uint32_t workerIndex);
+		bool popTask(uint32_t workerIndex, std::function<void()>& task);
+
+	private:
+		std::vector<std::unique_ptr<Worker>> _workers;
+		std::vector<std::thread> _threads;
+
+		std::mutex _mutex;
+		std::condition_variable _taskAvailable;
+		std::condition_variable _idle;
+
+		uint32_t _queuedTaskCount;
+		uint32_t _pendingTaskCount;
+		bool _stopping;
+
+		std::exception_ptr _exception;
+		std::atomic<uint32_t> _nextWorker;
+	};
+}
+
+#endif
\ No newline at end of file
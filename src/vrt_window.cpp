@@ -9,7 +9,7 @@ namespace vrt {
 		}
 
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
 		_window = glfwCreateWindow(1024, 768, "Vulkan Ray Tracing", nullptr, nullptr);
 	}
@@ -19,6 +19,13 @@ namespace vrt {
 		glfwTerminate();
 	}
 
+	std::vector<const char*> Window::getRequiredInstanceExtensions() {
+		uint32_t extensionCount;
+		const char** extensionNames = glfwGetRequiredInstanceExtensions(&extensionCount);
+
+		return std::vector<const char*>{ extensionNames, extensionNames + extensionCount };
+	}
+
 	void Window::createWindowSurface(VkInstance instance, VkSurfaceKHR* surface) {
 		if (glfwCreateWindowSurface(instance, _window, nullptr, surface) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create surface");
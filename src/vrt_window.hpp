@@ -1,17 +1,21 @@
 #ifndef __VULKAN_RAY_TRACING_WINDOW_HPP__
 #define __VULKAN_RAY_TRACING_WINDOW_HPP__
 
+#include "vrt_surface_provider.hpp"
+
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
 namespace vrt {
-	class Window {
+	class Window : public SurfaceProvider {
 	public:
 		Window();
 		~Window();
 
-		void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
-		void getFrameBufferSize(int* width, int* height);
+		std::vector<const char*> getRequiredInstanceExtensions() override;
+
+		void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface) override;
+		void getFrameBufferSize(int* width, int* height) override;
 
 		bool isMinimized();
 		bool shouldClose();